@@ -0,0 +1,162 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// A ring of mono samples for the long delay lines, stored as 32-bit floats or, at half
+// the memory and cache traffic, in one of two 16-bit formats:
+//
+//     int16     fixed point with int16Headroom (+12 dB) above full scale before it clips;
+//               the noise floor sits about 84 dB below 0 dBFS
+//     bfloat16  the top half of a float: the full float range with an 8-bit mantissa, so
+//               the error follows the signal at about -48 dB
+//
+// Single reads convert one sample; read (start, dest, n) converts a run in one pass the
+// compiler can vectorise, for callers that read runs of neighbouring samples.
+class DelayBuffer final
+{
+public:
+    enum class Format { float32, int16, bfloat16 };
+
+    static constexpr float int16Headroom = 4.0f;
+
+    static int getBytesPerSample (Format f) noexcept { return f == Format::float32 ? 4 : 2; }
+
+    // Message thread: allocates and clears.
+    void setSize (int newNumSamples, Format newFormat)
+    {
+        format = newFormat;
+        size = juce::jmax (1, newNumSamples);
+
+        floats.clear();
+        floats.shrink_to_fit();
+        fixed.clear();
+        fixed.shrink_to_fit();
+        halves.clear();
+        halves.shrink_to_fit();
+
+        switch (format)
+        {
+            case Format::float32:  floats.resize ((size_t) size); break;
+            case Format::int16:    fixed.resize ((size_t) size); break;
+            case Format::bfloat16: halves.resize ((size_t) size); break;
+        }
+
+        clear();
+    }
+
+    void clear() noexcept
+    {
+        std::fill (floats.begin(), floats.end(), 0.0f);
+        std::fill (fixed.begin(), fixed.end(), (std::int16_t) 0);
+        std::fill (halves.begin(), halves.end(), (std::uint16_t) 0);
+    }
+
+    int getSize() const noexcept { return size; }
+    Format getFormat() const noexcept { return format; }
+
+    size_t getMemoryBytes() const noexcept
+    {
+        return floats.capacity() * sizeof (float) + fixed.capacity() * sizeof (std::int16_t) + halves.capacity() * sizeof (std::uint16_t);
+    }
+
+    // The samples themselves when they're stored as floats, otherwise nullptr.
+    const float* getFloatData() const noexcept { return format == Format::float32 ? floats.data() : nullptr; }
+
+    void write (int index, float x) noexcept
+    {
+        switch (format)
+        {
+            case Format::float32:  floats[(size_t) index] = x; break;
+            case Format::int16:    fixed[(size_t) index] = encodeInt16 (x); break;
+            case Format::bfloat16: halves[(size_t) index] = encodeBFloat16 (x); break;
+        }
+    }
+
+    float read (int index) const noexcept
+    {
+        switch (format)
+        {
+            case Format::int16:    return decodeInt16 (fixed[(size_t) index]);
+            case Format::bfloat16: return decodeBFloat16 (halves[(size_t) index]);
+            case Format::float32:  break;
+        }
+
+        return floats[(size_t) index];
+    }
+
+    // Converts numSamples samples from start on (wrapping at the end) into dest.
+    void read (int start, float* dest, int numSamples) const noexcept
+    {
+        while (numSamples > 0)
+        {
+            const int n = juce::jmin (numSamples, size - start);
+
+            switch (format)
+            {
+                case Format::float32:
+                    std::memcpy (dest, floats.data() + start, (size_t) n * sizeof (float));
+                    break;
+
+                case Format::int16:
+                {
+                    const auto* src = fixed.data() + start;
+                    for (int i = 0; i < n; ++i)
+                        dest[i] = decodeInt16 (src[i]);
+                    break;
+                }
+
+                case Format::bfloat16:
+                {
+                    const auto* src = halves.data() + start;
+                    for (int i = 0; i < n; ++i)
+                        dest[i] = decodeBFloat16 (src[i]);
+                    break;
+                }
+            }
+
+            dest += n;
+            numSamples -= n;
+            start = 0;
+        }
+    }
+
+private:
+    static std::int16_t encodeInt16 (float x) noexcept
+    {
+        return (std::int16_t) juce::roundToInt (juce::jlimit (-1.0f, 1.0f, x * (1.0f / int16Headroom)) * 32767.0f);
+    }
+
+    static float decodeInt16 (std::int16_t s) noexcept
+    {
+        return (float) s * (int16Headroom / 32767.0f);
+    }
+
+    // rounds to nearest, ties to even
+    static std::uint16_t encodeBFloat16 (float x) noexcept
+    {
+        std::uint32_t bits;
+        std::memcpy (&bits, &x, sizeof (bits));
+        bits += 0x7fffu + ((bits >> 16) & 1u);
+        return (std::uint16_t) (bits >> 16);
+    }
+
+    static float decodeBFloat16 (std::uint16_t h) noexcept
+    {
+        const std::uint32_t bits = (std::uint32_t) h << 16;
+        float x;
+        std::memcpy (&x, &bits, sizeof (x));
+        return x;
+    }
+
+    Format format = Format::float32;
+    int size = 1;
+
+    std::vector<float> floats;
+    std::vector<std::int16_t> fixed;
+    std::vector<std::uint16_t> halves;
+};
@@ -0,0 +1,153 @@
+#include "EarlyReflections.h"
+
+#include <algorithm>
+#include <map>
+
+// A room's reflections arrive from a few milliseconds after the sound, sparse at first and
+// denser later as paths off more walls come in, each quieter by the distance it has
+// travelled. Bigger rooms start later and spread further. The gains of each channel's taps
+// add up to the same energy whatever the size, so Reverb Size doesn't change the level.
+static EarlyReflections::Pattern makePattern (double sampleRate, float size, int channel)
+{
+    constexpr double firstSeconds = 0.002, firstSpread = 0.01;
+    constexpr double lastSeconds = 0.015;
+
+    const double first = firstSeconds + firstSpread * size;
+    const double last = lastSeconds + (EarlyReflections::maxReflectionSeconds - lastSeconds) * size;
+
+    juce::Random rng (0x5eed + 97 * channel);
+    EarlyReflections::Pattern p;
+    double energy = 0.0;
+
+    for (int t = 0; t < EarlyReflections::tapsPerChannel; ++t)
+    {
+        const double u = ((double) t + rng.nextDouble()) / EarlyReflections::tapsPerChannel;
+        const double seconds = first + (last - first) * std::cbrt (u);
+        const double gain = (first / seconds) * (rng.nextBool() ? 1.0 : -1.0);
+
+        p.delays[(size_t) t] = juce::jmax (1, (int) std::round (seconds * sampleRate));
+        p.gains[(size_t) t] = (float) gain;
+        energy += gain * gain;
+    }
+
+    const float scale = (float) std::sqrt (0.5 / juce::jmax (1.0e-9, energy));
+    for (auto& g : p.gains)
+        g *= scale;
+
+    return p;
+}
+
+std::shared_ptr<const EarlyReflections::Patterns> EarlyReflections::getPatterns (double sampleRate)
+{
+    // patterns already built in this process, so instances at the same rate share them
+    static juce::CriticalSection lock;
+    static std::map<double, std::weak_ptr<const Patterns>> built;
+
+    const juce::ScopedLock sl (lock);
+
+    for (auto it = built.begin(); it != built.end();)
+        it = it->second.expired() ? built.erase (it) : std::next (it);
+
+    if (const auto it = built.find (sampleRate); it != built.end())
+        if (auto existing = it->second.lock())
+            return existing;
+
+    auto patterns = std::make_shared<Patterns>();
+
+    for (int r = 0; r < numRoomSizes; ++r)
+    {
+        for (int ch = 0; ch < 2; ++ch)
+        {
+            auto& p = patterns->rooms[(size_t) r][(size_t) ch];
+            p = makePattern (sampleRate, (float) r / (float) (numRoomSizes - 1), ch);
+            patterns->maxDelay = juce::jmax (patterns->maxDelay, *std::max_element (p.delays.begin(), p.delays.end()));
+        }
+    }
+
+    built[sampleRate] = patterns;
+    return patterns;
+}
+
+void EarlyReflections::prepare (double sampleRate, int numChannels, int maximumBlockSize)
+{
+    patterns = getPatterns (sampleRate);
+
+    // a power of two, holding the longest reflection behind a whole block
+    const int size = juce::nextPowerOfTwo (patterns->maxDelay + juce::jmax (1, maximumBlockSize));
+    lines.setSize (juce::jlimit (1, 2, numChannels), size);
+    fadeBuffer.setSize (juce::jlimit (1, 2, numChannels), juce::jmax (1, maximumBlockSize));
+    mask = size - 1;
+    reset();
+}
+
+void EarlyReflections::reset() noexcept
+{
+    lines.clear();
+    writePos = 0;
+    renderedRoom = -1;
+}
+
+void EarlyReflections::push (const float* const* input, int numChannels, int numSamples) noexcept
+{
+    const int size = mask + 1;
+    const int n1 = juce::jmin (numSamples, size - writePos);
+
+    for (int ch = 0; ch < juce::jmin (numChannels, lines.getNumChannels()); ++ch)
+    {
+        auto* line = lines.getWritePointer (ch);
+        juce::FloatVectorOperations::copy (line + writePos, input[ch], n1);
+        juce::FloatVectorOperations::copy (line, input[ch] + n1, numSamples - n1);
+    }
+
+    writePos = (writePos + numSamples) & mask;
+}
+
+void EarlyReflections::gather (const Pattern& p, int channel, float* out, int numSamples) const noexcept
+{
+    const int size = mask + 1;
+    const auto* line = lines.getReadPointer (channel);
+    const int blockStart = (writePos - numSamples) & mask;
+
+    for (int t = 0; t < tapsPerChannel; ++t)
+    {
+        const int start = (blockStart - p.delays[(size_t) t]) & mask;
+        const int n1 = juce::jmin (numSamples, size - start);
+        const float g = p.gains[(size_t) t];
+
+        juce::FloatVectorOperations::addWithMultiply (out, line + start, g, n1);
+        juce::FloatVectorOperations::addWithMultiply (out + n1, line, g, numSamples - n1);
+    }
+}
+
+void EarlyReflections::render (float* const* output, int numChannels, int numSamples) noexcept
+{
+    const int channels = juce::jmin (numChannels, lines.getNumChannels());
+    const auto& current = patterns->rooms[(size_t) room];
+
+    for (int ch = 0; ch < channels; ++ch)
+    {
+        juce::FloatVectorOperations::clear (output[ch], numSamples);
+        gather (current[(size_t) ch], ch, output[ch], numSamples);
+    }
+
+    // a new room size: fade from the old pattern's reflections to the new one's
+    if (renderedRoom >= 0 && renderedRoom != room)
+    {
+        const auto& previous = patterns->rooms[(size_t) renderedRoom];
+
+        for (int ch = 0; ch < channels; ++ch)
+        {
+            auto* old = fadeBuffer.getWritePointer (ch);
+            juce::FloatVectorOperations::clear (old, numSamples);
+            gather (previous[(size_t) ch], ch, old, numSamples);
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const float fade = (float) (i + 1) / (float) numSamples;
+                output[ch][i] = old[i] + fade * (output[ch][i] - old[i]);
+            }
+        }
+    }
+
+    renderedRoom = room;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include <array>
+#include <memory>
+
+// The first reflections off a room's walls: a sparse tapped delay line, one set of taps per
+// channel, whose times and gains come from a pattern worked out in advance for each of
+// numRoomSizes room sizes. The patterns for a sample rate are built once and shared by every
+// instance running at it. Each tap adds a contiguous run of the line to the output, so the
+// reflections cost a vectorised multiply-add per tap per block.
+//
+//     reflections.prepare (48000.0, 2, 512);
+//     reflections.setRoomSize (0.5f);
+//     reflections.push (input, 2, numSamples);   // every block
+//     reflections.render (output, 2, numSamples); // only when they're wanted
+class EarlyReflections final
+{
+public:
+    static constexpr int numRoomSizes = 16;
+    static constexpr int tapsPerChannel = 16;
+    static constexpr double maxReflectionSeconds = 0.1; // the last reflection of the largest room
+
+    struct Pattern
+    {
+        std::array<int, tapsPerChannel> delays {}; // samples, at least 1
+        std::array<float, tapsPerChannel> gains {};
+    };
+
+    // Every room size's pattern for both channels at one sample rate. The two channels get
+    // different reflections, so the early sound is decorrelated like the reverb's.
+    struct Patterns
+    {
+        std::array<std::array<Pattern, 2>, numRoomSizes> rooms;
+        int maxDelay = 1;
+    };
+
+    // Not for the audio thread: the patterns for a sample rate, built on first use.
+    static std::shared_ptr<const Patterns> getPatterns (double sampleRate);
+
+    // Not for the audio thread. push() and render() take at most maximumBlockSize samples.
+    void prepare (double sampleRate, int numChannels, int maximumBlockSize);
+
+    void reset() noexcept;
+
+    // Audio thread: the pattern for the nearest room size. A new pattern fades in over the
+    // next render() call.
+    void setRoomSize (float roomSize) noexcept
+    {
+        room = juce::jlimit (0, numRoomSizes - 1, juce::roundToInt (juce::jlimit (0.0f, 1.0f, roomSize) * (float) (numRoomSizes - 1)));
+    }
+
+    // Audio thread: takes in the next numSamples of each channel's input. Call it for every
+    // block, so the line holds the recent input whenever the reflections are rendered.
+    void push (const float* const* input, int numChannels, int numSamples) noexcept;
+
+    // Audio thread: writes the reflections of the block just pushed (without the input itself).
+    void render (float* const* output, int numChannels, int numSamples) noexcept;
+
+    size_t getMemoryBytes() const noexcept
+    {
+        return (size_t) (lines.getNumChannels() * lines.getNumSamples() + fadeBuffer.getNumChannels() * fadeBuffer.getNumSamples()) * sizeof (float);
+    }
+
+private:
+    // Adds the pattern's taps on `channel` to out, ending at the line's write position.
+    void gather (const Pattern&, int channel, float* out, int numSamples) const noexcept;
+
+    std::shared_ptr<const Patterns> patterns;
+    juce::AudioBuffer<float> lines, fadeBuffer;
+    int mask = 0;
+    int writePos = 0;
+    int room = 0, renderedRoom = -1;
+};
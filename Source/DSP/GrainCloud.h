@@ -0,0 +1,514 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "DelayBuffer.h"
+#include "RealtimeWorkerPool.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+// Feed-forward layer of up to thousands of grains per second for GranularDelay's
+// cloud mode. Grains are spawned serially by the delay (so scheduling stays
+// reproducible) and then rendered in batches of grainsPerBatch, shared out over a
+// RealtimeWorkerPool plus the audio thread. Every participant starts on its own
+// slice of the batches, steals from the others when it runs dry, and accumulates
+// into its own buffer; the audio thread sums those when everyone is done.
+//
+// If the render hasn't finished by the deadline, batches nobody has started yet
+// are dropped (their grains are cut off) and the number of grains allowed at once
+// shrinks, creeping back up while there is headroom. With workers the summation
+// order then varies between runs. Without a deadline (offline) the grains are
+// instead summed in a fixed number of lanes, each claimed whole by one thread, so
+// the output is bit-identical for any number of workers.
+//
+// Cloud grains don't feed back into the delay line: they read it after the whole
+// block has been written, which is why spawn() takes care that a grain never
+// reads ahead of where the write head was at that sample. From a 16-bit line each
+// grain converts the stretch it's about to read into a scratch buffer first.
+class GrainCloud final
+{
+public:
+    static constexpr int maxGrains = 8192;
+    static constexpr int grainsPerBatch = 32;
+    static constexpr int maxBatches = maxGrains / grainsPerBatch;
+    static constexpr int minGrainLimit = 256;
+    static constexpr int deterministicLanes = 4;
+    static constexpr int scratchSize = 1024;
+
+    ~GrainCloud() { pool.stop(); }
+
+    // Message thread. numWorkers < 0 picks a count from the core count; 0 renders on the audio thread only.
+    // With one output, each grain goes in at the average of its left and right levels.
+    // maxActiveGrains sizes the grain pool; spawns beyond it are dropped.
+    void prepare (double newSampleRate, int newMaximumBlockSize, int numWorkers, int newNumOutputs = 2,
+                  int maxActiveGrains = maxGrains)
+    {
+        sampleRate = newSampleRate;
+        maximumBlockSize = juce::jmax (1, newMaximumBlockSize);
+        numOutputs = newNumOutputs > 1 ? 2 : 1;
+        capacity = juce::jlimit (1, maxGrains, maxActiveGrains);
+
+        pool.start (numWorkers < 0 ? -1 : juce::jmin (numWorkers, (int) slices.size() - 1));
+
+        numParticipants = pool.getNumWorkers() + 1;
+        accumulators.resize ((size_t) juce::jmax (numParticipants, deterministicLanes));
+        for (auto& a : accumulators)
+        {
+            a.buffer.setSize (numOutputs, maximumBlockSize);
+            a.scratch.resize (scratchSize);
+        }
+
+        grains.clear();
+        grains.shrink_to_fit();
+        grains.reserve ((size_t) capacity);
+
+        for (int i = 0; i <= windowSize; ++i)
+            window[(size_t) i] = 0.5f - 0.5f * std::cos (juce::MathConstants<float>::twoPi * (float) i / (float) windowSize);
+
+        grainLimit = maxGrains;
+        droppedGrains.store (0);
+    }
+
+    int getNumWorkers() const noexcept { return pool.getNumWorkers(); }
+
+    // Heap memory held by the grain pool and the render buffers.
+    size_t getMemoryBytes() const noexcept
+    {
+        size_t bytes = grains.capacity() * sizeof (Grain);
+
+        for (const auto& a : accumulators)
+            bytes += (size_t) a.buffer.getNumChannels() * (size_t) a.buffer.getNumSamples() * sizeof (float)
+                     + a.scratch.capacity() * sizeof (float);
+
+        return bytes;
+    }
+    int getNumActiveGrains() const noexcept { return (int) grains.size(); }
+
+    // Grains cut short or never spawned because the deadline was missed.
+    juce::int64 getNumDroppedGrains() const noexcept { return droppedGrains.load (std::memory_order_relaxed); }
+
+    bool canSpawn() const noexcept { return (int) grains.size() < juce::jmin (grainLimit, grainCap, capacity); }
+
+    // Audio thread. A fixed ceiling on top of the deadline-driven limit, for the CPU governor.
+    void setGrainCap (int newCap) noexcept { grainCap = juce::jlimit (1, maxGrains, newCap); }
+
+    // Audio thread. false reads the nearest delay sample instead of interpolating.
+    void setInterpolation (bool shouldInterpolate) noexcept { interpolate = shouldInterpolate; }
+
+    // Audio thread: stops every grain at once.
+    void clear() noexcept { grains.clear(); }
+
+    // Audio thread, during the serial pass. offset is the sample within the current block.
+    void spawn (int offset, float readPos, float readInc, int length, float panL, float panR) noexcept
+    {
+        if (! canSpawn())
+        {
+            droppedGrains.fetch_add (1, std::memory_order_relaxed);
+            return;
+        }
+
+        Grain g;
+        g.offset = offset;
+        g.length = length;
+        g.readPos = readPos;
+        g.readInc = readInc;
+        g.panL = panL;
+        g.panR = panR;
+        grains.push_back (g);
+    }
+
+    // Audio thread, after the block has been written to the delay line. Adds the cloud to
+    // out[0] (and out[1] when prepared for two outputs), spending at most budgetSeconds (0 = no limit) of wall-clock time.
+    void render (const DelayBuffer& delay, float* const* out, int numSamples, float gain, double budgetSeconds) noexcept
+    {
+        if (grains.empty() || numSamples <= 0)
+            return;
+
+        const auto startTicks = juce::Time::getHighResolutionTicks();
+        budgetTicks = budgetSeconds > 0.0 ? juce::Time::secondsToHighResolutionTicks (budgetSeconds) : 0;
+        deadlineTicks = budgetTicks > 0 ? startTicks + budgetTicks : std::numeric_limits<juce::int64>::max();
+        deterministic = budgetTicks <= 0;
+        const int numAccumulators = deterministic ? deterministicLanes : numParticipants;
+
+        bool missedDeadline = false;
+
+        for (int start = 0; start < numSamples; start += maximumBlockSize)
+        {
+            const int n = juce::jmin (maximumBlockSize, numSamples - start);
+            missedDeadline = ! renderChunk (delay, start, n, gain) || missedDeadline;
+
+            for (int ch = 0; ch < numOutputs; ++ch)
+                for (int a = 0; a < numAccumulators; ++a)
+                    juce::FloatVectorOperations::add (out[ch] + start, accumulators[(size_t) a].buffer.getReadPointer (ch), n);
+        }
+
+        removeFinishedGrains();
+        adaptGrainLimit (missedDeadline, juce::Time::getHighResolutionTicks() - startTicks);
+    }
+
+private:
+    struct Grain
+    {
+        int offset = 0;      // first sample to render in the current block
+        int age = 0;
+        int length = 0;
+        float readPos = 0.0f;
+        float readInc = 1.0f;
+        float panL = 0.5f;
+        float panR = 0.5f;
+        bool dropped = false;
+    };
+
+    struct alignas (64) Slice
+    {
+        std::atomic<int> next { 0 };
+        int end = 0;
+    };
+
+    struct Accumulator
+    {
+        juce::AudioBuffer<float> buffer;
+        std::vector<float> scratch; // converted delay samples, for 16-bit lines
+    };
+
+    // Shared state for one dispatched chunk; RealtimeWorkerPool calls run() on each worker.
+    struct ChunkTask final : public RealtimeWorkerPool::Task
+    {
+        explicit ChunkTask (GrainCloud& c) : cloud (c) {}
+
+        void run (int workerIndex) noexcept override
+        {
+            active.fetch_add (1);
+
+            if (! cancelled.load())
+                cloud.renderBatches (workerIndex);
+
+            active.fetch_sub (1, std::memory_order_release);
+        }
+
+        GrainCloud& cloud;
+        std::atomic<bool> cancelled { true };
+        std::atomic<int> active { 0 };
+        std::atomic<int> batchesDone { 0 };
+    };
+
+    bool renderChunk (const DelayBuffer& delay, int start, int n, float gain) noexcept
+    {
+        chunkDelayLine = &delay;
+        chunkDelay = delay.getFloatData();
+        chunkDelaySize = delay.getSize();
+        chunkStart = start;
+        chunkLength = n;
+        chunkGain = gain;
+
+        numBatches = ((int) grains.size() + grainsPerBatch - 1) / grainsPerBatch;
+
+        for (auto& a : accumulators)
+            a.buffer.clear (0, n);
+
+        for (int p = 0; p < numParticipants; ++p)
+        {
+            slices[(size_t) p].next.store (p * numBatches / numParticipants, std::memory_order_relaxed);
+            slices[(size_t) p].end = (p + 1) * numBatches / numParticipants;
+        }
+
+        nextLane.store (0, std::memory_order_relaxed);
+
+        std::fill (batchClaimed.begin(), batchClaimed.begin() + numBatches, false);
+        task.batchesDone.store (0, std::memory_order_relaxed);
+
+        // late wake-ups from the previous chunk see cancelled == true until everything above is set up
+        task.cancelled.store (false);
+        pool.dispatch (task);
+
+        renderBatches (0);
+
+        while (task.batchesDone.load (std::memory_order_acquire) < numBatches
+               && juce::Time::getHighResolutionTicks() < deadlineTicks)
+            RealtimeWorkerPool::pause();
+
+        // Stop anyone from claiming more, then wait for batches already in progress.
+        task.cancelled.store (true);
+        while (task.active.load() != 0)
+            RealtimeWorkerPool::pause();
+
+        const bool complete = task.batchesDone.load (std::memory_order_acquire) == numBatches;
+
+        if (! complete)
+        {
+            for (int b = 0; b < numBatches; ++b)
+            {
+                if (batchClaimed[(size_t) b])
+                    continue;
+
+                const int end = juce::jmin ((int) grains.size(), (b + 1) * grainsPerBatch);
+                for (int i = b * grainsPerBatch; i < end; ++i)
+                    grains[(size_t) i].dropped = true;
+
+                droppedGrains.fetch_add (end - b * grainsPerBatch, std::memory_order_relaxed);
+            }
+        }
+
+        return complete;
+    }
+
+    int claimBatch (int participant) noexcept
+    {
+        for (int k = 0; k < numParticipants; ++k)
+        {
+            auto& slice = slices[(size_t) ((participant + k) % numParticipants)];
+            const int b = slice.next.fetch_add (1, std::memory_order_relaxed);
+            if (b < slice.end)
+                return b;
+        }
+
+        return -1;
+    }
+
+    void renderBatches (int participant) noexcept
+    {
+        if (deterministic)
+        {
+            // lane l holds batches l, l + lanes, ...; whoever claims a lane renders all of it, in order
+            for (int lane = nextLane++; lane < deterministicLanes && ! task.cancelled.load (std::memory_order_relaxed); lane = nextLane++)
+            {
+                auto& acc = accumulators[(size_t) lane];
+                auto* outL = acc.buffer.getWritePointer (0);
+                auto* outR = acc.buffer.getWritePointer (numOutputs - 1);
+
+                for (int b = lane; b < numBatches; b += deterministicLanes)
+                {
+                    batchClaimed[(size_t) b] = true;
+                    renderBatch (b, outL, outR, acc.scratch.data());
+
+                    task.batchesDone.fetch_add (1, std::memory_order_release);
+                }
+            }
+
+            return;
+        }
+
+        auto& acc = accumulators[(size_t) participant];
+        auto* outL = acc.buffer.getWritePointer (0);
+        auto* outR = acc.buffer.getWritePointer (numOutputs - 1);
+
+        while (! task.cancelled.load (std::memory_order_relaxed))
+        {
+            if (participant == 0 && juce::Time::getHighResolutionTicks() >= deadlineTicks)
+                return;
+
+            const int b = claimBatch (participant);
+            if (b < 0)
+                return;
+
+            batchClaimed[(size_t) b] = true;
+
+            renderBatch (b, outL, outR, acc.scratch.data());
+
+            task.batchesDone.fetch_add (1, std::memory_order_release);
+        }
+    }
+
+    void renderBatch (int b, float* outL, float* outR, float* scratch) noexcept
+    {
+        const int end = juce::jmin ((int) grains.size(), (b + 1) * grainsPerBatch);
+
+        for (int i = b * grainsPerBatch; i < end; ++i)
+        {
+            auto& g = grains[(size_t) i];
+
+            if (chunkDelay == nullptr)
+                renderGrainFromScratch (g, outL, outR, scratch);
+            else if (numOutputs == 1)
+            {
+                if (interpolate) renderGrain<true, false> (g, outL, outR);
+                else             renderGrain<false, false> (g, outL, outR);
+            }
+            else
+            {
+                if (interpolate) renderGrain<true, true> (g, outL, outR);
+                else             renderGrain<false, true> (g, outL, outR);
+            }
+        }
+    }
+
+    float windowAt (int age, float windowScale) const noexcept
+    {
+        const float x = (float) age * windowScale;
+        const int w0 = (int) x;
+        return window[(size_t) w0] + (x - (float) w0) * (window[(size_t) juce::jmin (w0 + 1, windowSize)] - window[(size_t) w0]);
+    }
+
+    template <bool interpolated, bool stereo>
+    void renderGrain (Grain& g, float* outL, float* outR) const noexcept
+    {
+        const int from = juce::jmax (0, g.offset - chunkStart);
+        if (g.dropped || from >= chunkLength)
+            return;
+
+        const int n = juce::jmin (chunkLength - from, g.length - g.age);
+        const float size = (float) chunkDelaySize;
+        const float windowScale = (float) windowSize / (float) juce::jmax (1, g.length - 1);
+        const float monoPan = 0.5f * (g.panL + g.panR);
+
+        for (int i = from; i < from + n; ++i)
+        {
+            float s;
+
+            if constexpr (interpolated)
+            {
+                const int i0 = (int) g.readPos;
+                const int i1 = i0 + 1 < chunkDelaySize ? i0 + 1 : 0;
+                const float frac = g.readPos - (float) i0;
+                s = chunkDelay[i0] + frac * (chunkDelay[i1] - chunkDelay[i0]);
+            }
+            else
+            {
+                const int i0 = (int) (g.readPos + 0.5f);
+                s = chunkDelay[i0 < chunkDelaySize ? i0 : 0];
+            }
+
+            const float v = chunkGain * s * windowAt (g.age, windowScale);
+
+            if constexpr (stereo)
+            {
+                outL[i] += v * g.panL;
+                outR[i] += v * g.panR;
+            }
+            else
+            {
+                outL[i] += v * monoPan;
+            }
+
+            g.readPos += g.readInc;
+            if (g.readPos >= size)
+                g.readPos -= size;
+
+            ++g.age;
+        }
+    }
+
+    // 16-bit lines: converts the samples each run of output samples reads into scratch in
+    // one pass, then reads from there.
+    void renderGrainFromScratch (Grain& g, float* outL, float* outR, float* scratch) const noexcept
+    {
+        const int from = juce::jmax (0, g.offset - chunkStart);
+        if (g.dropped || from >= chunkLength)
+            return;
+
+        const int n = juce::jmin (chunkLength - from, g.length - g.age);
+        const float size = (float) chunkDelaySize;
+        const float windowScale = (float) windowSize / (float) juce::jmax (1, g.length - 1);
+        const int maxRun = juce::jmax (1, (int) ((float) (scratchSize - 3) / juce::jmax (1.0f, g.readInc)));
+
+        for (int i = from; i < from + n;)
+        {
+            const int run = juce::jmin (maxRun, from + n - i);
+            const int first = (int) g.readPos;
+            chunkDelayLine->read (first, scratch, juce::jmin (scratchSize, (int) ((float) run * g.readInc) + 3));
+
+            float pos = g.readPos - (float) first;
+
+            for (const int end = i + run; i < end; ++i)
+            {
+                float s;
+
+                if (interpolate)
+                {
+                    const int i0 = (int) pos;
+                    s = scratch[i0] + (pos - (float) i0) * (scratch[i0 + 1] - scratch[i0]);
+                }
+                else
+                {
+                    s = scratch[(int) (pos + 0.5f)];
+                }
+
+                const float v = chunkGain * s * windowAt (g.age, windowScale);
+
+                if (numOutputs == 1)
+                {
+                    outL[i] += v * (0.5f * (g.panL + g.panR));
+                }
+                else
+                {
+                    outL[i] += v * g.panL;
+                    outR[i] += v * g.panR;
+                }
+
+                pos += g.readInc;
+                ++g.age;
+            }
+
+            g.readPos = (float) first + pos;
+            while (g.readPos >= size)
+                g.readPos -= size;
+        }
+    }
+
+    void removeFinishedGrains() noexcept
+    {
+        for (size_t i = 0; i < grains.size();)
+        {
+            auto& g = grains[i];
+            g.offset = 0;
+
+            if (g.dropped || g.age >= g.length)
+            {
+                g = grains.back();
+                grains.pop_back();
+            }
+            else
+            {
+                ++i;
+            }
+        }
+    }
+
+    void adaptGrainLimit (bool missedDeadline, juce::int64 elapsedTicks) noexcept
+    {
+        if (budgetTicks <= 0)
+            grainLimit = maxGrains;
+        else if (missedDeadline)
+            grainLimit = juce::jmax (minGrainLimit, (int) grains.size() * 3 / 4);
+        else if (elapsedTicks * 2 < budgetTicks) // plenty of headroom: let the cloud grow back slowly
+            grainLimit = juce::jmin (maxGrains, grainLimit + juce::jmax (1, grainLimit / 32));
+    }
+
+    static constexpr int windowSize = 4096;
+
+    double sampleRate = 48000.0;
+    int maximumBlockSize = 512;
+    int numOutputs = 2;
+    int capacity = maxGrains;
+    std::array<float, windowSize + 1> window {};
+
+    std::vector<Grain> grains;
+    int grainLimit = maxGrains;
+    int grainCap = maxGrains;
+    bool interpolate = true;
+    std::atomic<juce::int64> droppedGrains { 0 };
+
+    RealtimeWorkerPool pool;
+    int numParticipants = 1;
+    bool deterministic = false;
+    std::atomic<int> nextLane { 0 };
+    std::vector<Accumulator> accumulators;
+    std::array<Slice, 16> slices;
+    std::array<bool, maxBatches> batchClaimed {};
+    ChunkTask task { *this };
+
+    const DelayBuffer* chunkDelayLine = nullptr;
+    const float* chunkDelay = nullptr; // the line's samples when they're floats
+    int chunkDelaySize = 1;
+    int chunkStart = 0;
+    int chunkLength = 0;
+    float chunkGain = 1.0f;
+    int numBatches = 0;
+    juce::int64 budgetTicks = 0;
+    juce::int64 deadlineTicks = 0;
+};
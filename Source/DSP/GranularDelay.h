@@ -3,9 +3,43 @@
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <juce_dsp/juce_dsp.h>
 
+#include "DelayBuffer.h"
+#include "GrainCloud.h"
+#include "LongMemory.h"
+#include "SampleSource.h"
+#include "../Diagnostics/TraceRecorder.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <limits>
+#include <vector>
+
 class GranularDelay final
 {
 public:
+    static constexpr int maxTaps = 4;
+
+    // A grain stream alongside the main one, reading the same delay line at its own time,
+    // with its own rate, pitch, stereo position and level. Grain size, jitter, spread, drift
+    // and feedback are shared with the main stream.
+    struct Tap
+    {
+        float delayTimeMs = 450.0f;
+        float density = 8.0f;        // grains/s
+        float pitchSemitones = 0.0f;
+        float pan = 0.0f;            // -1 (left) .. 1 (right); the grains scatter around it by Spread
+        float level = 1.0f;          // linear gain
+
+        bool operator== (const Tap& other) const noexcept
+        {
+            return delayTimeMs == other.delayTimeMs && density == other.density && pitchSemitones == other.pitchSemitones
+                   && pan == other.pan && level == other.level;
+        }
+
+        bool operator!= (const Tap& other) const noexcept { return ! operator== (other); }
+    };
+
     struct Params
     {
         float inputGain = 1.0f;
@@ -21,104 +55,696 @@ public:
         float modRateHz = 0.35f;
         float modDepth = 0.25f;
         bool freeze = false;
+
+        float cloudDensity = 0.0f; // extra grains/s rendered by the multi-threaded cloud; 0 = off
+        float memory = 0.0f;       // how far back into the long memory core grains reach, 0..1; 0 = off
+
+        // Extra taps, the first numTaps of them. Their grains share the voice limit with the
+        // main stream's, and only the main stream reaches into the long memory.
+        std::array<Tap, maxTaps> taps {};
+        int numTaps = 0;
+
+        // Played into the delay line in place of the input (which still makes up the dry
+        // signal), looping, from where it was last left; freeze pauses it. Must outlive the
+        // process() calls it's passed to.
+        const SampleSource* source = nullptr;
+    };
+
+    // Ways to spend less CPU, for the engine's governor. The defaults are full quality.
+    struct Quality
+    {
+        int maxVoices = 0;                          // core grains at once; 0 = as many as the pool holds
+        int maxCloudGrains = GrainCloud::maxGrains;
+        bool interpolate = true;                    // false: nearest-sample delay reads
+        int controlInterval = 1;                    // samples between drift updates
     };
 
+    static constexpr int grainPoolSize = 128;
+
+    // Freeze captures this much of the grain output and loops it, with the seam crossfaded
+    // over freezeSeamSeconds; the delay line covers both with room to spare.
+    static constexpr double freezeLoopSeconds = 2.0;
+    static constexpr double freezeSeamSeconds = 0.25;
+
+    // The parameter ranges the delay line and grain pools are sized for; the engine checks
+    // them against its parameter table.
+    static constexpr float maxDelayTimeMs = 2000.0f;
+    static constexpr float maxGrainSizeMs = 250.0f;
+    static constexpr float maxJitter = 1.0f;
+    static constexpr float maxCloudDensity = 5000.0f;
+    static constexpr float maxReadIncrement = 2.5f; // +14 semitones (Pitch plus Glass) and the drift detune
+
+    // Enough history for the longest delay plus the furthest a grain can be scattered
+    // behind it (jitter, drift offset), and for a grain reading at the highest pitch to
+    // play out; the cloud clamps its grains to the same length.
+    static int getDelayLength (double sampleRate)
+    {
+        const double grainSeconds = maxGrainSizeMs / 1000.0;
+        const double seconds = maxDelayTimeMs / 1000.0 + (maxJitter + 0.2 + 0.15 + maxReadIncrement) * grainSeconds;
+        return (int) std::ceil (sampleRate * seconds) + 4;
+    }
+
+    // The most cloud grains that can be playing at once: those started within one grain
+    // length, plus the ones finished during the current block, which are removed at its end.
+    static int getMaxCloudGrains (double sampleRate, int maximumBlockSize)
+    {
+        const double seconds = maxGrainSizeMs / 1000.0 + maximumBlockSize / juce::jmax (1.0, sampleRate);
+        return juce::jmin (GrainCloud::maxGrains, (int) std::ceil (maxCloudDensity * seconds) + 1);
+    }
+
+    // Decides when grains start and how they're scattered, and runs the drift random walk.
+    // One scheduler can drive several GranularDelays (one per channel group), which then
+    // play the same grain pattern from their own delay lines; a GranularDelay used on its
+    // own drives itself from an internal one. The main stream's grains and the taps' go into
+    // the one list of core grains, so the render loop costs the same per grain whichever
+    // stream it came from.
+    class Scheduler
+    {
+    public:
+        struct CoreGrain
+        {
+            int offset;
+            float delay; // samples behind the write head: its stream's delay time
+            float jitter, driftOffset, readInc, panL, panR, gain;
+            bool fromMemory; // plays from the long memory, at the next position drawn for it
+        };
+
+        // A position drawn for an upcoming long-memory grain, as an age behind the history's
+        // write head at `offset`, so the delays can fetch its pages before the grain starts.
+        struct MemoryDraw
+        {
+            int offset;
+            juce::int64 age;
+        };
+
+        // Long-memory positions are drawn this many grains ahead of the grains that use them.
+        static constexpr int memoryLookahead = 8;
+
+        struct CloudGrain
+        {
+            int offset;
+            float lag, readInc, panL, panR;
+        };
+
+        // memoryLength is the long memory's length in samples (LongMemory::getLength()), 0 if
+        // there is none.
+        void prepare (double newSampleRate, int maximumBlockSize, juce::int64 newMemoryLength = 0)
+        {
+            sampleRate = newSampleRate;
+            delayLength = getDelayLength (sampleRate);
+            memoryLength = newMemoryLength;
+
+            if (fixedSeed)
+            {
+                rng.setSeed (seed);
+                cloudRng.setSeed (seed + 1);
+                memoryRng.setSeed (seed + 2);
+                tapRng.setSeed (seed + 3);
+            }
+            else
+            {
+                rng.setSeedRandomly();
+                cloudRng.setSeedRandomly();
+                memoryRng.setSeedRandomly();
+                tapRng.setSeedRandomly();
+            }
+
+            spawnAccumulator = 0.0;
+            tapSpawnAccumulators.fill (0.0);
+            cloudSpawnAccumulator = 0.0;
+            controlPhase = 0;
+            driftReadOffset = 0.0f;
+            driftDetune = 0.0f;
+            now = 0;
+
+            grainEnds.clear();
+            grainEnds.reserve (grainPoolSize);
+            coreGrains.clear();
+            coreGrains.reserve (2 * grainPoolSize);
+            cloudGrains.clear();
+            cloudGrains.reserve ((size_t) juce::jmax (1, maximumBlockSize)); // the cloud tops out well below one grain per sample
+            memoryDraws.clear();
+            memoryDraws.reserve (memoryLookahead + 2 * grainPoolSize);
+            pendingMemoryGrains = 0;
+        }
+
+        // Makes grain scheduling reproducible from the next prepare() on (offline renders, tests).
+        void setRandomSeed (juce::int64 newSeed)
+        {
+            seed = newSeed;
+            fixedSeed = true;
+        }
+
+       #if STARLIGHT_TRACING
+        void setTraceRecorder (TraceRecorder* r) { trace = r; }
+       #endif
+
+        // Audio thread: works out the next numSamples worth of grains.
+        void schedule (const Params& params, const Quality& quality, int numSamples) noexcept
+        {
+            coreGrains.clear();
+            cloudGrains.clear();
+            memoryDraws.clear();
+
+            if (sampleRate <= 0.0)
+                return;
+
+            baseDelaySamples = (params.delayTimeMs / 1000.0f) * (float) sampleRate;
+
+            const float basePitch = std::pow (2.0f, params.pitchSemitones / 12.0f);
+            const float density = juce::jmax (0.001f, params.density);
+            const float grainSizeMs = juce::jlimit (10.0f, maxGrainSizeMs, params.grainSizeMs);
+            grainSamples = (int) juce::jmax (8.0, (grainSizeMs / 1000.0f) * sampleRate);
+
+            const float drift = params.drift;
+            const float modRate = params.modRateHz;
+            const float modDepth = params.modDepth;
+
+            const float jitterSamplesMax = (params.jitter + 0.2f * drift) * (float) grainSamples;
+            const float spread = juce::jlimit (0.0f, 1.0f, params.spread);
+
+            const float driftStep = (0.00002f + 0.0002f * modRate) * drift;
+            const float detuneStep = (0.000001f + 0.00002f * modRate) * drift;
+
+            const float cloudDensity = juce::jmax (0.0f, params.cloudDensity);
+
+            // a random walk updated every n samples needs sqrt (n) times the step to wander as far
+            const int controlInterval = juce::jmax (1, quality.controlInterval);
+            const float controlScale = std::sqrt ((float) controlInterval);
+            const size_t maxVoices = quality.maxVoices > 0 ? juce::jmin ((size_t) quality.maxVoices, (size_t) grainPoolSize)
+                                                           : (size_t) grainPoolSize;
+            controlPhase %= controlInterval;
+
+            // long-memory grains start anywhere from past the delay line's reach to Memory's
+            // share of the history, leaving their pages a few seconds before they drop out of it
+            const juce::int64 minAge = delayLength;
+            const juce::int64 maxAge = juce::jmin (memoryLength - (juce::int64) (memoryMargin * sampleRate),
+                                                   minAge + (juce::int64) (juce::jlimit (0.0f, 1.0f, params.memory) * (float) (memoryLength - minAge)));
+            const bool useMemory = params.memory > 0.0f && maxAge > minAge;
+
+            const int numTaps = juce::jlimit (0, maxTaps, params.numTaps);
+            std::array<TapSettings, maxTaps> taps;
+
+            for (int t = 0; t < numTaps; ++t)
+            {
+                const auto& tap = params.taps[(size_t) t];
+                auto& settings = taps[(size_t) t];
+                settings.delay = (juce::jlimit (0.0f, maxDelayTimeMs, tap.delayTimeMs) / 1000.0f) * (float) sampleRate;
+                settings.spawnIncrement = juce::jmax (0.0f, tap.density) / sampleRate;
+                settings.pitch = std::pow (2.0f, tap.pitchSemitones / 12.0f);
+                settings.pan = juce::jlimit (-1.0f, 1.0f, tap.pan);
+                settings.gain = juce::jmax (0.0f, tap.level);
+            }
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                while (useMemory && pendingMemoryGrains < memoryLookahead && memoryDraws.size() < memoryDraws.capacity())
+                {
+                    memoryDraws.push_back ({ i, minAge + (juce::int64) (memoryRng.nextDouble() * (double) (maxAge - minAge)) });
+                    ++pendingMemoryGrains;
+                }
+
+                // non-LFO "drift": random walk, very slow
+                if (controlPhase == 0)
+                {
+                    driftReadOffset = juce::jlimit (-1.0f, 1.0f, driftReadOffset + controlScale * driftStep * (rng.nextFloat() * 2.0f - 1.0f));
+                    driftDetune = juce::jlimit (-1.0f, 1.0f, driftDetune + controlScale * detuneStep * (rng.nextFloat() * 2.0f - 1.0f));
+                }
+
+                if (++controlPhase == controlInterval)
+                    controlPhase = 0;
+
+                spawnAccumulator += density / sampleRate;
+                while (spawnAccumulator >= 1.0)
+                {
+                    spawnAccumulator -= 1.0;
+
+                    // never grow the grain pool on the audio thread
+                    if (countPlayingGrains (now + i) >= maxVoices || coreGrains.size() >= coreGrains.capacity())
+                        continue;
+
+                    CoreGrain g;
+                    g.offset = i;
+                    g.delay = baseDelaySamples;
+                    g.gain = 1.0f;
+                    g.jitter = (rng.nextFloat() * 2.0f - 1.0f) * jitterSamplesMax;
+                    g.driftOffset = driftReadOffset * (modDepth * 0.15f) * (float) grainSamples;
+
+                    const float detune = (rng.nextFloat() * 2.0f - 1.0f) * (0.02f * drift * modDepth) + driftDetune * (0.04f * drift * modDepth);
+                    g.readInc = basePitch * std::pow (2.0f, detune);
+
+                    const float pan = (rng.nextFloat() * 2.0f - 1.0f) * spread;
+                    g.panL = juce::jlimit (0.0f, 1.0f, 0.5f - 0.5f * pan);
+                    g.panR = juce::jlimit (0.0f, 1.0f, 0.5f + 0.5f * pan);
+
+                    g.fromMemory = useMemory && pendingMemoryGrains > 0;
+                    if (g.fromMemory)
+                        --pendingMemoryGrains;
+
+                    coreGrains.push_back (g);
+                    grainEnds.push_back (now + i + grainSamples);
+                    STARLIGHT_TRACE_INSTANT (trace, "grainSpawn");
+                }
+
+                for (int t = 0; t < numTaps; ++t)
+                {
+                    auto& accumulator = tapSpawnAccumulators[(size_t) t];
+                    accumulator += taps[(size_t) t].spawnIncrement;
+
+                    while (accumulator >= 1.0)
+                    {
+                        accumulator -= 1.0;
+
+                        if (countPlayingGrains (now + i) >= maxVoices || coreGrains.size() >= coreGrains.capacity())
+                            continue;
+
+                        scheduleTapGrain (taps[(size_t) t], i, jitterSamplesMax, modDepth, drift, spread);
+                    }
+                }
+
+                cloudSpawnAccumulator += cloudDensity / sampleRate;
+                while (cloudSpawnAccumulator >= 1.0)
+                {
+                    cloudSpawnAccumulator -= 1.0;
+                    scheduleCloudGrain (params, i, jitterSamplesMax, basePitch, spread);
+                }
+            }
+
+            now += numSamples;
+        }
+
+        size_t getMemoryBytes() const noexcept
+        {
+            return grainEnds.capacity() * sizeof (juce::int64) + coreGrains.capacity() * sizeof (CoreGrain)
+                   + cloudGrains.capacity() * sizeof (CloudGrain) + memoryDraws.capacity() * sizeof (MemoryDraw);
+        }
+
+        // What the last schedule() call decided, in order of offset within the block.
+        const std::vector<CoreGrain>& getCoreGrains() const noexcept { return coreGrains; }
+        const std::vector<CloudGrain>& getCloudGrains() const noexcept { return cloudGrains; }
+        const std::vector<MemoryDraw>& getMemoryDraws() const noexcept { return memoryDraws; }
+        int getGrainSamples() const noexcept { return grainSamples; }
+        float getBaseDelaySamples() const noexcept { return baseDelaySamples; }
+
+    private:
+        // A tap's settings in the units the scheduler works in.
+        struct TapSettings
+        {
+            float delay = 0.0f;          // samples
+            double spawnIncrement = 0.0; // grains per sample
+            float pitch = 1.0f;          // read increment
+            float pan = 0.0f, gain = 1.0f;
+        };
+
+        // A tap's grains are scattered like the main stream's, around the tap's own time, pitch
+        // and stereo position, from a generator of their own so adding a tap leaves the main
+        // stream's grains where they were.
+        void scheduleTapGrain (const TapSettings& tap, int offset, float jitterSamplesMax, float modDepth, float drift, float spread) noexcept
+        {
+            CoreGrain g;
+            g.offset = offset;
+            g.delay = tap.delay;
+            g.gain = tap.gain;
+            g.jitter = (tapRng.nextFloat() * 2.0f - 1.0f) * jitterSamplesMax;
+            g.driftOffset = driftReadOffset * (modDepth * 0.15f) * (float) grainSamples;
+
+            const float detune = (tapRng.nextFloat() * 2.0f - 1.0f) * (0.02f * drift * modDepth) + driftDetune * (0.04f * drift * modDepth);
+            g.readInc = tap.pitch * std::pow (2.0f, detune);
+
+            const float pan = juce::jlimit (-1.0f, 1.0f, tap.pan + (tapRng.nextFloat() * 2.0f - 1.0f) * spread);
+            g.panL = juce::jlimit (0.0f, 1.0f, 0.5f - 0.5f * pan);
+            g.panR = juce::jlimit (0.0f, 1.0f, 0.5f + 0.5f * pan);
+
+            g.fromMemory = false;
+            coreGrains.push_back (g);
+            grainEnds.push_back (now + offset + grainSamples);
+            STARLIGHT_TRACE_INSTANT (trace, "grainSpawn");
+        }
+
+        // A grain plays until the render pass of the sample where it turns grainSamples old,
+        // so at a spawn check it's still there if it ends on or after this sample.
+        size_t countPlayingGrains (juce::int64 sample) noexcept
+        {
+            grainEnds.erase (std::remove_if (grainEnds.begin(), grainEnds.end(), [sample] (juce::int64 end) { return end < sample; }),
+                             grainEnds.end());
+            return grainEnds.size();
+        }
+
+        // Same scattering as the core grains, from a separate generator so the core's random
+        // sequence doesn't depend on the cloud. The grain starts far enough behind the write
+        // head that it can't catch up with it, since the cloud reads the delay line only after
+        // the whole block has been written.
+        void scheduleCloudGrain (const Params& params, int offset, float jitterSamplesMax, float basePitch, float spread) noexcept
+        {
+            const float jitter = (cloudRng.nextFloat() * 2.0f - 1.0f) * jitterSamplesMax;
+            const float detune = (cloudRng.nextFloat() * 2.0f - 1.0f) * (0.02f * params.drift * params.modDepth)
+                                 + driftDetune * (0.04f * params.drift * params.modDepth);
+            const float pan = (cloudRng.nextFloat() * 2.0f - 1.0f) * spread;
+
+            if (cloudGrains.size() >= cloudGrains.capacity())
+                return;
+
+            CloudGrain g;
+            g.offset = offset;
+            g.readInc = basePitch * std::pow (2.0f, detune);
+
+            const float minLag = (float) grainSamples * juce::jmax (0.0f, g.readInc - 1.0f) + 2.0f;
+            const float maxLag = (float) delayLength - (float) grainSamples * juce::jmax (1.0f, g.readInc) - 2.0f;
+            const float driftOffset = driftReadOffset * (params.modDepth * 0.15f) * (float) grainSamples;
+            g.lag = juce::jlimit (minLag, juce::jmax (minLag, maxLag), baseDelaySamples - jitter - driftOffset);
+
+            g.panL = juce::jlimit (0.0f, 1.0f, 0.5f - 0.5f * pan);
+            g.panR = juce::jlimit (0.0f, 1.0f, 0.5f + 0.5f * pan);
+            cloudGrains.push_back (g);
+        }
+
+        // seconds of lead time a long-memory position is drawn with before its pages could leave the history
+        static constexpr double memoryMargin = 2.0;
+
+        double sampleRate = 48000.0;
+        int delayLength = 1;
+        juce::int64 memoryLength = 0;
+
+        juce::Random rng, cloudRng, memoryRng, tapRng;
+        juce::int64 seed = 0;
+        bool fixedSeed = false;
+
+        double spawnAccumulator = 0.0;
+        std::array<double, maxTaps> tapSpawnAccumulators {};
+        double cloudSpawnAccumulator = 0.0;
+        int controlPhase = 0;
+        float driftReadOffset = 0.0f;
+        float driftDetune = 0.0f;
+
+        juce::int64 now = 0;
+        std::vector<juce::int64> grainEnds;
+
+        int grainSamples = 8;
+        float baseDelaySamples = 0.0f;
+        std::vector<CoreGrain> coreGrains;
+        std::vector<CloudGrain> cloudGrains;
+        std::vector<MemoryDraw> memoryDraws;
+        int pendingMemoryGrains = 0; // drawn, not yet handed to a grain
+
+       #if STARLIGHT_TRACING
+        TraceRecorder* trace = nullptr;
+       #endif
+    };
+
+    // spec.numChannels picks the layout: 1 for mono in and out, otherwise stereo.
     void prepare (const juce::dsp::ProcessSpec& spec)
     {
         sampleRate = spec.sampleRate;
+        stereo = spec.numChannels > 1;
 
-        const int maxDelaySamples = (int) juce::jmax (1.0, sampleRate * 4.0); // 4 seconds
-        for (auto& b : delayBuffer)
-            b.setSize (1, maxDelaySamples);
+        delayLine.setSize (getDelayLength (sampleRate), storageFormat);
 
         writePos = 0;
-        rng.setSeedRandomly();
+        feedbackSample = 0.0f;
+        currentSource = nullptr;
+        sourcePosition = 0.0;
+
+        // one Hann window at a time, for whichever grain size is current
+        window.assign ((size_t) juce::jmax (8, (int) (maxGrainSizeMs / 1000.0 * sampleRate)) + 1, 0.0f);
+        windowLength = 0;
+
+        publishLoop (false);
+        loopLength = juce::jmax (2, (int) (freezeLoopSeconds * sampleRate));
+        seamLength = juce::jlimit (1, loopLength / 2, (int) (freezeSeamSeconds * sampleRate));
+        freezeSource.setSize (loopLength, storageFormat);
+        frozenWet[0].setSize (loopLength + seamLength, storageFormat);
+        frozenWet[1].setSize (stereo ? loopLength + seamLength : 1, storageFormat);
+
+        // equal power: the two sides of the seam are unrelated stretches of sound
+        seamFade.resize ((size_t) seamLength);
+        for (int k = 0; k < seamLength; ++k)
+            seamFade[(size_t) k] = std::sin (juce::MathConstants<float>::halfPi * ((float) k + 0.5f) / (float) seamLength);
+
+        freezeState = FreezeState::live;
 
         activeGrains.clear();
-        activeGrains.reserve (128);
+        activeGrains.reserve (grainPoolSize);
 
-        spawnAccumulator = 0.0;
-        driftReadOffset = 0.0f;
-        driftDetune = 0.0f;
+        history.prepare (sampleRate, historySeconds, historyWaitsForPages);
+        memoryQueueStart = 0;
+        memoryQueueSize = 0;
+
+        ownScheduler.prepare (sampleRate, (int) spec.maximumBlockSize, history.getLength());
+        cloud.prepare (sampleRate, (int) spec.maximumBlockSize, cloudWorkers, stereo ? 2 : 1,
+                       getMaxCloudGrains (sampleRate, (int) spec.maximumBlockSize));
     }
 
     void setParams (const Params& p) { params = p; }
 
+    // How the delay line stores its samples (see DelayBuffer), applied on the next prepare().
+    void setStorageFormat (DelayBuffer::Format newFormat) { storageFormat = newFormat; }
+    DelayBuffer::Format getStorageFormat() const noexcept { return storageFormat; }
+
+    // Seconds of input kept in the long memory (see LongMemory), applied on the next
+    // prepare(); 0 turns it off. waitForPages trades the background pager for page reads on
+    // the calling thread, for offline renders. A shared Scheduler must be prepared with the
+    // memory's length.
+    void setLongMemory (double seconds, bool waitForPages = false)
+    {
+        historySeconds = seconds;
+        historyWaitsForPages = waitForPages;
+    }
+
+    const LongMemory& getLongMemory() const noexcept { return history; }
+
+    // Heap memory held for the delay line, the grain pools, the cloud, the freeze loop and
+    // the long memory's RAM pages, once prepared.
+    size_t getMemoryBytes() const noexcept
+    {
+        return delayLine.getMemoryBytes() + activeGrains.capacity() * sizeof (Grain)
+               + ownScheduler.getMemoryBytes() + cloud.getMemoryBytes() + history.getMemoryBytes()
+               + freezeSource.getMemoryBytes() + frozenWet[0].getMemoryBytes() + frozenWet[1].getMemoryBytes()
+               + (window.capacity() + seamFade.capacity()) * sizeof (float);
+    }
+
+    // Samples per channel in a completed freeze's recording, once prepared; the first
+    // getFreezeSeamLength() lead into the loop (see playFrozen()).
+    int getFrozenLoopLength() const noexcept { return loopLength + seamLength; }
+    int getFreezeSeamLength() const noexcept { return seamLength; }
+
+    // Any thread: copies a completed freeze's recording into dest, one channel per channel
+    // of the delay, getFrozenLoopLength() samples each. False if the freeze is still
+    // recording, has ended, or ends or restarts during the copy.
+    bool copyFrozenLoop (float* const* dest) const noexcept
+    {
+        const auto version = loopVersion.load (std::memory_order_acquire);
+        if ((version & 1) != 0)
+            return false;
+
+        for (int ch = 0; ch < (stereo ? 2 : 1); ++ch)
+            frozenWet[(size_t) ch].read (0, dest[ch], getFrozenLoopLength());
+
+        std::atomic_thread_fence (std::memory_order_acquire);
+        return loopVersion.load (std::memory_order_relaxed) == version;
+    }
+
+    // Audio thread, while frozen: swaps `loop` in for the freeze's recording and replays it
+    // from the start of the loop, as if it had just been recorded. Both buffers (the second
+    // one sample long in mono) have to match the recording's size and format; otherwise
+    // nothing happens and this returns false.
+    bool restoreFrozenLoop (std::array<DelayBuffer, 2>& loop) noexcept
+    {
+        for (size_t ch = 0; ch < 2; ++ch)
+            if (loop[ch].getSize() != frozenWet[ch].getSize() || loop[ch].getFormat() != frozenWet[ch].getFormat())
+                return false;
+
+        publishLoop (false);
+        std::swap (loop, frozenWet);
+        stopGrains();
+        frozenPos = seamLength;
+        freezeState = FreezeState::looping;
+        publishLoop (true);
+        return true;
+    }
+
+    // Audio thread; takes effect for new grains, so grains already playing aren't cut off.
+    void setQuality (const Quality& q) noexcept
+    {
+        quality = q;
+        cloud.setGrainCap (q.maxCloudGrains);
+        cloud.setInterpolation (q.interpolate);
+    }
+
+    // Makes grain scheduling reproducible from the next prepare() on (offline renders, tests).
+    // Only affects process (dry, wet); a shared Scheduler has its own seed.
+    void setRandomSeed (juce::int64 newSeed) { ownScheduler.setRandomSeed (newSeed); }
+
+    // Threads helping the audio thread render the grain cloud, applied on the next prepare().
+    // -1 picks a count from the number of cores; 0 keeps everything on the audio thread.
+    void setCloudWorkers (int numWorkers) { cloudWorkers = numWorkers; }
+
+    // Share of the block's duration the cloud may spend rendering before it starts dropping
+    // grains; 0 waits for every grain (offline rendering).
+    void setCloudBudget (float fractionOfBlock) { cloudBudget = fractionOfBlock; }
+
+    const GrainCloud& getCloud() const noexcept { return cloud; }
+
+   #if STARLIGHT_TRACING
+    void setTraceRecorder (TraceRecorder* r)
+    {
+        trace = r;
+        ownScheduler.setTraceRecorder (r);
+    }
+   #endif
+
     void process (juce::AudioBuffer<float>& dryInOut, juce::AudioBuffer<float>& wetOut)
+    {
+        ownScheduler.schedule (params, quality, dryInOut.getNumSamples());
+        process (dryInOut, wetOut, ownScheduler);
+    }
+
+    // Plays the grains the scheduler picked for this block; it must have been prepared with
+    // the same sample rate and scheduled for dryInOut.getNumSamples() samples. In mono the
+    // wet output is what the stereo one would fold down to: the average of its two channels.
+    //
+    // Freezing stops the writes and snapshots the end of the delay line into a loop, seam
+    // crossfaded, that new grains read instead. The first freezeLoopSeconds of their output
+    // are recorded and from then on simply replayed, seam crossfaded too, so a frozen pad
+    // holds its level indefinitely and costs next to nothing once the loop is complete.
+    void process (juce::AudioBuffer<float>& dryInOut, juce::AudioBuffer<float>& wetOut, const Scheduler& scheduler)
     {
         const int numSamples = dryInOut.getNumSamples();
-        const int maxDelay = delayBuffer[0].getNumSamples();
+        const int maxDelay = delayLine.getSize();
         if (maxDelay <= 1 || sampleRate <= 0.0)
             return;
 
         const float inputGain = params.inputGain;
 
+        jassert (dryInOut.getNumChannels() >= (stereo ? 2 : 1) && wetOut.getNumChannels() >= (stereo ? 2 : 1));
+
         auto* inL = dryInOut.getReadPointer (0);
-        auto* inR = dryInOut.getReadPointer (1);
+        auto* inR = stereo ? dryInOut.getReadPointer (1) : nullptr;
         auto* wetL = wetOut.getWritePointer (0);
-        auto* wetR = wetOut.getWritePointer (1);
+        auto* wetR = stereo ? wetOut.getWritePointer (1) : nullptr;
 
-        const float baseDelaySamples = (params.delayTimeMs / 1000.0f) * (float) sampleRate;
+        // a new file starts from the top
+        const auto* const source = params.source;
+        if (source != currentSource)
+        {
+            currentSource = source;
+            sourcePosition = 0.0;
+        }
 
-        const float basePitch = std::pow (2.0f, params.pitchSemitones / 12.0f);
-        const float density = juce::jmax (0.001f, params.density);
-        const float grainSizeMs = juce::jlimit (10.0f, 250.0f, params.grainSizeMs);
-        const int grainSamples = (int) juce::jmax (8.0, (grainSizeMs / 1000.0f) * sampleRate);
+        const double sourceStep = source != nullptr ? source->getSampleRate() / sampleRate : 0.0;
+        const double sourceLength = source != nullptr ? (double) source->getLength() : 0.0;
 
-        const float drift = params.drift;
-        const float modRate = params.modRateHz;
-        const float modDepth = params.modDepth;
+        const int grainSamples = scheduler.getGrainSamples();
+        const float feedback = params.feedback;
 
-        const float jitterSamplesMax = (params.jitter + 0.2f * drift) * (float) grainSamples;
-        const float spread = juce::jlimit (0.0f, 1.0f, params.spread);
+        const auto& coreGrains = scheduler.getCoreGrains();
+        const auto& cloudGrains = scheduler.getCloudGrains();
+        const auto& memoryDraws = scheduler.getMemoryDraws();
+        size_t nextCore = 0, nextCloud = 0, nextDraw = 0;
 
-        const float feedback = params.freeze ? 0.985f : params.feedback;
+        // the pages a long-memory grain may touch around its drawn position: scattered by up
+        // to the widest jitter and drift offset, then read at up to the highest pitch
+        const int memoryReach = (int) ((maxJitter + 0.2f + 0.15f) * (float) grainSamples) + 2;
+        const int memorySpan = 2 * memoryReach + (int) (maxReadIncrement * (float) grainSamples) + 2;
 
-        const float driftStep = (0.00002f + 0.0002f * modRate) * drift;
-        const float detuneStep = (0.000001f + 0.00002f * modRate) * drift;
+        if (! params.freeze)
+        {
+            freezeState = FreezeState::live;
+            publishLoop (false);
+        }
+        else if (freezeState == FreezeState::live)
+            startFreeze();
 
-        for (int i = 0; i < numSamples; ++i)
+        const bool frozen = params.freeze;
+
+        if (freezeState == FreezeState::looping)
         {
-            // non-LFO "drift": random walk, very slow
-            driftReadOffset = juce::jlimit (-1.0f, 1.0f, driftReadOffset + driftStep * (rng.nextFloat() * 2.0f - 1.0f));
-            driftDetune = juce::jlimit (-1.0f, 1.0f, driftDetune + detuneStep * (rng.nextFloat() * 2.0f - 1.0f));
+            skipGrains (coreGrains, memoryDraws, memoryReach, memorySpan);
+            playFrozen (wetL, wetR, numSamples);
+            return;
+        }
 
+        if (grainSamples != windowLength && grainSamples < (int) window.size())
+        {
+            for (int k = 0; k < grainSamples; ++k)
+                window[(size_t) k] = hann (k, grainSamples);
+
+            windowLength = grainSamples;
+        }
+
+        for (int i = 0; i < numSamples; ++i)
+        {
             const float inSampleL = inL[i] * inputGain;
-            const float inSampleR = inR[i] * inputGain;
-            const float inMono = 0.5f * (inSampleL + inSampleR);
+            const float inMono = source != nullptr ? source->read (sourcePosition) * inputGain
+                                 : stereo ? 0.5f * (inSampleL + inR[i] * inputGain) : inSampleL;
 
             // write (unless frozen)
-            if (! params.freeze)
+            if (! frozen)
             {
                 const float fb = feedbackSample;
-                delayBuffer[0].setSample (0, writePos, inMono + fb * feedback);
+                const float x = inMono + fb * feedback;
+                delayLine.write (writePos, x);
+
+                if (history.isActive())
+                    history.write (x);
+
+                if (source != nullptr)
+                {
+                    sourcePosition += sourceStep;
+                    while (sourcePosition >= sourceLength)
+                        sourcePosition -= sourceLength;
+                }
+            }
+
+            for (; nextDraw < memoryDraws.size() && memoryDraws[nextDraw].offset == i; ++nextDraw)
+            {
+                const auto start = history.getWritePosition() - memoryDraws[nextDraw].age - memoryReach;
+                pushMemoryPosition (history.prefetch (start, memorySpan) ? start : -1);
             }
 
             // spawn grains
-            spawnAccumulator += density / sampleRate;
-            while (spawnAccumulator >= 1.0)
+            for (; nextCore < coreGrains.size() && coreGrains[nextCore].offset == i; ++nextCore)
             {
-                spawnAccumulator -= 1.0;
+                const auto& s = coreGrains[nextCore];
+                const auto memoryStart = s.fromMemory ? popMemoryPosition() : juce::int64 (-1);
+
+                if (activeGrains.size() >= activeGrains.capacity())
+                    continue;
 
                 Grain g;
                 g.length = grainSamples;
                 g.age = 0;
 
-                const float jitter = (rng.nextFloat() * 2.0f - 1.0f) * jitterSamplesMax;
-                const float driftOffset = driftReadOffset * (modDepth * 0.15f) * (float) grainSamples;
-                const float readPos = (float) writePos - baseDelaySamples + jitter + driftOffset;
-                g.readPos = wrapRead (readPos, (float) maxDelay);
-
-                const float detune = (rng.nextFloat() * 2.0f - 1.0f) * (0.02f * drift * modDepth) + driftDetune * (0.04f * drift * modDepth);
-                g.readInc = basePitch * std::pow (2.0f, detune);
-
-                const float pan = (rng.nextFloat() * 2.0f - 1.0f) * spread;
-                g.panL = juce::jlimit (0.0f, 1.0f, 0.5f - 0.5f * pan);
-                g.panR = juce::jlimit (0.0f, 1.0f, 0.5f + 0.5f * pan);
+                // a long-memory grain whose pages didn't arrive in time plays from the delay line instead
+                if (frozen)
+                {
+                    g.fromLoop = true;
+                    g.readPos = wrapRead ((float) loopPhase - s.delay + s.jitter + s.driftOffset, (float) loopLength);
+                }
+                else if (memoryStart >= 0 && history.isResident (memoryStart, memorySpan))
+                {
+                    history.pin (memoryStart, memorySpan);
+                    g.memoryStart = memoryStart;
+                    g.memorySpan = memorySpan;
+                    g.readPos = (float) memoryReach + s.jitter + s.driftOffset;
+                }
+                else
+                {
+                    g.readPos = wrapRead ((float) writePos - s.delay + s.jitter + s.driftOffset, (float) maxDelay);
+                }
 
+                g.readInc = s.readInc;
+                g.panL = s.panL;
+                g.panR = s.panR;
+                g.gain = s.gain;
                 activeGrains.push_back (g);
             }
 
+            for (; nextCloud < cloudGrains.size() && cloudGrains[nextCloud].offset == i; ++nextCloud)
+            {
+                const auto& s = cloudGrains[nextCloud];
+                cloud.spawn (i, wrapRead ((float) writePos - s.lag, (float) maxDelay), s.readInc, grainSamples, s.panL, s.panR);
+            }
+
             float outL = 0.0f, outR = 0.0f;
             feedbackSample = 0.0f;
 
@@ -127,27 +753,60 @@ public:
                 auto& g = activeGrains[(size_t) gi];
                 if (g.age >= g.length)
                 {
+                    if (g.memoryStart >= 0)
+                        history.unpin (g.memoryStart, g.memorySpan);
+
                     activeGrains.erase (activeGrains.begin() + gi);
                     continue;
                 }
 
-                const float s = readDelay (g.readPos, maxDelay);
-                const float w = hann (g.age, g.length);
-                const float v = s * w;
+                const bool fromMemory = g.memoryStart >= 0;
+                const auto& line = g.fromLoop ? freezeSource : delayLine;
+                const int lineSize = g.fromLoop ? loopLength : maxDelay;
+                const float s = fromMemory ? readHistory (g.memoryStart, g.readPos) : readRing (line, g.readPos, lineSize);
+                const float w = g.length == windowLength ? window[(size_t) g.age] : hann (g.age, g.length);
+                const float v = s * w * g.gain;
 
                 outL += v * g.panL;
                 outR += v * g.panR;
                 feedbackSample += v * 0.5f;
 
-                g.readPos = wrapRead (g.readPos + g.readInc, (float) maxDelay);
+                g.readPos = fromMemory ? g.readPos + g.readInc : wrapRead (g.readPos + g.readInc, (float) lineSize);
                 ++g.age;
             }
 
-            wetL[i] = outL;
-            wetR[i] = outR;
+            if (stereo)
+            {
+                wetL[i] = outL;
+                wetR[i] = outR;
+            }
+            else
+            {
+                wetL[i] = 0.5f * (outL + outR);
+            }
 
-            writePos = (writePos + 1) % maxDelay;
+            if (frozen)
+                loopPhase = (loopPhase + 1) % loopLength;
+            else
+                writePos = (writePos + 1) % maxDelay;
         }
+
+        if (cloud.getNumActiveGrains() > 0)
+        {
+            STARLIGHT_TRACE_SCOPE (trace, "grainCloud");
+
+            // overlapping grains add up roughly like noise, so normalise by the expected overlap
+            const float cloudDensity = juce::jmax (0.0f, params.cloudDensity);
+            const float overlap = cloudDensity * (float) grainSamples / (float) sampleRate;
+            const float gain = 1.0f / std::sqrt (juce::jmax (1.0f, overlap));
+
+            float* const out[] = { wetL, wetR };
+            cloud.render (delayLine, out, numSamples, gain,
+                          cloudBudget * numSamples / sampleRate);
+        }
+
+        if (freezeState == FreezeState::capturing)
+            playFrozen (wetL, wetR, numSamples);
     }
 
 private:
@@ -159,6 +818,17 @@ private:
         float readInc = 1.0f;
         float panL = 0.5f;
         float panR = 0.5f;
+        float gain = 1.0f;
+        juce::int64 memoryStart = -1; // long-memory grains: readPos counts from here, in the history
+        int memorySpan = 0;
+        bool fromLoop = false;        // spawned while frozen: reads freezeSource
+    };
+
+    enum class FreezeState
+    {
+        live,
+        capturing, // grains play from freezeSource while their output is recorded
+        looping    // the recording plays on its own
     };
 
     static float hann (int pos, int len)
@@ -175,28 +845,212 @@ private:
         return p;
     }
 
-    float readDelay (float pos, int size) const
+    float readRing (const DelayBuffer& line, float pos, int size) const
     {
+        if (! quality.interpolate)
+        {
+            const int i = (int) (pos + 0.5f);
+            return line.read (i < size ? i : 0);
+        }
+
         const int i0 = (int) pos;
         const int i1 = (i0 + 1) % size;
         const float frac = pos - (float) i0;
-        const float a = delayBuffer[0].getSample (0, i0);
-        const float b = delayBuffer[0].getSample (0, i1);
+        const float a = line.read (i0);
+        const float b = line.read (i1);
         return a + frac * (b - a);
     }
 
+    // Copies the loopLength samples before the write head into freezeSource, fading the
+    // samples that led up to them in over its end, so reading round the loop doesn't click.
+    void startFreeze() noexcept
+    {
+        const int size = delayLine.getSize();
+        const int start = (writePos - loopLength + size) % size;
+
+        for (int k = 0; k < loopLength; ++k)
+            freezeSource.write (k, delayLine.read ((start + k) % size));
+
+        for (int k = 0; k < seamLength; ++k)
+        {
+            const int i = loopLength - seamLength + k;
+            const float before = delayLine.read ((start - seamLength + k + size) % size);
+            freezeSource.write (i, freezeSource.read (i) * seamFade[(size_t) (seamLength - 1 - k)] + before * seamFade[(size_t) k]);
+        }
+
+        loopPhase = 0;
+        frozenPos = 0;
+        freezeState = FreezeState::capturing;
+        publishLoop (false);
+    }
+
+    // While capturing, records the block's output into frozenWet; either way replaces it with
+    // the recording. The recording's first seamLength samples lead into the loop proper, which
+    // runs from there to the end and fades those lead-in samples in over its last seamLength,
+    // so it can jump back to seamLength without a click.
+    void playFrozen (float* wetL, float* wetR, int numSamples) noexcept
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            if (freezeState == FreezeState::capturing)
+            {
+                frozenWet[0].write (frozenPos, wetL[i]);
+                if (stereo)
+                    frozenWet[1].write (frozenPos, wetR[i]);
+            }
+
+            wetL[i] = frozenSample (frozenWet[0]);
+            if (stereo)
+                wetR[i] = frozenSample (frozenWet[1]);
+
+            if (++frozenPos == loopLength + seamLength)
+            {
+                frozenPos = seamLength;
+
+                if (freezeState == FreezeState::capturing)
+                {
+                    freezeState = FreezeState::looping;
+                    stopGrains();
+                    publishLoop (true);
+                }
+            }
+        }
+    }
+
+    float frozenSample (const DelayBuffer& recording) const noexcept
+    {
+        if (frozenPos < loopLength)
+            return recording.read (frozenPos);
+
+        const int k = frozenPos - loopLength;
+        return recording.read (frozenPos) * seamFade[(size_t) (seamLength - 1 - k)]
+               + recording.read (k) * seamFade[(size_t) k];
+    }
+
+    // loopVersion is even while frozenWet holds a complete recording nothing writes to, and
+    // changes whenever that starts or stops being true, so copyFrozenLoop() can tell whether
+    // what it read was consistent.
+    void publishLoop (bool complete) noexcept
+    {
+        const auto version = loopVersion.load (std::memory_order_relaxed);
+
+        if (((version & 1) == 0) != complete)
+        {
+            loopVersion.store (version + 1, std::memory_order_release);
+            std::atomic_thread_fence (std::memory_order_release);
+        }
+    }
+
+    void stopGrains() noexcept
+    {
+        for (const auto& g : activeGrains)
+            if (g.memoryStart >= 0)
+                history.unpin (g.memoryStart, g.memorySpan);
+
+        activeGrains.clear();
+        cloud.clear();
+        feedbackSample = 0.0f;
+    }
+
+    // Keeps the long-memory queue in step with the scheduler while no grains are played.
+    void skipGrains (const std::vector<Scheduler::CoreGrain>& coreGrains, const std::vector<Scheduler::MemoryDraw>& memoryDraws,
+                     int memoryReach, int memorySpan) noexcept
+    {
+        size_t nextDraw = 0;
+
+        auto drawUpTo = [&] (int offset)
+        {
+            for (; nextDraw < memoryDraws.size() && memoryDraws[nextDraw].offset <= offset; ++nextDraw)
+            {
+                const auto start = history.getWritePosition() - memoryDraws[nextDraw].age - memoryReach;
+                pushMemoryPosition (history.prefetch (start, memorySpan) ? start : -1);
+            }
+        };
+
+        for (const auto& s : coreGrains)
+        {
+            drawUpTo (s.offset);
+
+            if (s.fromMemory)
+                popMemoryPosition();
+        }
+
+        drawUpTo (std::numeric_limits<int>::max());
+    }
+
+    float readHistory (juce::int64 start, float pos) const noexcept
+    {
+        if (! quality.interpolate)
+            return history.read (start + (int) (pos + 0.5f));
+
+        const int i0 = (int) pos;
+        const float frac = pos - (float) i0;
+        const float a = history.read (start + i0);
+        const float b = history.read (start + i0 + 1);
+        return a + frac * (b - a);
+    }
+
+    // The history start positions drawn for upcoming long-memory grains, oldest first; -1
+    // for a position whose pages couldn't be requested.
+    void pushMemoryPosition (juce::int64 start) noexcept
+    {
+        if (memoryQueueSize == (int) memoryQueue.size())
+            popMemoryPosition();
+
+        memoryQueue[(size_t) ((memoryQueueStart + memoryQueueSize++) % (int) memoryQueue.size())] = start;
+    }
+
+    juce::int64 popMemoryPosition() noexcept
+    {
+        if (memoryQueueSize == 0)
+            return -1;
+
+        const auto start = memoryQueue[(size_t) memoryQueueStart];
+        memoryQueueStart = (memoryQueueStart + 1) % (int) memoryQueue.size();
+        --memoryQueueSize;
+        return start;
+    }
+
     double sampleRate = 48000.0;
+    bool stereo = true;
     Params params;
+    Quality quality;
 
-    juce::AudioBuffer<float> delayBuffer[1];
+    DelayBuffer delayLine;
+    DelayBuffer::Format storageFormat = DelayBuffer::Format::float32;
     int writePos = 0;
 
-    double spawnAccumulator = 0.0;
     float feedbackSample = 0.0f;
 
-    float driftReadOffset = 0.0f;
-    float driftDetune = 0.0f;
+    std::vector<float> window;
+    int windowLength = 0;
+
+    FreezeState freezeState = FreezeState::live;
+    DelayBuffer freezeSource;  // what grains read while frozen
+    std::array<DelayBuffer, 2> frozenWet; // their recorded output
+    std::vector<float> seamFade;
+    int loopLength = 1, seamLength = 1;
+    int loopPhase = 0;         // stands in for the write head in freezeSource
+    int frozenPos = 0;         // in frozenWet
+    std::atomic<juce::uint32> loopVersion { 1 };
+
+    const SampleSource* currentSource = nullptr;
+    double sourcePosition = 0.0; // in the source's samples
 
-    juce::Random rng;
     std::vector<Grain> activeGrains;
+    Scheduler ownScheduler;
+
+    LongMemory history;
+    double historySeconds = 0.0;
+    bool historyWaitsForPages = false;
+    std::array<juce::int64, Scheduler::memoryLookahead + 1> memoryQueue {};
+    int memoryQueueStart = 0, memoryQueueSize = 0;
+
+    GrainCloud cloud;
+    int cloudWorkers = -1;
+    float cloudBudget = 0.5f;
+
+   #if STARLIGHT_TRACING
+    TraceRecorder* trace = nullptr;
+   #endif
 };
@@ -0,0 +1,335 @@
+#include "LongMemory.h"
+
+#include <cstring>
+#include <filesystem>
+
+// Serves the audio thread's page requests. Polls rather than waits on an event, so posting
+// a request never has to signal anything from the audio thread; a few milliseconds of
+// latency is far less than the lead time pages are requested with.
+class LongMemory::Pager final : public juce::Thread
+{
+public:
+    explicit Pager (LongMemory& m) : juce::Thread ("Starlight memory pager"), memory (m) {}
+
+    ~Pager() override { stopThread (2000); }
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            memory.serviceRequests();
+            wait (2);
+        }
+    }
+
+private:
+    LongMemory& memory;
+
+    JUCE_DECLARE_NON_COPYABLE (Pager)
+};
+
+LongMemory::LongMemory() = default;
+
+LongMemory::~LongMemory()
+{
+    release();
+}
+
+bool LongMemory::prepare (double sampleRate, double seconds, bool waitForPages)
+{
+    release();
+
+    if (seconds <= 0.0 || sampleRate <= 0.0)
+        return true;
+
+    numPages = (int) std::ceil (seconds * sampleRate / pageSize) + guardPages + 1;
+    const auto bytes = (juce::int64) numPages * pageSize * (juce::int64) sizeof (float);
+
+    // a sparse file on most systems: pages nobody has written yet read back as silence
+    file = juce::File::getSpecialLocation (juce::File::tempDirectory).getNonexistentChildFile ("StarlightDriftMemory", ".tmp", false);
+
+    std::error_code error;
+    if (file.create().wasOk())
+        std::filesystem::resize_file (std::filesystem::u8path (file.getFullPathName().toRawUTF8()), (std::uintmax_t) bytes, error);
+
+    if (! error && file.getSize() == bytes)
+    {
+        map = std::make_unique<juce::MemoryMappedFile> (file, juce::MemoryMappedFile::readWrite, false);
+
+        if (map->getData() == nullptr || (juce::int64) map->getSize() < bytes)
+            map.reset();
+    }
+
+    if (map == nullptr)
+    {
+        file.deleteFile();
+        numPages = 1;
+        return false;
+    }
+
+    for (auto& slot : slots)
+    {
+        slot.data.assign ((size_t) pageSize, 0.0f);
+        slot.page = -1;
+        slot.state.store (empty);
+        slot.users = 0;
+        slot.lastUse = 0;
+    }
+
+    slotOfPage.assign ((size_t) numPages, 0);
+    useCounter = 0;
+    written = 0;
+    fifo.reset();
+    startWritePage();
+
+    synchronous = waitForPages;
+
+    if (! synchronous)
+    {
+        pager = std::make_unique<Pager> (*this);
+        pager->startThread();
+    }
+
+    return true;
+}
+
+void LongMemory::release()
+{
+    pager.reset();
+
+    if (map != nullptr)
+    {
+        map.reset();
+        file.deleteFile();
+    }
+
+    for (auto& slot : slots)
+    {
+        slot.data.clear();
+        slot.data.shrink_to_fit();
+        slot.page = -1;
+        slot.state.store (empty);
+        slot.users = 0;
+    }
+
+    slotOfPage.clear();
+    slotOfPage.shrink_to_fit();
+    numPages = 1;
+    writeSlot = -1;
+    written = 0;
+}
+
+size_t LongMemory::getMemoryBytes() const noexcept
+{
+    size_t bytes = slotOfPage.capacity() * sizeof (int);
+
+    for (const auto& slot : slots)
+        bytes += slot.data.capacity() * sizeof (float);
+
+    return bytes;
+}
+
+void LongMemory::write (float x) noexcept
+{
+    if (writeSlot >= 0)
+        slots[(size_t) writeSlot].data[(size_t) (written & (pageSize - 1))] = x;
+
+    if ((++written & (pageSize - 1)) != 0)
+        return;
+
+    if (writeSlot >= 0)
+    {
+        auto& slot = slots[(size_t) writeSlot];
+        slot.state.store (spilling, std::memory_order_relaxed);
+        post ({ writeSlot, slot.page, false });
+    }
+
+    startWritePage();
+}
+
+bool LongMemory::prefetch (juce::int64 start, int numSamples) noexcept
+{
+    if (! isActive())
+        return false;
+
+    const auto last = (start + juce::jmax (1, numSamples) - 1) >> pageBits;
+
+    for (auto page = start >> pageBits; page <= last; ++page)
+    {
+        if (! isValidPage (page))
+            return false;
+
+        // nothing to load: it reads as silence
+        if (! isRecorded (page))
+            continue;
+
+        auto& known = slots[(size_t) slotOfPage[(size_t) (page % numPages)]];
+        if (known.page == page && known.state.load (std::memory_order_acquire) != empty)
+        {
+            known.lastUse = ++useCounter;
+            continue;
+        }
+
+        // leave a couple of slots for the write head
+        const int s = findFreeSlot (2);
+        if (s < 0)
+            return false;
+
+        auto& slot = slots[(size_t) s];
+        slot.page = page;
+        slot.lastUse = ++useCounter;
+        slot.state.store (loading, std::memory_order_relaxed);
+        slotOfPage[(size_t) (page % numPages)] = s;
+
+        if (! post ({ s, page, true }))
+        {
+            slot.page = -1;
+            slot.state.store (empty, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool LongMemory::isResident (juce::int64 start, int numSamples) const noexcept
+{
+    if (! isActive())
+        return false;
+
+    const auto last = (start + juce::jmax (1, numSamples) - 1) >> pageBits;
+
+    for (auto page = start >> pageBits; page <= last; ++page)
+        if (! isValidPage (page) || (isRecorded (page) && ! isReadable (page)))
+            return false;
+
+    return true;
+}
+
+void LongMemory::pin (juce::int64 start, int numSamples) noexcept
+{
+    const auto last = (start + juce::jmax (1, numSamples) - 1) >> pageBits;
+
+    for (auto page = start >> pageBits; page <= last; ++page)
+    {
+        if (! isRecorded (page))
+            continue;
+
+        auto& slot = slots[(size_t) slotOfPage[(size_t) (page % numPages)]];
+        jassert (slot.page == page);
+        ++slot.users;
+        slot.lastUse = ++useCounter;
+    }
+}
+
+void LongMemory::unpin (juce::int64 start, int numSamples) noexcept
+{
+    const auto last = (start + juce::jmax (1, numSamples) - 1) >> pageBits;
+
+    for (auto page = start >> pageBits; page <= last; ++page)
+    {
+        if (! isRecorded (page))
+            continue;
+
+        auto& slot = slots[(size_t) slotOfPage[(size_t) (page % numPages)]];
+        jassert (slot.page == page && slot.users > 0);
+        --slot.users;
+    }
+}
+
+// Pages a grain may be asked to start on: written in full, and not about to be overwritten
+// in the file by the write head coming round again. Those that weren't recorded read as silence.
+bool LongMemory::isValidPage (juce::int64 page) const noexcept
+{
+    const auto current = written >> pageBits;
+    return page >= 0 && page < current && page > current - numPages + guardPages;
+}
+
+bool LongMemory::isReadable (juce::int64 page) const noexcept
+{
+    const auto& slot = slots[(size_t) slotOfPage[(size_t) (page % numPages)]];
+    if (slot.page != page)
+        return false;
+
+    const auto state = slot.state.load (std::memory_order_acquire);
+    return state == ready || state == spilling || state == writing;
+}
+
+// An empty slot, or else the least recently used one no grain is reading and the pager
+// isn't busy with, as long as at least keepSpare others would be left.
+int LongMemory::findFreeSlot (int keepSpare) noexcept
+{
+    int best = -1, available = 0;
+
+    for (int s = 0; s < numSlots; ++s)
+    {
+        auto& slot = slots[(size_t) s];
+        const auto state = slot.state.load (std::memory_order_acquire);
+
+        if (s == writeSlot || slot.users > 0 || (state != empty && state != ready))
+            continue;
+
+        ++available;
+
+        if (best < 0 || state == empty
+            || (slots[(size_t) best].state.load (std::memory_order_relaxed) != empty && slot.lastUse < slots[(size_t) best].lastUse))
+            best = s;
+    }
+
+    return available > keepSpare ? best : -1;
+}
+
+bool LongMemory::post (const Request& r) noexcept
+{
+    {
+        const auto scope = fifo.write (1);
+        if (scope.blockSize1 + scope.blockSize2 == 0)
+            return false;
+
+        requests[(size_t) (scope.blockSize1 > 0 ? scope.startIndex1 : scope.startIndex2)] = r;
+    }
+
+    if (synchronous)
+        serviceRequests();
+
+    return true;
+}
+
+void LongMemory::startWritePage() noexcept
+{
+    writeSlot = -1;
+
+    // the file still holds this position's previous lap, so the page mustn't be read from it
+    const auto page = written >> pageBits;
+    slotOfPage[(size_t) (page % numPages)] = silentSlot;
+
+    const int s = findFreeSlot (0);
+    if (s < 0)
+        return;
+
+    auto& slot = slots[(size_t) s];
+    slot.page = page;
+    slot.lastUse = ++useCounter;
+    slot.state.store (writing, std::memory_order_relaxed);
+    slotOfPage[(size_t) (page % numPages)] = s;
+    writeSlot = s;
+}
+
+void LongMemory::serviceRequests() noexcept
+{
+    const auto scope = fifo.read (fifo.getNumReady());
+
+    scope.forEach ([this] (int index)
+    {
+        const auto& r = requests[(size_t) index];
+        auto& slot = slots[(size_t) r.slot];
+        auto* stored = static_cast<float*> (map->getData()) + (size_t) (r.page % numPages) * pageSize;
+
+        if (r.load)
+            std::memcpy (slot.data.data(), stored, (size_t) pageSize * sizeof (float));
+        else
+            std::memcpy (stored, slot.data.data(), (size_t) pageSize * sizeof (float));
+
+        slot.state.store (ready, std::memory_order_release);
+    });
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Minutes of input history for GranularDelay's long-memory mode, in bounded RAM.
+//
+// The history is a ring of fixed-size pages in a memory-mapped temp file. Only numSlots
+// pages at a time sit in RAM, in slots the audio thread reads from: the page being
+// written, and the pages grains are playing or about to play. A background pager copies
+// full pages out to the file and requested pages back into slots; the audio thread never
+// touches the file itself, it asks for pages ahead of time through a lock-free queue and
+// only reads pages that have arrived. A page written while every slot was busy isn't
+// recorded; it reads back as silence rather than as whatever the file held from the
+// previous lap.
+//
+// Everything but the pager runs on the thread that owns the delay.
+class LongMemory final
+{
+public:
+    static constexpr int pageBits = 14;
+    static constexpr int pageSize = 1 << pageBits; // samples
+    static constexpr int numSlots = 48;            // pages in RAM: 3 MB
+
+    // Pages kept in the file beyond the requested length, so a page a grain starts on stays
+    // in the history for the grain's whole life.
+    static constexpr int guardPages = 8;
+
+    LongMemory();
+    ~LongMemory();
+
+    // Message thread. Creates and maps a temp file for `seconds` of history, allocates the
+    // slots and starts the pager. seconds <= 0 turns long memory off; so does a file that
+    // can't be created or mapped, in which case this returns false.
+    //
+    // With waitForPages the caller's thread copies pages itself as soon as it asks for them,
+    // so every page arrives in time and the result doesn't depend on disk speed (offline
+    // rendering).
+    bool prepare (double sampleRate, double seconds, bool waitForPages = false);
+    void release();
+
+    bool isActive() const noexcept { return map != nullptr; }
+
+    // Samples of history grains may start in, at least the length asked for.
+    juce::int64 getLength() const noexcept { return isActive() ? (juce::int64) (numPages - guardPages - 1) * pageSize : 0; }
+
+    // Samples written since prepare(); sample n is at position n.
+    juce::int64 getWritePosition() const noexcept { return written; }
+
+    // RAM held by the slots; the file only takes up disk and page cache.
+    size_t getMemoryBytes() const noexcept;
+    juce::int64 getFileBytes() const noexcept { return isActive() ? (juce::int64) numPages * pageSize * (juce::int64) sizeof (float) : 0; }
+
+    // Audio thread.
+    void write (float x) noexcept;
+
+    // Asks for the pages covering positions [start, start + numSamples) to be brought into
+    // RAM. Returns false if they're too old or there are no slots to spare.
+    bool prefetch (juce::int64 start, int numSamples) noexcept;
+
+    // Whether [start, start + numSamples) can be read right now.
+    bool isResident (juce::int64 start, int numSamples) const noexcept;
+
+    // Keeps the pages of a resident range in RAM while a grain reads from it.
+    void pin (juce::int64 start, int numSamples) noexcept;
+    void unpin (juce::int64 start, int numSamples) noexcept;
+
+    // A position in a pinned range; silence in a page that wasn't recorded.
+    float read (juce::int64 position) const noexcept
+    {
+        const auto& slot = slots[(size_t) slotOfPage[(size_t) ((position >> pageBits) % numPages)]];
+        return slot.data[(size_t) (position & (pageSize - 1))];
+    }
+
+private:
+    class Pager;
+
+    enum State : int
+    {
+        empty,    // holds nothing
+        loading,  // the pager is copying a page in from the file
+        spilling, // full page being copied out to the file; readable
+        ready,    // readable
+        writing   // the page being written; readable up to the write position
+    };
+
+    struct Slot
+    {
+        std::vector<float> data;
+        juce::int64 page = -1;
+        std::atomic<int> state { empty };
+        int users = 0;
+        juce::uint32 lastUse = 0;
+    };
+
+    struct Request
+    {
+        int slot;
+        juce::int64 page;
+        bool load; // false: spill
+    };
+
+    // Stands in for a page that wasn't recorded: all zeros, never loaded, written or freed.
+    static constexpr int silentSlot = numSlots;
+
+    bool isValidPage (juce::int64 page) const noexcept;
+    bool isRecorded (juce::int64 page) const noexcept { return slotOfPage[(size_t) (page % numPages)] != silentSlot; }
+    bool isReadable (juce::int64 page) const noexcept;
+    int findFreeSlot (int keepSpare) noexcept;
+    bool post (const Request&) noexcept;
+    void startWritePage() noexcept;
+
+    // pager side
+    void serviceRequests() noexcept;
+
+    juce::File file;
+    std::unique_ptr<juce::MemoryMappedFile> map;
+    int numPages = 1;
+
+    std::array<Slot, numSlots + 1> slots; // and silentSlot
+    std::vector<int> slotOfPage; // by page % numPages; only meaningful if the slot agrees, or it's silentSlot
+    juce::uint32 useCounter = 0;
+
+    juce::int64 written = 0;
+    int writeSlot = -1; // -1 while every slot is busy: the page then isn't recorded, and maps to silentSlot
+
+    // every request puts a slot in loading or spilling until it's served, so numSlots is enough
+    juce::AbstractFifo fifo { numSlots + 1 };
+    std::array<Request, numSlots + 1> requests {};
+
+    std::unique_ptr<Pager> pager;
+    bool synchronous = false;
+
+    JUCE_DECLARE_NON_COPYABLE (LongMemory)
+};
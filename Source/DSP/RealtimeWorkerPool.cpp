@@ -0,0 +1,145 @@
+#include "RealtimeWorkerPool.h"
+
+#include "../Diagnostics/RealtimeSafety.h"
+
+#include <thread>
+
+#if JUCE_WINDOWS
+ #ifndef NOMINMAX
+  #define NOMINMAX
+ #endif
+ #ifndef WIN32_LEAN_AND_MEAN
+  #define WIN32_LEAN_AND_MEAN
+ #endif
+ #include <windows.h>
+#elif JUCE_MAC || JUCE_IOS
+ #include <dispatch/dispatch.h>
+#else
+ #include <semaphore.h>
+ #include <cerrno>
+#endif
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+#endif
+
+// Plain OS counting semaphore. Posting never takes a lock, so the audio thread can
+// wake workers without risking priority inversion.
+class RealtimeWorkerPool::Semaphore
+{
+public:
+   #if JUCE_WINDOWS
+    Semaphore()  { handle = CreateSemaphoreW (nullptr, 0, 0x7fffffff, nullptr); }
+    ~Semaphore() { CloseHandle (handle); }
+    void post (int count) noexcept { ReleaseSemaphore (handle, count, nullptr); }
+    void wait() noexcept           { WaitForSingleObject (handle, INFINITE); }
+
+   private:
+    HANDLE handle;
+   #elif JUCE_MAC || JUCE_IOS
+    Semaphore()  { handle = dispatch_semaphore_create (0); }
+    ~Semaphore() { dispatch_release (handle); }
+    void post (int count) noexcept { while (--count >= 0) dispatch_semaphore_signal (handle); }
+    void wait() noexcept           { dispatch_semaphore_wait (handle, DISPATCH_TIME_FOREVER); }
+
+   private:
+    dispatch_semaphore_t handle;
+   #else
+    Semaphore()  { sem_init (&handle, 0, 0); }
+    ~Semaphore() { sem_destroy (&handle); }
+    void post (int count) noexcept { while (--count >= 0) sem_post (&handle); }
+    void wait() noexcept           { while (sem_wait (&handle) != 0 && errno == EINTR) {} }
+
+   private:
+    sem_t handle;
+   #endif
+
+    JUCE_DECLARE_NON_COPYABLE (Semaphore)
+};
+
+class RealtimeWorkerPool::Worker final : public juce::Thread
+{
+public:
+    Worker (RealtimeWorkerPool& p, int i)
+        : juce::Thread ("Starlight DSP worker " + juce::String (i)), pool (p), index (i) {}
+
+    void run() override
+    {
+        for (;;)
+        {
+            pool.wakeUp->wait();
+
+            if (threadShouldExit())
+                return;
+
+            // the task is the audio thread's work, so the audit holds it to the same rules
+            if (auto* task = pool.currentTask.load (std::memory_order_acquire))
+            {
+                STARLIGHT_RT_AUDIO_THREAD_SCOPE;
+                task->run (index);
+            }
+        }
+    }
+
+private:
+    RealtimeWorkerPool& pool;
+    const int index;
+};
+
+RealtimeWorkerPool::RealtimeWorkerPool() : wakeUp (std::make_unique<Semaphore>()) {}
+
+RealtimeWorkerPool::~RealtimeWorkerPool()
+{
+    stop();
+}
+
+void RealtimeWorkerPool::start (int numWorkers)
+{
+    if (numWorkers < 0)
+        numWorkers = juce::jlimit (0, 3, juce::SystemStats::getNumCpus() - 1);
+
+    if (numWorkers == getNumWorkers())
+        return;
+
+    stop();
+
+    for (int i = 1; i <= numWorkers; ++i)
+    {
+        auto w = std::make_unique<Worker> (*this, i);
+
+        // real-time scheduling needs privileges we may not have; fall back to a normal high priority
+        if (! w->startRealtimeThread (juce::Thread::RealtimeOptions().withPriority (8)))
+            w->startThread (juce::Thread::Priority::highest);
+
+        workers.push_back (std::move (w));
+    }
+}
+
+void RealtimeWorkerPool::stop()
+{
+    for (auto& w : workers)
+        w->signalThreadShouldExit();
+
+    wakeUp->post (getNumWorkers());
+
+    for (auto& w : workers)
+        w->stopThread (2000);
+
+    workers.clear();
+    currentTask.store (nullptr);
+}
+
+void RealtimeWorkerPool::dispatch (Task& task) noexcept
+{
+    currentTask.store (&task, std::memory_order_release);
+    wakeUp->post (getNumWorkers());
+}
+
+void RealtimeWorkerPool::pause() noexcept
+{
+   #if JUCE_INTEL
+    _mm_pause();
+   #else
+    std::this_thread::yield();
+   #endif
+}
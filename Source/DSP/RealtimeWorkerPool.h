@@ -0,0 +1,49 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// A few helper threads the audio thread can hand work to within a block.
+// Nothing on the audio thread's side blocks: dispatch() posts a counting
+// semaphore per worker (lock-free on every platform we build for) and the
+// caller then spins on the task's own completion state until its deadline.
+//
+// Workers are numbered 1..getNumWorkers(); index 0 is left for the calling
+// thread, which is expected to take a share of the work itself.
+class RealtimeWorkerPool final
+{
+public:
+    struct Task
+    {
+        virtual ~Task() = default;
+        virtual void run (int workerIndex) noexcept = 0;
+    };
+
+    RealtimeWorkerPool();
+    ~RealtimeWorkerPool();
+
+    // Message thread only. numWorkers < 0 picks one less than the number of cores (at most 3).
+    void start (int numWorkers);
+    void stop();
+
+    int getNumWorkers() const noexcept { return (int) workers.size(); }
+
+    // Audio thread: wakes every worker to call task.run (workerIndex). The task must stay
+    // alive, and must make late wake-ups harmless, until the next dispatch().
+    void dispatch (Task& task) noexcept;
+
+    static void pause() noexcept;
+
+private:
+    class Semaphore;
+    class Worker;
+
+    std::unique_ptr<Semaphore> wakeUp;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<Task*> currentTask { nullptr };
+
+    JUCE_DECLARE_NON_COPYABLE (RealtimeWorkerPool)
+};
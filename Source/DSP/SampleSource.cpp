@@ -0,0 +1,75 @@
+#include "SampleSource.h"
+
+#include <map>
+
+// Reads through the mapped file once, a page at a time, to pull it into the page cache.
+class SampleSource::Toucher final : public juce::Thread
+{
+public:
+    explicit Toucher (const SampleSource& s) : juce::Thread ("Starlight sample read-ahead"), source (s) {}
+
+    ~Toucher() override { stopThread (2000); }
+
+    void run() override
+    {
+        const auto& reader = *source.reader;
+        const auto bytesPerFrame = juce::jmax (1, (int) reader.numChannels * reader.bitsPerSample / 8);
+        const auto step = juce::jmax ((juce::int64) 1, (juce::int64) (4096 / bytesPerFrame));
+
+        for (juce::int64 i = 0; i < source.length && ! threadShouldExit(); i += step)
+            reader.touchSample (i);
+    }
+
+private:
+    const SampleSource& source;
+
+    JUCE_DECLARE_NON_COPYABLE (Toucher)
+};
+
+SampleSource::~SampleSource()
+{
+    toucher.reset();
+}
+
+std::shared_ptr<const SampleSource> SampleSource::open (const juce::File& fileToOpen)
+{
+    // files already open in this process, so instances on the same file share its mapping
+    static juce::CriticalSection lock;
+    static std::map<juce::String, std::weak_ptr<const SampleSource>> openFiles;
+
+    const juce::ScopedLock sl (lock);
+
+    for (auto it = openFiles.begin(); it != openFiles.end();)
+        it = it->second.expired() ? openFiles.erase (it) : std::next (it);
+
+    const auto key = fileToOpen.getFullPathName();
+    if (const auto it = openFiles.find (key); it != openFiles.end())
+        if (auto existing = it->second.lock())
+            return existing;
+
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+
+    auto* format = formats.findFormatForFileExtension (fileToOpen.getFileExtension());
+    if (format == nullptr)
+        return nullptr;
+
+    std::unique_ptr<juce::MemoryMappedAudioFormatReader> reader (format->createMemoryMappedReader (fileToOpen));
+    if (reader == nullptr || reader->lengthInSamples <= 0 || reader->sampleRate <= 0.0
+        || reader->numChannels < 1 || (int) reader->numChannels > maxChannels || ! reader->mapEntireFile())
+        return nullptr;
+
+    std::shared_ptr<SampleSource> source (new SampleSource());
+    source->file = fileToOpen;
+    source->sampleRate = reader->sampleRate;
+    source->length = reader->lengthInSamples;
+    source->numChannels = (int) reader->numChannels;
+    source->channelScale = 1.0f / (float) reader->numChannels;
+    source->reader = std::move (reader);
+
+    source->toucher = std::make_unique<Toucher> (*source);
+    source->toucher->startThread (juce::Thread::Priority::low);
+
+    openFiles[key] = source;
+    return source;
+}
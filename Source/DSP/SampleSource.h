@@ -0,0 +1,64 @@
+#pragma once
+
+#include <juce_audio_formats/juce_audio_formats.h>
+
+#include <memory>
+
+// An audio file mapped into memory, for the grain engine to play in place of its input.
+// Nothing is decoded up front, so even long files open instantly, and every instance that
+// opens the same file shares one mapping. A background thread touches the file's pages
+// once after opening so the audio thread's first pass through it doesn't wait on the disk.
+class SampleSource final
+{
+public:
+    // Any thread but the audio thread. nullptr if the file can't be mapped: only
+    // uncompressed WAV and AIFF files can.
+    static std::shared_ptr<const SampleSource> open (const juce::File& file);
+
+    ~SampleSource();
+
+    const juce::File& getFile() const noexcept { return file; }
+    double getSampleRate() const noexcept { return sampleRate; }
+    juce::int64 getLength() const noexcept { return length; }
+
+    // Audio thread: the average of the file's channels at a fractional position in
+    // [0, getLength()), looping round at the end.
+    float read (double position) const noexcept
+    {
+        const auto i0 = (juce::int64) position;
+        const auto i1 = i0 + 1 < length ? i0 + 1 : 0;
+        const float frac = (float) (position - (double) i0);
+        const float a = readFrame (i0);
+        const float b = readFrame (i1);
+        return a + frac * (b - a);
+    }
+
+    static constexpr int maxChannels = 8;
+
+private:
+    class Toucher;
+
+    SampleSource() = default;
+
+    float readFrame (juce::int64 index) const noexcept
+    {
+        float frame[maxChannels];
+        reader->getSample (index, frame);
+
+        float sum = 0.0f;
+        for (int ch = 0; ch < numChannels; ++ch)
+            sum += frame[ch];
+
+        return sum * channelScale;
+    }
+
+    juce::File file;
+    std::unique_ptr<juce::MemoryMappedAudioFormatReader> reader;
+    std::unique_ptr<Toucher> toucher;
+    double sampleRate = 48000.0;
+    juce::int64 length = 0;
+    int numChannels = 1;
+    float channelScale = 1.0f;
+
+    JUCE_DECLARE_NON_COPYABLE (SampleSource)
+};
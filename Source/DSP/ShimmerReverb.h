@@ -3,9 +3,17 @@
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <juce_dsp/juce_dsp.h>
 
+#include "DelayBuffer.h"
+#include "EarlyReflections.h"
+#include "../Diagnostics/TraceRecorder.h"
+
+#include <array>
+
 class ShimmerReverb final
 {
 public:
+    static constexpr float maxPreDelayMs = 250.0f; // the pre-delay line is sized for this
+
     struct Params
     {
         float roomSize = 0.55f;
@@ -14,6 +22,7 @@ public:
         float shimmerAmount = 0.25f;
         float pitchSemitones = 12.0f;
         float reverbMix = 1.0f;
+        float earlyLevel = 0.0f; // early reflections into the reverb and alongside it, 0..1; 0 = off
 
         float drift = 0.25f;
         float modRateHz = 0.35f;
@@ -21,25 +30,76 @@ public:
         bool freeze = false;
     };
 
+    // Ways to spend less CPU, for the engine's governor. The defaults are full quality.
+    struct Quality
+    {
+        bool interpolate = true; // false: nearest-sample reads in the pitch shifter
+        bool stereo = true;      // false: one pitch shifter and one set of reverb combs on the mid signal
+    };
+
+    // spec.numChannels picks the layout: 1 runs the mono path permanently, with a single
+    // pitch shifter, pre-delay and feedback line and the reverb's mono output.
     void prepare (const juce::dsp::ProcessSpec& spec)
     {
         sampleRate = spec.sampleRate;
+        stereo = spec.numChannels > 1;
+        const int numChannels = stereo ? 2 : 1;
 
-        preDelay.reset();
-        preDelay.prepare (spec);
+        preDelay.prepare (numChannels, (int) std::ceil (sampleRate * maxPreDelayMs / 1000.0), storageFormat);
 
         reverb.reset();
 
         pitchL.prepare (spec);
-        pitchR.prepare (spec);
-        // feedbackBuffer not used - tmpBuffer handles the pitched feedback
-        tmpBuffer.setSize (2, (int) spec.maximumBlockSize);
-        lastReverbOut.setSize (2, (int) spec.maximumBlockSize);
-        lastReverbOut.clear();
+
+        if (stereo)
+            pitchR.prepare (spec);
+        else
+            pitchR.release();
+
+        // The pitched feedback runs through a fixed delay rather than "last block's output",
+        // so the sound doesn't depend on the host's buffer size.
+        feedbackDelaySamples = juce::jmax (1, (int) std::round (sampleRate * feedbackDelaySeconds));
+        feedbackRing.setSize (numChannels, feedbackDelaySamples);
+        feedbackRing.clear();
+        feedbackPos = 0;
+
+        tmpBuffer.setSize (numChannels, feedbackDelaySamples);
+
+        early.prepare (sampleRate, numChannels, feedbackDelaySamples);
+        earlyBuffer.setSize (numChannels, feedbackDelaySamples);
+
+        width = quality.stereo ? 1.0f : 0.0f;
+        widthStep = 1.0f / (float) juce::jmax (1.0, sampleRate * widthRampSeconds);
     }
 
     void setParams (const Params& p) { params = p; }
 
+    // How the pre-delay line stores its samples (see DelayBuffer), applied on the next prepare().
+    void setStorageFormat (DelayBuffer::Format newFormat) { storageFormat = newFormat; }
+
+    // Heap memory held for the delay lines, once prepared. juce::Reverb's combs and
+    // all-passes are sized for 44.1 kHz whatever the rate, so they're a fixed estimate.
+    size_t getMemoryBytes() const noexcept
+    {
+        return preDelay.getMemoryBytes() + pitchL.getMemoryBytes() + pitchR.getMemoryBytes()
+               + (size_t) (feedbackRing.getNumChannels() + tmpBuffer.getNumChannels() + earlyBuffer.getNumChannels())
+                     * (size_t) feedbackDelaySamples * sizeof (float)
+               + early.getMemoryBytes() + reverbMemoryBytes;
+    }
+
+    // Audio thread. Going to and from mono narrows and widens the output over
+    // widthRampSeconds instead of switching abruptly.
+    void setQuality (const Quality& q) noexcept
+    {
+        quality = q;
+        pitchL.setInterpolation (q.interpolate);
+        pitchR.setInterpolation (q.interpolate);
+    }
+
+   #if STARLIGHT_TRACING
+    void setTraceRecorder (TraceRecorder* r) { trace = r; }
+   #endif
+
     void process (juce::AudioBuffer<float>& wetInOut)
     {
         const int numSamples = wetInOut.getNumSamples();
@@ -55,62 +115,229 @@ public:
         reverb.setParameters (rp);
 
         preDelay.setDelay ((params.preDelayMs / 1000.0f) * (float) sampleRate);
-
-        tmpBuffer.setSize (2, numSamples, false, false, true);
-        tmpBuffer.clear();
-
-        // pitch shift last block's reverb output and feed it back in (shimmer topology approximation)
-        tmpBuffer.makeCopyOf (lastReverbOut);
+        early.setRoomSize (rp.roomSize);
+        earlyLevel = juce::jlimit (0.0f, 1.0f, params.earlyLevel);
 
         const float pitchSemi = params.pitchSemitones;
         const float pitchFactor = std::pow (2.0f, pitchSemi / 12.0f);
         pitchL.setPitchFactor (pitchFactor);
         pitchR.setPitchFactor (pitchFactor);
 
-        pitchL.process (tmpBuffer.getWritePointer (0), numSamples);
-        pitchR.process (tmpBuffer.getWritePointer (1), numSamples);
-
         const float shimmer = juce::jlimit (0.0f, 1.0f, params.shimmerAmount);
+
+        // Chunks never exceed the feedback delay, so every sample read from the ring
+        // was written by an earlier chunk (or block).
+        for (int start = 0; start < numSamples; start += feedbackDelaySamples)
+        {
+            const int n = juce::jmin (feedbackDelaySamples, numSamples - start);
+            processChunk (wetInOut, start, n, shimmer);
+        }
+    }
+
+private:
+    void processChunk (juce::AudioBuffer<float>& wetInOut, int start, int numSamples, float shimmer)
+    {
+        if (! stereo || (! quality.stereo && width <= 0.0f))
+        {
+            processMonoChunk (wetInOut, start, numSamples, shimmer);
+            return;
+        }
+
+        // pitch shift the delayed reverb output and feed it back in (shimmer topology approximation)
+        for (int ch = 0; ch < 2; ++ch)
+        {
+            auto* t = tmpBuffer.getWritePointer (ch);
+            auto* ring = feedbackRing.getReadPointer (ch);
+            for (int i = 0; i < numSamples; ++i)
+                t[i] = ring[(feedbackPos + i) % feedbackDelaySamples];
+        }
+
+        {
+            STARLIGHT_TRACE_SCOPE (trace, "shimmerPitch");
+            pitchL.process (tmpBuffer.getWritePointer (0), numSamples);
+            pitchR.process (tmpBuffer.getWritePointer (1), numSamples);
+        }
+
         for (int ch = 0; ch < 2; ++ch)
         {
-            auto* w = wetInOut.getWritePointer (ch);
+            auto* w = wetInOut.getWritePointer (ch, start);
             auto* p = tmpBuffer.getReadPointer (ch);
             for (int i = 0; i < numSamples; ++i)
                 w[i] = w[i] + (0.65f * shimmer) * p[i];
         }
 
         // predelay then reverb
-        juce::dsp::AudioBlock<float> block (wetInOut);
-        preDelay.process (juce::dsp::ProcessContextReplacing<float> (block));
-        reverb.processStereo (wetInOut.getWritePointer (0), wetInOut.getWritePointer (1), numSamples);
+        {
+            STARLIGHT_TRACE_SCOPE (trace, "preDelay");
+
+            for (int ch = 0; ch < 2; ++ch)
+            {
+                auto* w = wetInOut.getWritePointer (ch, start);
+                for (int i = 0; i < numSamples; ++i)
+                    w[i] = preDelay.process (ch, w[i]);
+            }
+        }
 
-        lastReverbOut.makeCopyOf (wetInOut);
+        addEarlyReflections (wetInOut, start, numSamples, 2);
+
+        {
+            STARLIGHT_TRACE_SCOPE (trace, "reverb");
+            reverb.processStereo (wetInOut.getWritePointer (0, start), wetInOut.getWritePointer (1, start), numSamples);
+        }
+
+        mixEarlyReflections (wetInOut, start, numSamples, 2);
+
+        if (! quality.stereo || width < 1.0f)
+            rampWidth (wetInOut.getReadPointer (0, start), wetInOut.getWritePointer (1, start), numSamples);
+
+        writeFeedback (wetInOut, start, numSamples);
+    }
+
+    // The mono path: the mid signal through pitchL, the left-hand reverb combs and the
+    // left pre-delay only. In a stereo instance on the reduced path their right-hand twins
+    // sit idle, and pick up where they left off once the ramp back to stereo fades them in;
+    // a mono instance has no right-hand channel at all.
+    void processMonoChunk (juce::AudioBuffer<float>& wetInOut, int start, int numSamples, float shimmer)
+    {
+        auto* t = tmpBuffer.getWritePointer (0);
+        auto* ringL = feedbackRing.getReadPointer (0);
+
+        if (stereo)
+        {
+            auto* ringR = feedbackRing.getReadPointer (1);
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const int r = (feedbackPos + i) % feedbackDelaySamples;
+                t[i] = 0.5f * (ringL[r] + ringR[r]);
+            }
+        }
+        else
+        {
+            for (int i = 0; i < numSamples; ++i)
+                t[i] = ringL[(feedbackPos + i) % feedbackDelaySamples];
+        }
+
+        {
+            STARLIGHT_TRACE_SCOPE (trace, "shimmerPitch");
+            pitchL.process (t, numSamples);
+        }
+
+        auto* left = wetInOut.getWritePointer (0, start);
+        auto* right = stereo ? wetInOut.getWritePointer (1, start) : nullptr;
+
+        {
+            STARLIGHT_TRACE_SCOPE (trace, "preDelay");
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const float mid = right != nullptr ? 0.5f * (left[i] + right[i]) : left[i];
+                left[i] = preDelay.process (0, mid + (0.65f * shimmer) * t[i]);
+            }
+        }
+
+        addEarlyReflections (wetInOut, start, numSamples, 1);
+
+        {
+            STARLIGHT_TRACE_SCOPE (trace, "reverb");
+            reverb.processMono (left, numSamples);
+        }
+
+        mixEarlyReflections (wetInOut, start, numSamples, 1);
+
+        if (right != nullptr)
+            juce::FloatVectorOperations::copy (right, left, numSamples);
+
+        writeFeedback (wetInOut, start, numSamples);
+    }
+
+    // Feeds the pre-delayed signal to the early reflections and, with Early up, adds them to
+    // the reverb's input; they're kept in earlyBuffer to be mixed in with its output as well.
+    void addEarlyReflections (juce::AudioBuffer<float>& wetInOut, int start, int numSamples, int numChannels) noexcept
+    {
+        STARLIGHT_TRACE_SCOPE (trace, "earlyReflections");
+
+        const float* in[] = { wetInOut.getReadPointer (0, start), numChannels > 1 ? wetInOut.getReadPointer (1, start) : nullptr };
+        early.push (in, numChannels, numSamples);
+
+        if (earlyLevel <= 0.0f)
+            return;
+
+        float* out[] = { earlyBuffer.getWritePointer (0), numChannels > 1 ? earlyBuffer.getWritePointer (1) : nullptr };
+        early.render (out, numChannels, numSamples);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            juce::FloatVectorOperations::addWithMultiply (wetInOut.getWritePointer (ch, start), out[ch], earlyLevel, numSamples);
+    }
+
+    // The reflections ahead of the late reverb, at the level of its wet output.
+    void mixEarlyReflections (juce::AudioBuffer<float>& wetInOut, int start, int numSamples, int numChannels) noexcept
+    {
+        if (earlyLevel <= 0.0f)
+            return;
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            juce::FloatVectorOperations::addWithMultiply (wetInOut.getWritePointer (ch, start), earlyBuffer.getReadPointer (ch),
+                                                          earlyLevel * params.reverbMix, numSamples);
+    }
+
+    // right = left + width * (right - left), with width moving towards the target one step per sample
+    void rampWidth (const float* left, float* right, int numSamples) noexcept
+    {
+        const float target = quality.stereo ? 1.0f : 0.0f;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            width = target > width ? juce::jmin (target, width + widthStep) : juce::jmax (target, width - widthStep);
+            right[i] = left[i] + width * (right[i] - left[i]);
+        }
+    }
+
+    void writeFeedback (const juce::AudioBuffer<float>& wetInOut, int start, int numSamples)
+    {
+        for (int ch = 0; ch < feedbackRing.getNumChannels(); ++ch)
+        {
+            auto* w = wetInOut.getReadPointer (ch, start);
+            auto* ring = feedbackRing.getWritePointer (ch);
+            for (int i = 0; i < numSamples; ++i)
+                ring[(feedbackPos + i) % feedbackDelaySamples] = w[i];
+        }
+
+        feedbackPos = (feedbackPos + numSamples) % feedbackDelaySamples;
     }
 
-private:
     class DualWindowPitchShifter
     {
     public:
         void prepare (const juce::dsp::ProcessSpec& spec)
         {
             sampleRate = spec.sampleRate;
-            const int maxDelay = (int) (sampleRate * 0.08); // 80ms window
-            delay.setSize (1, maxDelay * 2);
+            delay.setSize (1, (int) std::ceil (windowSeconds * sampleRate) + 2); // the reads reach one window back
+            delay.clear();
             writePos = 0;
             phase = 0.0f;
             setPitchFactor (1.0f);
         }
 
+        // Frees the window, for a channel that won't be used until the next prepare().
+        void release()
+        {
+            delay.setSize (0, 0);
+        }
+
         void setPitchFactor (float f)
         {
             pitchFactor = juce::jlimit (0.5f, 2.0f, f);
         }
 
+        void setInterpolation (bool shouldInterpolate) { interpolate = shouldInterpolate; }
+
+        size_t getMemoryBytes() const noexcept { return (size_t) delay.getNumSamples() * sizeof (float); }
+
         void process (float* samples, int numSamples)
         {
             const int size = delay.getNumSamples();
-            const float window = 0.05f; // 50ms
-            const float windowSamples = window * (float) sampleRate;
+            const float windowSamples = windowSeconds * (float) sampleRate;
 
             const float rate = (pitchFactor - 1.0f) / windowSamples;
 
@@ -151,6 +378,13 @@ private:
         float readDelay (float pos, int size) const
         {
             pos = wrap (pos, (float) size);
+
+            if (! interpolate)
+            {
+                const int i = (int) (pos + 0.5f);
+                return delay.getSample (0, i < size ? i : 0);
+            }
+
             const int i0 = (int) pos;
             const int i1 = (i0 + 1) % size;
             const float frac = pos - (float) i0;
@@ -159,19 +393,107 @@ private:
             return a + frac * (b - a);
         }
 
+        static constexpr float windowSeconds = 0.05f;
+
         double sampleRate = 48000.0;
         float pitchFactor = 1.0f;
+        bool interpolate = true;
         juce::AudioBuffer<float> delay;
         int writePos = 0;
         float phase = 0.0f;
     };
 
+    // One or two lines with a shared, linearly interpolated delay time: the same output as
+    // juce::dsp::DelayLine<float, Linear> pushing then popping each sample, but sized to
+    // the longest pre-delay and able to store 16-bit samples.
+    class PreDelay
+    {
+    public:
+        void prepare (int numChannels, int maxDelaySamples, DelayBuffer::Format format)
+        {
+            numLines = juce::jlimit (1, 2, numChannels);
+
+            for (int ch = 0; ch < 2; ++ch)
+            {
+                if (ch < numLines)
+                    lines[(size_t) ch].setSize (juce::jmax (4, maxDelaySamples + 2), format);
+                else
+                    lines[(size_t) ch].setSize (1, format);
+
+                writePos[(size_t) ch] = 0;
+            }
+
+            setDelay (0.0f);
+        }
+
+        void setDelay (float newDelaySamples) noexcept
+        {
+            delay = juce::jlimit (0.0f, (float) (lines[0].getSize() - 2), newDelaySamples);
+            delayInt = (int) std::floor (delay);
+            delayFrac = delay - (float) delayInt;
+        }
+
+        float process (int channel, float x) noexcept
+        {
+            auto& line = lines[(size_t) channel];
+            auto& pos = writePos[(size_t) channel];
+            const int size = line.getSize();
+
+            line.write (pos, x);
+
+            int index1 = pos - delayInt;
+            if (index1 < 0) index1 += size;
+            const int index2 = index1 > 0 ? index1 - 1 : size - 1;
+
+            const float value1 = line.read (index1);
+            const float value2 = line.read (index2);
+
+            pos = pos + 1 < size ? pos + 1 : 0;
+            return value1 + delayFrac * (value2 - value1);
+        }
+
+        size_t getMemoryBytes() const noexcept
+        {
+            return lines[0].getMemoryBytes() + (numLines > 1 ? lines[1].getMemoryBytes() : 0);
+        }
+
+    private:
+        std::array<DelayBuffer, 2> lines;
+        std::array<int, 2> writePos {};
+        int numLines = 2;
+        float delay = 0.0f;
+        int delayInt = 0;
+        float delayFrac = 0.0f;
+    };
+
+    // juce::Reverb at 44.1 kHz: eight combs and four all-passes per channel, the right
+    // channel's each 23 samples longer.
+    static constexpr size_t reverbMemoryBytes = (2 * (11044 + 1563) + 12 * 23) * sizeof (float);
+
     double sampleRate = 48000.0;
+    bool stereo = true;
     Params params;
+    DelayBuffer::Format storageFormat = DelayBuffer::Format::float32;
 
-    juce::dsp::DelayLine<float, juce::dsp::DelayLineInterpolationTypes::Linear> preDelay { 200000 };
+    PreDelay preDelay;
+    EarlyReflections early;
+    juce::AudioBuffer<float> earlyBuffer;
+    float earlyLevel = 0.0f;
     juce::Reverb reverb;
 
     DualWindowPitchShifter pitchL, pitchR;
-    juce::AudioBuffer<float> tmpBuffer, lastReverbOut;
+
+    static constexpr double feedbackDelaySeconds = 0.01;
+    juce::AudioBuffer<float> feedbackRing, tmpBuffer;
+    int feedbackDelaySamples = 1;
+    int feedbackPos = 0;
+
+    static constexpr double widthRampSeconds = 0.05;
+    Quality quality;
+    float width = 1.0f;
+    float widthStep = 1.0f;
+
+   #if STARLIGHT_TRACING
+    TraceRecorder* trace = nullptr;
+   #endif
 };
@@ -0,0 +1,276 @@
+#include "RealtimeSafety.h"
+
+#if STARLIGHT_RT_CHECKS
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+
+#if JUCE_LINUX || JUCE_MAC
+ #include <dlfcn.h>
+ #include <execinfo.h>
+ #include <pthread.h>
+#endif
+
+#if JUCE_LINUX
+ #define STARLIGHT_LIBC_NOEXCEPT noexcept
+#else
+ #define STARLIGHT_LIBC_NOEXCEPT
+#endif
+
+namespace
+{
+    constexpr int maxFrames = 32;
+    constexpr int maxStoredViolations = 256;
+
+    // Filled from inside the hooks, so everything here is preallocated and POD.
+    struct Record
+    {
+        RealtimeSafety::Kind kind;
+        const char* what;
+        size_t bytes;
+        int numFrames;
+        void* frames[maxFrames];
+    };
+
+    Record records[maxStoredViolations];
+    std::atomic<int> numRecords { 0 };
+    std::atomic<juce::int64> violationCount { 0 };
+    std::atomic<bool> enabled { true };
+
+    thread_local int audioThreadDepth = 0;
+    thread_local bool insideHook = false;
+
+    void recordViolation (RealtimeSafety::Kind kind, const char* what, size_t bytes) noexcept
+    {
+        if (audioThreadDepth == 0 || insideHook || ! enabled.load (std::memory_order_relaxed))
+            return;
+
+        insideHook = true; // backtrace() may allocate the first time round
+
+        violationCount.fetch_add (1, std::memory_order_relaxed);
+
+        const int slot = numRecords.fetch_add (1, std::memory_order_relaxed);
+        if (slot < maxStoredViolations)
+        {
+            auto& r = records[slot];
+            r.kind = kind;
+            r.what = what;
+            r.bytes = bytes;
+           #if JUCE_LINUX || JUCE_MAC
+            r.numFrames = backtrace (r.frames, maxFrames);
+           #else
+            r.numFrames = 0;
+           #endif
+        }
+
+        insideHook = false;
+    }
+
+    const char* getKindName (RealtimeSafety::Kind kind)
+    {
+        switch (kind)
+        {
+            case RealtimeSafety::Kind::allocation:   return "allocation";
+            case RealtimeSafety::Kind::deallocation: return "deallocation";
+            case RealtimeSafety::Kind::lock:         return "lock";
+        }
+
+        return "";
+    }
+}
+
+namespace RealtimeSafety
+{
+    ScopedAudioThread::ScopedAudioThread() noexcept { ++audioThreadDepth; }
+    ScopedAudioThread::~ScopedAudioThread() { --audioThreadDepth; }
+
+    void setEnabled (bool shouldBeEnabled) noexcept { enabled.store (shouldBeEnabled); }
+    bool isEnabled() noexcept { return enabled.load(); }
+
+    void noteLock (const char* what) noexcept
+    {
+        recordViolation (Kind::lock, what, 0);
+    }
+
+    juce::int64 getViolationCount() noexcept { return violationCount.load(); }
+
+    std::vector<Violation> getViolations()
+    {
+        std::vector<Violation> result;
+        const int n = juce::jmin (numRecords.load(), maxStoredViolations);
+
+        for (int i = 0; i < n; ++i)
+        {
+            const auto& r = records[i];
+
+            Violation v;
+            v.kind = r.kind;
+            v.what = r.what;
+            if (r.bytes > 0)
+                v.what << " (" << (juce::int64) r.bytes << " bytes)";
+
+           #if JUCE_LINUX || JUCE_MAC
+            if (auto** symbols = backtrace_symbols (r.frames, r.numFrames))
+            {
+                // frame 0 is recordViolation, frame 1 the hook itself
+                for (int f = 2; f < r.numFrames; ++f)
+                    v.stack.add (symbols[f]);
+
+                std::free (symbols);
+            }
+           #endif
+
+            result.push_back (std::move (v));
+        }
+
+        return result;
+    }
+
+    juce::String formatViolations (int maxToShow)
+    {
+        juce::String out;
+        out << "Real-time safety violations: " << getViolationCount() << "\n";
+
+        int shown = 0;
+        for (const auto& v : getViolations())
+        {
+            if (shown++ >= maxToShow)
+                break;
+
+            out << "\n[" << getKindName (v.kind) << "] " << v.what << "\n";
+            for (const auto& frame : v.stack)
+                out << "    " << frame << "\n";
+        }
+
+        return out;
+    }
+
+    void clear() noexcept
+    {
+        numRecords.store (0);
+        violationCount.store (0);
+    }
+}
+
+//==============================================================================
+// Interposers. glibc lets an executable replace malloc & co. outright and
+// forward to the __libc_* entry points; elsewhere we fall back to replacing
+// the global operator new/delete, which covers everything our code allocates.
+#if JUCE_LINUX
+extern "C"
+{
+    void* __libc_malloc (size_t);
+    void* __libc_calloc (size_t, size_t);
+    void* __libc_realloc (void*, size_t);
+    void* __libc_memalign (size_t, size_t);
+    void __libc_free (void*);
+
+    void* malloc (size_t size) noexcept
+    {
+        recordViolation (RealtimeSafety::Kind::allocation, "malloc", size);
+        return __libc_malloc (size);
+    }
+
+    void* calloc (size_t count, size_t size) noexcept
+    {
+        recordViolation (RealtimeSafety::Kind::allocation, "calloc", count * size);
+        return __libc_calloc (count, size);
+    }
+
+    void* realloc (void* ptr, size_t size) noexcept
+    {
+        recordViolation (RealtimeSafety::Kind::allocation, "realloc", size);
+        return __libc_realloc (ptr, size);
+    }
+
+    void* memalign (size_t alignment, size_t size) noexcept
+    {
+        recordViolation (RealtimeSafety::Kind::allocation, "memalign", size);
+        return __libc_memalign (alignment, size);
+    }
+
+    void* aligned_alloc (size_t alignment, size_t size) noexcept
+    {
+        recordViolation (RealtimeSafety::Kind::allocation, "aligned_alloc", size);
+        return __libc_memalign (alignment, size);
+    }
+
+    int posix_memalign (void** result, size_t alignment, size_t size) noexcept
+    {
+        recordViolation (RealtimeSafety::Kind::allocation, "posix_memalign", size);
+        *result = __libc_memalign (alignment, size);
+        return *result != nullptr ? 0 : ENOMEM;
+    }
+
+    void free (void* ptr) noexcept
+    {
+        if (ptr != nullptr)
+            recordViolation (RealtimeSafety::Kind::deallocation, "free", 0);
+
+        __libc_free (ptr);
+    }
+}
+#else
+void* operator new (std::size_t size)
+{
+    recordViolation (RealtimeSafety::Kind::allocation, "operator new", size);
+    if (auto* p = std::malloc (size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[] (std::size_t size)
+{
+    recordViolation (RealtimeSafety::Kind::allocation, "operator new[]", size);
+    if (auto* p = std::malloc (size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new (std::size_t size, const std::nothrow_t&) noexcept
+{
+    recordViolation (RealtimeSafety::Kind::allocation, "operator new", size);
+    return std::malloc (size == 0 ? 1 : size);
+}
+
+void* operator new[] (std::size_t size, const std::nothrow_t&) noexcept
+{
+    recordViolation (RealtimeSafety::Kind::allocation, "operator new[]", size);
+    return std::malloc (size == 0 ? 1 : size);
+}
+
+void operator delete (void* p) noexcept
+{
+    if (p != nullptr)
+        recordViolation (RealtimeSafety::Kind::deallocation, "operator delete", 0);
+    std::free (p);
+}
+
+void operator delete[] (void* p) noexcept
+{
+    if (p != nullptr)
+        recordViolation (RealtimeSafety::Kind::deallocation, "operator delete[]", 0);
+    std::free (p);
+}
+
+void operator delete (void* p, std::size_t) noexcept { operator delete (p); }
+void operator delete[] (void* p, std::size_t) noexcept { operator delete[] (p); }
+#endif
+
+#if JUCE_LINUX || JUCE_MAC
+extern "C" int pthread_mutex_lock (pthread_mutex_t* mutex) STARLIGHT_LIBC_NOEXCEPT
+{
+    // no guarded static here: the guard itself may take a mutex
+    using LockFn = int (*) (pthread_mutex_t*);
+    static LockFn real = nullptr;
+    if (real == nullptr)
+        real = (LockFn) dlsym (RTLD_NEXT, "pthread_mutex_lock");
+
+    recordViolation (RealtimeSafety::Kind::lock, "pthread_mutex_lock", 0);
+    return real (mutex);
+}
+#endif
+
+#endif
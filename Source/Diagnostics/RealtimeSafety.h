@@ -0,0 +1,69 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#ifndef STARLIGHT_RT_CHECKS
+ #define STARLIGHT_RT_CHECKS 0
+#endif
+
+#if STARLIGHT_RT_CHECKS
+
+// Test/benchmark-only audit of the audio thread. While a ScopedAudioThread is
+// alive on a thread (processBlock opens one), every heap allocation, free and
+// blocking mutex acquisition on that thread is recorded as a violation along
+// with its call stack. Allocation and mutex functions are interposed in
+// RealtimeSafety.cpp, so this must only be compiled into executables we own,
+// never into the plugin binary. juce::SpinLock never reaches a mutex, so its
+// blocking acquisitions are marked with STARLIGHT_RT_NOTE_LOCK instead; the
+// audio thread's own try-locks never wait and aren't marked.
+namespace RealtimeSafety
+{
+    enum class Kind
+    {
+        allocation,
+        deallocation,
+        lock
+    };
+
+    struct Violation
+    {
+        Kind kind = Kind::allocation;
+        juce::String what;
+        juce::StringArray stack;
+    };
+
+    class ScopedAudioThread
+    {
+    public:
+        ScopedAudioThread() noexcept;
+        ~ScopedAudioThread();
+
+    private:
+        JUCE_DECLARE_NON_COPYABLE (ScopedAudioThread)
+    };
+
+    void setEnabled (bool shouldBeEnabled) noexcept;
+    bool isEnabled() noexcept;
+
+    // Call just before a blocking acquisition of a lock the interposers can't see (spin
+    // locks and the like); a violation if it happens on an audio thread.
+    void noteLock (const char* what) noexcept;
+
+    juce::int64 getViolationCount() noexcept;
+
+    // Symbolises the stored violations; call from a non-audio thread.
+    std::vector<Violation> getViolations();
+    juce::String formatViolations (int maxToShow = 10);
+
+    void clear() noexcept;
+}
+
+ #define STARLIGHT_RT_AUDIO_THREAD_SCOPE const RealtimeSafety::ScopedAudioThread starlightRealtimeScope
+ #define STARLIGHT_RT_NOTE_LOCK(what) RealtimeSafety::noteLock (what)
+
+#else
+
+ #define STARLIGHT_RT_AUDIO_THREAD_SCOPE
+ #define STARLIGHT_RT_NOTE_LOCK(what)
+
+#endif
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <atomic>
+#include <map>
+#include <vector>
+
+#ifndef STARLIGHT_TRACING
+ #define STARLIGHT_TRACING 0
+#endif
+
+#if STARLIGHT_TRACING
+
+// Records begin/end/instant/counter events from the audio thread into a
+// preallocated lock-free ring, and drains them on a background thread into a
+// Chrome trace JSON file (open it in Perfetto or chrome://tracing).
+class TraceRecorder final : private juce::Thread
+{
+public:
+    enum class Phase : char
+    {
+        begin = 'B',
+        end = 'E',
+        instant = 'i',
+        counter = 'C'
+    };
+
+    struct Event
+    {
+        const char* name = nullptr; // must point at storage that outlives the recording
+        juce::int64 ticks = 0;
+        juce::Thread::ThreadID threadId = nullptr;
+        float value = 0.0f;
+        Phase phase = Phase::instant;
+    };
+
+    explicit TraceRecorder (int capacity = 1 << 16)
+        : juce::Thread ("Starlight Trace Writer"), fifo (capacity)
+    {
+        events.resize ((size_t) capacity);
+    }
+
+    ~TraceRecorder() override { stop(); }
+
+    bool start (const juce::File& file)
+    {
+        stop();
+
+        auto out = std::make_unique<juce::FileOutputStream> (file);
+        if (! out->openedOk())
+            return false;
+
+        out->setPosition (0);
+        out->truncate();
+
+        stream = std::move (out);
+        threadIndices.clear();
+        dropped.store (0);
+        firstEvent = true;
+        startTicks = juce::Time::getHighResolutionTicks();
+
+        recording.store (true);
+        startThread();
+        return true;
+    }
+
+    void stop()
+    {
+        recording.store (false);
+
+        if (isThreadRunning())
+            stopThread (2000);
+    }
+
+    bool isRecording() const noexcept { return recording.load (std::memory_order_relaxed); }
+
+    // Audio thread: never blocks or allocates, drops the event if the ring is full.
+    void record (Phase phase, const char* name, float value = 0.0f) noexcept
+    {
+        if (! isRecording())
+            return;
+
+        const auto scope = fifo.write (1);
+        if (scope.blockSize1 + scope.blockSize2 == 0)
+        {
+            dropped.fetch_add (1, std::memory_order_relaxed);
+            return;
+        }
+
+        auto& e = events[(size_t) (scope.blockSize1 > 0 ? scope.startIndex1 : scope.startIndex2)];
+        e.name = name;
+        e.ticks = juce::Time::getHighResolutionTicks();
+        e.threadId = juce::Thread::getCurrentThreadId();
+        e.value = value;
+        e.phase = phase;
+    }
+
+    class Scope
+    {
+    public:
+        Scope (TraceRecorder* r, const char* n) noexcept : recorder (r), name (n)
+        {
+            if (recorder != nullptr)
+                recorder->record (Phase::begin, name);
+        }
+
+        ~Scope()
+        {
+            if (recorder != nullptr)
+                recorder->record (Phase::end, name);
+        }
+
+    private:
+        TraceRecorder* recorder;
+        const char* name;
+
+        JUCE_DECLARE_NON_COPYABLE (Scope)
+    };
+
+private:
+    void run() override
+    {
+        stream->writeText ("{\"traceEvents\":[\n", false, false, nullptr);
+
+        while (! threadShouldExit())
+        {
+            drain();
+            wait (20);
+        }
+
+        drain();
+
+        juce::String footer;
+        footer << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":" << (juce::int64) dropped.load() << "}}\n";
+        stream->writeText (footer, false, false, nullptr);
+        stream->flush();
+        stream.reset();
+    }
+
+    void drain()
+    {
+        const auto scope = fifo.read (fifo.getNumReady());
+        scope.forEach ([this] (int index) { writeEvent (events[(size_t) index]); });
+    }
+
+    int getThreadIndex (juce::Thread::ThreadID id)
+    {
+        const auto it = threadIndices.find (id);
+        if (it != threadIndices.end())
+            return it->second;
+
+        const int index = (int) threadIndices.size() + 1;
+        threadIndices[id] = index;
+
+        juce::String meta;
+        meta << (firstEvent ? "" : ",\n")
+             << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << index
+             << ",\"args\":{\"name\":\"Starlight audio " << index << "\"}}";
+        stream->writeText (meta, false, false, nullptr);
+        firstEvent = false;
+
+        return index;
+    }
+
+    void writeEvent (const Event& e)
+    {
+        // events queued before this recording started (or after a stop) are stale
+        if (e.ticks < startTicks || e.name == nullptr)
+            return;
+
+        const int tid = getThreadIndex (e.threadId);
+        const double micros = juce::Time::highResolutionTicksToSeconds (e.ticks - startTicks) * 1.0e6;
+
+        juce::String line;
+        line << (firstEvent ? "" : ",\n")
+             << "{\"name\":\"" << e.name << "\",\"ph\":\"" << juce::String::charToString ((juce::juce_wchar) e.phase)
+             << "\",\"ts\":" << juce::String (micros, 3) << ",\"pid\":1,\"tid\":" << tid;
+
+        if (e.phase == Phase::instant)
+            line << ",\"s\":\"t\"";
+        else if (e.phase == Phase::counter)
+            line << ",\"args\":{\"value\":" << juce::String (e.value, 6) << "}";
+
+        line << "}";
+        stream->writeText (line, false, false, nullptr);
+        firstEvent = false;
+    }
+
+    juce::AbstractFifo fifo;
+    std::vector<Event> events;
+
+    std::atomic<bool> recording { false };
+    std::atomic<juce::int64> dropped { 0 };
+    juce::int64 startTicks = 0;
+
+    // writer-thread state
+    std::unique_ptr<juce::FileOutputStream> stream;
+    std::map<juce::Thread::ThreadID, int> threadIndices;
+    bool firstEvent = true;
+
+    JUCE_DECLARE_NON_COPYABLE (TraceRecorder)
+};
+
+ #define STARLIGHT_TRACE_SCOPE(recorder, name) const TraceRecorder::Scope JUCE_JOIN_MACRO (starlightTraceScope_, __LINE__) (recorder, name)
+ #define STARLIGHT_TRACE_INSTANT(recorder, name) do { if (auto* starlightTraceRec = (recorder)) starlightTraceRec->record (TraceRecorder::Phase::instant, name); } while (false)
+ #define STARLIGHT_TRACE_COUNTER(recorder, name, value) do { if (auto* starlightTraceRec = (recorder)) starlightTraceRec->record (TraceRecorder::Phase::counter, name, value); } while (false)
+
+#else
+
+ #define STARLIGHT_TRACE_SCOPE(recorder, name)
+ #define STARLIGHT_TRACE_INSTANT(recorder, name) do {} while (false)
+ #define STARLIGHT_TRACE_COUNTER(recorder, name, value) do {} while (false)
+
+#endif
@@ -0,0 +1,111 @@
+#include "FrozenTexture.h"
+#include "../DSP/DelayBuffer.h"
+
+#include <cstdint>
+
+static constexpr int textureMagic = 0x7a664453; // "SDfz"
+static constexpr int textureVersion = 1;
+
+// The longest texture readFrom() accepts: a 5 s loop at 384 kHz, in sixteen groups.
+static constexpr int maxChannels = 32;
+static constexpr int maxSamples = 384000 * 5;
+
+static std::int16_t toFixed (float x) noexcept
+{
+    return (std::int16_t) juce::roundToInt (juce::jlimit (-1.0f, 1.0f, x * (1.0f / DelayBuffer::int16Headroom)) * 32767.0f);
+}
+
+static float fromFixed (std::int16_t s) noexcept
+{
+    return (float) s * (DelayBuffer::int16Headroom / 32767.0f);
+}
+
+void FrozenTexture::writeTo (juce::OutputStream& out) const
+{
+    out.writeInt (textureMagic);
+    out.writeInt (textureVersion);
+    out.writeDouble (sampleRate);
+    out.writeInt (seamLength);
+    out.writeInt (audio.getNumChannels());
+    out.writeInt (audio.getNumSamples());
+
+    juce::MemoryOutputStream packed;
+
+    {
+        juce::GZIPCompressorOutputStream zip (packed, 6);
+
+        for (int ch = 0; ch < audio.getNumChannels(); ++ch)
+        {
+            const auto* x = audio.getReadPointer (ch);
+            std::int16_t previous = 0;
+
+            for (int i = 0; i < audio.getNumSamples(); ++i)
+            {
+                const auto s = toFixed (x[i]);
+                zip.writeShort ((short) (std::uint16_t) (s - previous));
+                previous = s;
+            }
+        }
+    }
+
+    out.writeInt ((int) packed.getDataSize());
+    out.write (packed.getData(), packed.getDataSize());
+}
+
+std::unique_ptr<FrozenTexture> FrozenTexture::readFrom (const void* data, size_t numBytes)
+{
+    juce::MemoryInputStream in (data, numBytes, false);
+
+    if (in.readInt() != textureMagic || in.readInt() != textureVersion)
+        return nullptr;
+
+    auto texture = std::make_unique<FrozenTexture>();
+    texture->sampleRate = in.readDouble();
+    texture->seamLength = in.readInt();
+
+    const int numChannels = in.readInt();
+    const int numSamples = in.readInt();
+    const int packedSize = in.readInt();
+
+    if (! (texture->sampleRate > 0.0) || numChannels < 1 || numChannels > maxChannels || numSamples > maxSamples
+        || texture->seamLength < 1 || texture->seamLength > numSamples / 2
+        || packedSize <= 0 || packedSize > in.getNumBytesRemaining())
+        return nullptr;
+
+    juce::MemoryInputStream packed ((const char*) data + in.getPosition(), (size_t) packedSize, false);
+    juce::GZIPDecompressorInputStream zip (packed);
+
+    const auto numDeltas = (size_t) numChannels * (size_t) numSamples;
+    juce::MemoryBlock deltas (numDeltas * 2);
+
+    // in chunks, so a loader thread that's asked to stop doesn't have to finish first
+    for (size_t done = 0; done < deltas.getSize();)
+    {
+        if (juce::Thread::currentThreadShouldExit())
+            return nullptr;
+
+        const auto chunk = (int) juce::jmin (deltas.getSize() - done, (size_t) 1 << 16);
+        const int read = zip.read (static_cast<char*> (deltas.getData()) + done, chunk);
+        if (read <= 0)
+            return nullptr;
+
+        done += (size_t) read;
+    }
+
+    texture->audio.setSize (numChannels, numSamples);
+    const auto* d = static_cast<const char*> (deltas.getData());
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        auto* x = texture->audio.getWritePointer (ch);
+        std::uint16_t s = 0;
+
+        for (int i = 0; i < numSamples; ++i, d += 2)
+        {
+            s = (std::uint16_t) (s + juce::ByteOrder::littleEndianShort (d));
+            x[i] = fromFixed ((std::int16_t) s);
+        }
+    }
+
+    return texture;
+}
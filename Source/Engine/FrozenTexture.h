@@ -0,0 +1,29 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include <memory>
+
+// A completed freeze taken out of a StarlightEngine, in a form that can be saved with a
+// session and put back when it's reopened: every channel group's recorded grain loop
+// (see GranularDelay::process()), lead-in first.
+//
+// Saved as 16-bit samples in the same fixed-point format DelayBuffer's int16 storage
+// uses, so a texture frozen with 16-bit lines comes back exactly, and with +12 dB of
+// headroom and a noise floor 84 dB down otherwise. The samples are delta coded and
+// deflated, which roughly halves them again.
+struct FrozenTexture
+{
+    double sampleRate = 0.0;
+    int seamLength = 0; // lead-in samples ahead of the loop proper
+
+    // Channels 2g and 2g + 1 for group g, as in the engine's block buffers; a mono group
+    // leaves its second channel silent.
+    juce::AudioBuffer<float> audio;
+
+    void writeTo (juce::OutputStream&) const;
+
+    // nullptr if the data isn't a texture this version can read, or if the calling thread
+    // is asked to exit (juce::Thread::currentThreadShouldExit()) while it's decoding.
+    static std::unique_ptr<FrozenTexture> readFrom (const void* data, size_t numBytes);
+};
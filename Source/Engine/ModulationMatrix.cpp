@@ -0,0 +1,176 @@
+#include "ModulationMatrix.h"
+
+#include "../Diagnostics/RealtimeSafety.h"
+
+#include <cmath>
+
+ModulationMatrix::Routing ModulationMatrix::Routing::make (int source, int destination, float amount, Mode mode, Curve curve) noexcept
+{
+    Routing r;
+    r.source = source;
+    r.destination = destination;
+    r.amount = amount;
+    r.mode = mode;
+    r.curve = curve;
+    r.lockMask = destination < ParamIndex::count ? 1u << destination : 0u;
+    return r;
+}
+
+bool ModulationMatrix::Routing::operator== (const Routing& other) const noexcept
+{
+    return source == other.source && destination == other.destination && amount == other.amount
+           && mode == other.mode && curve == other.curve && lockMask == other.lockMask;
+}
+
+std::vector<ModulationMatrix::Routing> ModulationMatrix::getDefaultRoutings()
+{
+    return {
+        Routing::make (ParamIndex::air, ParamIndex::density, 0.8f, Mode::scale),
+        Routing::make (ParamIndex::air, ParamIndex::tone, 0.25f, Mode::add),
+        Routing::make (ParamIndex::air, ParamIndex::shimmerAmt, 0.35f, Mode::add),
+        Routing::make (ParamIndex::glass, ParamIndex::grainSizeMs, -0.35f, Mode::scale),
+        Routing::make (ParamIndex::glass, ParamIndex::spread, 0.5f, Mode::add),
+        Routing::make (ParamIndex::glass, ParamIndex::pitchSemi, 2.0f, Mode::add),
+
+        // an octave up at full Glass, even with Shimmer Pitch locked
+        Routing::make (ParamIndex::glass, shimmerInterval, 12.0f, Mode::add),
+    };
+}
+
+std::array<juce::Range<float>, ModulationMatrix::numDestinations> ModulationMatrix::makeLimits() noexcept
+{
+    std::array<juce::Range<float>, numDestinations> l;
+
+    for (int i = 0; i < ParamIndex::count; ++i)
+        l[(size_t) i] = { paramSpecs[i].minValue, paramSpecs[i].maxValue };
+
+    l[(size_t) ParamIndex::density].setEnd (1.8f * paramSpecs[ParamIndex::density].maxValue);
+    l[(size_t) ParamIndex::grainSizeMs].setStart (0.65f * paramSpecs[ParamIndex::grainSizeMs].minValue);
+    l[(size_t) ParamIndex::pitchSemi].setEnd (paramSpecs[ParamIndex::pitchSemi].maxValue + 2.0f);
+    l[(size_t) shimmerInterval] = { 5.0f, 36.0f };
+    return l;
+}
+
+juce::Range<float> ModulationMatrix::getLimits (int destination) noexcept
+{
+    static const auto l = makeLimits();
+    return juce::isPositiveAndBelow (destination, numDestinations) ? l[(size_t) destination] : juce::Range<float>();
+}
+
+bool ModulationMatrix::isValid (const Routing& r) noexcept
+{
+    auto modulatable = [] (int index)
+    {
+        return juce::isPositiveAndBelow (index, (int) ParamIndex::count)
+               && paramSpecs[index].kind == ParamSpec::Kind::continuous
+               && index != ParamIndex::morph && index != ParamIndex::morphY;
+    };
+
+    return modulatable (r.source) && (modulatable (r.destination) || r.destination == shimmerInterval)
+           && std::isfinite (r.amount);
+}
+
+ModulationMatrix::ModulationMatrix()
+{
+    setRoutings (getDefaultRoutings());
+}
+
+void ModulationMatrix::setRoutings (const std::vector<Routing>& newRoutings)
+{
+    std::vector<Routing> valid;
+    Table t;
+
+    for (const auto& r : newRoutings)
+    {
+        if (! isValid (r) || t.numEntries == maxRoutings)
+            continue;
+
+        valid.push_back (r);
+
+        auto& e = t.entries[(size_t) t.numEntries++];
+        const auto& spec = paramSpecs[r.source];
+        e.source = r.source;
+        e.destination = r.destination;
+        e.sourceMin = spec.minValue;
+        e.sourceScale = 1.0f / (spec.maxValue - spec.minValue);
+        e.k1 = r.curve == Curve::linear ? 1.0f : 0.0f;
+        e.k2 = r.curve == Curve::squared ? 1.0f : r.curve == Curve::smooth ? 3.0f : 0.0f;
+        e.k3 = r.curve == Curve::smooth ? -2.0f : 0.0f;
+        e.add = r.mode == Mode::add ? r.amount : 0.0f;
+        e.scale = r.mode == Mode::scale ? r.amount : 0.0f;
+        e.lockMask = r.lockMask;
+    }
+
+    STARLIGHT_RT_NOTE_LOCK ("ModulationMatrix::tableLock");
+    const juce::SpinLock::ScopedLockType sl (tableLock);
+    routings = std::move (valid);
+    compiled = t;
+    ++tableVersion;
+}
+
+std::vector<ModulationMatrix::Routing> ModulationMatrix::getRoutings() const
+{
+    STARLIGHT_RT_NOTE_LOCK ("ModulationMatrix::tableLock");
+    const juce::SpinLock::ScopedLockType sl (tableLock);
+    return routings;
+}
+
+void ModulationMatrix::apply (ParameterSnapshot& snapshot, float& interval) noexcept
+{
+    if (const auto version = tableVersion.load(); version != tableVersionInUse)
+    {
+        const juce::SpinLock::ScopedTryLockType sl (tableLock);
+        if (sl.isLocked())
+        {
+            table = compiled;
+            tableVersionInUse = version;
+        }
+    }
+
+    run (table, snapshot, interval);
+}
+
+void ModulationMatrix::modulate (ParameterSnapshot& snapshot, float& interval) const noexcept
+{
+    Table t;
+    {
+        STARLIGHT_RT_NOTE_LOCK ("ModulationMatrix::tableLock");
+        const juce::SpinLock::ScopedLockType sl (tableLock);
+        t = compiled;
+    }
+
+    run (t, snapshot, interval);
+}
+
+void ModulationMatrix::run (const Table& t, ParameterSnapshot& snapshot, float& interval) const noexcept
+{
+    std::array<float, numDestinations> values, scale, add;
+
+    for (int d = 0; d < ParamIndex::count; ++d)
+        values[(size_t) d] = snapshot.get (d);
+
+    values[shimmerInterval] = interval;
+    scale.fill (1.0f);
+    add.fill (0.0f);
+
+    const auto locks = snapshot.lockMask;
+
+    for (int n = 0; n < t.numEntries; ++n)
+    {
+        const auto& e = t.entries[(size_t) n];
+        const float active = (float) ((locks & e.lockMask) == 0);
+        const float x = juce::jlimit (0.0f, 1.0f, (snapshot.get (e.source) - e.sourceMin) * e.sourceScale);
+        const float shaped = x * (e.k1 + x * (e.k2 + x * e.k3));
+
+        scale[(size_t) e.destination] *= 1.0f + (active * e.scale) * shaped;
+        add[(size_t) e.destination] += (active * e.add) * shaped;
+    }
+
+    for (int d = 0; d < numDestinations; ++d)
+        values[(size_t) d] = limits[(size_t) d].clipValue (values[(size_t) d] * scale[(size_t) d] + add[(size_t) d]);
+
+    for (int d = 0; d < ParamIndex::count; ++d)
+        snapshot.set (d, values[(size_t) d]);
+
+    interval = values[shimmerInterval];
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include "Parameters.h"
+
+#include <array>
+#include <atomic>
+#include <vector>
+
+// The macros as data: routings from a source parameter (Air and Glass, though any
+// parameter will do) to a destination, each with an amount, a curve and the lock bits that
+// hold it off. setRoutings() compiles them into a flat table of fixed size, and apply()
+// runs through it once a block with no branches and no allocation, however many there are.
+//
+// A source is read as 0..1 across its range and shaped by its curve. An additive routing
+// adds amount * shaped source to the destination (in the destination's units); a scaling
+// one multiplies it by 1 + amount * shaped source. Each destination gets its own value
+// scaled by every scaling routing, plus every additive one, and is then held within
+// getLimits(). Routings only ever read the parameters as set, never each other's results.
+class ModulationMatrix final
+{
+public:
+    enum class Mode { add, scale };
+    enum class Curve { linear, squared, smooth };
+
+    // The shimmer's interval in semitones, after Shimmer Pitch has picked it: a destination
+    // beyond the parameters.
+    static constexpr int shimmerInterval = ParamIndex::count;
+    static constexpr int numDestinations = ParamIndex::count + 1;
+    static constexpr int maxRoutings = 64;
+
+    struct Routing
+    {
+        int source = ParamIndex::air;
+        int destination = ParamIndex::density;
+        float amount = 0.0f;
+        Mode mode = Mode::add;
+        Curve curve = Curve::linear;
+        juce::uint32 lockMask = 0; // the routing is held off while any of these parameters is locked
+
+        // Held off by locking its destination, as the knobs' own locks have always worked.
+        static Routing make (int source, int destination, float amount, Mode mode, Curve curve = Curve::linear) noexcept;
+
+        bool operator== (const Routing&) const noexcept;
+        bool operator!= (const Routing& other) const noexcept { return ! operator== (other); }
+    };
+
+    // Air and Glass as they've always worked.
+    static std::vector<Routing> getDefaultRoutings();
+
+    // Where a destination is held after modulation: its parameter's range, stretched where
+    // the default macros have always taken it further (Air raises Density up to 1.8 times its
+    // maximum, Glass shortens grains and raises Pitch by up to two semitones).
+    static juce::Range<float> getLimits (int destination) noexcept;
+
+    // Whether a routing can be compiled: continuous source and destination parameters (or
+    // shimmerInterval), not the morph position or CPU Guard.
+    static bool isValid (const Routing&) noexcept;
+
+    ModulationMatrix();
+
+    // Not for the audio thread. Invalid routings and any past maxRoutings are dropped.
+    void setRoutings (const std::vector<Routing>&);
+    std::vector<Routing> getRoutings() const;
+
+    // Audio thread: modulates the snapshot in place, and `interval` (the shimmer's, in
+    // semitones) with it. Picks up new routings on the first block that doesn't find them
+    // being compiled.
+    void apply (ParameterSnapshot& snapshot, float& interval) noexcept;
+
+    // Not for the audio thread: apply() with the routings as last set, for working out what
+    // the engine will play (its tail, say) from the parameters as set.
+    void modulate (ParameterSnapshot& snapshot, float& interval) const noexcept;
+
+private:
+    struct Entry
+    {
+        int source = 0, destination = 0;
+        float sourceMin = 0.0f, sourceScale = 0.0f; // to 0..1
+        float k1 = 0.0f, k2 = 0.0f, k3 = 0.0f;     // curve: x * (k1 + x * (k2 + x * k3))
+        float add = 0.0f, scale = 0.0f;            // one of them is zero
+        juce::uint32 lockMask = 0;
+    };
+
+    struct Table
+    {
+        std::array<Entry, maxRoutings> entries;
+        int numEntries = 0;
+    };
+
+    static std::array<juce::Range<float>, numDestinations> makeLimits() noexcept;
+    void run (const Table&, ParameterSnapshot& snapshot, float& interval) const noexcept;
+
+    // message side
+    std::vector<Routing> routings;
+    Table compiled;
+    mutable juce::SpinLock tableLock;
+    std::atomic<juce::uint32> tableVersion { 0 };
+
+    // audio side
+    Table table;
+    juce::uint32 tableVersionInUse = 0;
+    const std::array<juce::Range<float>, numDestinations> limits = makeLimits();
+};
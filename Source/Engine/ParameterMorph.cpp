@@ -0,0 +1,148 @@
+#include "ParameterMorph.h"
+
+#include "../Diagnostics/RealtimeSafety.h"
+
+#include <cmath>
+
+// the knob's scale, as juce::NormalisableRange maps it with the spec's skew
+static float toNormalised (int index, float value) noexcept
+{
+    const auto& spec = paramSpecs[index];
+    const float proportion = juce::jlimit (0.0f, 1.0f, (value - spec.minValue) / (spec.maxValue - spec.minValue));
+    return spec.skew == 1.0f ? proportion : std::pow (proportion, spec.skew);
+}
+
+static float fromNormalised (int index, float proportion) noexcept
+{
+    const auto& spec = paramSpecs[index];
+    if (spec.skew != 1.0f && proportion > 0.0f)
+        proportion = std::exp (std::log (proportion) / spec.skew);
+
+    return spec.minValue + (spec.maxValue - spec.minValue) * proportion;
+}
+
+bool ParameterMorph::Slots::operator== (const Slots& other) const noexcept
+{
+    if (storedMask != other.storedMask)
+        return false;
+
+    for (int s = 0; s < numSlots; ++s)
+        if (isStored (s) && params[(size_t) s].values != other.params[(size_t) s].values)
+            return false;
+
+    return true;
+}
+
+bool ParameterMorph::isMorphed (int paramIndex) noexcept
+{
+    return paramIndex != ParamIndex::cpuGuard && paramIndex != ParamIndex::morph && paramIndex != ParamIndex::morphY;
+}
+
+void ParameterMorph::storeSlot (int slot, const ParameterSnapshot& params)
+{
+    if (! juce::isPositiveAndBelow (slot, numSlots))
+        return;
+
+    STARLIGHT_RT_NOTE_LOCK ("ParameterMorph::slotLock");
+    const juce::SpinLock::ScopedLockType sl (slotLock);
+    slots.params[(size_t) slot] = params;
+    slots.params[(size_t) slot].lockMask = 0;
+    slots.storedMask |= 1u << slot;
+    ++slotsVersion;
+}
+
+void ParameterMorph::clearSlot (int slot)
+{
+    if (! juce::isPositiveAndBelow (slot, numSlots))
+        return;
+
+    STARLIGHT_RT_NOTE_LOCK ("ParameterMorph::slotLock");
+    const juce::SpinLock::ScopedLockType sl (slotLock);
+    slots.params[(size_t) slot] = {};
+    slots.storedMask &= ~(1u << slot);
+    ++slotsVersion;
+}
+
+ParameterMorph::Slots ParameterMorph::getSlots() const
+{
+    STARLIGHT_RT_NOTE_LOCK ("ParameterMorph::slotLock");
+    const juce::SpinLock::ScopedLockType sl (slotLock);
+    return slots;
+}
+
+void ParameterMorph::setSlots (const Slots& newSlots)
+{
+    STARLIGHT_RT_NOTE_LOCK ("ParameterMorph::slotLock");
+    const juce::SpinLock::ScopedLockType sl (slotLock);
+    slots = newSlots;
+    slots.storedMask &= (1u << numSlots) - 1;
+    ++slotsVersion;
+}
+
+void ParameterMorph::apply (ParameterSnapshot& snapshot) noexcept
+{
+    if (const auto version = slotsVersion.load(); version != playingVersion)
+    {
+        const juce::SpinLock::ScopedTryLockType sl (slotLock);
+        if (sl.isLocked())
+        {
+            playing = slots;
+            playingVersion = version;
+
+            for (int s = 0; s < numSlots; ++s)
+                for (int i = 0; i < ParamIndex::count; ++i)
+                    normalised[(size_t) s][(size_t) i] = toNormalised (i, playing.params[(size_t) s].get (i));
+        }
+    }
+
+    if (playing.storedMask == 0)
+    {
+        discreteSlot = -1;
+        return;
+    }
+
+    const float x = juce::jlimit (0.0f, 1.0f, snapshot.get (ParamIndex::morph));
+    const float y = juce::jlimit (0.0f, 1.0f, snapshot.get (ParamIndex::morphY));
+    const std::array<float, numSlots> weights { (1.0f - x) * (1.0f - y), x * (1.0f - y), (1.0f - x) * y, x * y };
+
+    int nearest = 0;
+    for (int s = 1; s < numSlots; ++s)
+        if (weights[(size_t) s] > weights[(size_t) nearest])
+            nearest = s;
+
+    if (discreteSlot < 0 || weights[(size_t) nearest] > weights[(size_t) discreteSlot] + switchMargin)
+        discreteSlot = nearest;
+
+    for (int i = 0; i < ParamIndex::count; ++i)
+    {
+        if (! isMorphed (i) || snapshot.isLocked (i))
+            continue;
+
+        const float own = snapshot.get (i);
+
+        if (paramSpecs[i].kind != ParamSpec::Kind::continuous)
+        {
+            if (playing.isStored (discreteSlot))
+                snapshot.set (i, playing.params[(size_t) discreteSlot].get (i));
+
+            continue;
+        }
+
+        // exactly on a corner: that corner's values as stored
+        if (weights[(size_t) nearest] == 1.0f)
+        {
+            if (playing.isStored (nearest))
+                snapshot.set (i, playing.params[(size_t) nearest].get (i));
+
+            continue;
+        }
+
+        const float ownNormalised = toNormalised (i, own);
+        float blend = 0.0f;
+
+        for (int s = 0; s < numSlots; ++s)
+            blend += weights[(size_t) s] * (playing.isStored (s) ? normalised[(size_t) s][(size_t) i] : ownNormalised);
+
+        snapshot.set (i, fromNormalised (i, juce::jlimit (0.0f, 1.0f, blend)));
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include "Parameters.h"
+
+#include <array>
+#include <atomic>
+
+// Morphs every parameter between up to four stored snapshots, A to D, sitting at the
+// corners of a square: A bottom left, B bottom right, C top left, D top right. The Morph
+// parameter moves across it and Morph Y up it, so with only A and B stored the one Morph
+// parameter crossfades between them. A corner with nothing stored holds the parameters'
+// own settings, and with no corner stored at all nothing is morphed.
+//
+// Continuous parameters are blended bilinearly on their knobs' (skewed) scales, so a sweep
+// between 100 Hz and 10 kHz passes 1 kHz halfway. Toggles and choices can't be blended:
+// they all take the values of the nearest corner, and move to another corner's once it is
+// nearer by a margin, so automation resting halfway doesn't flip them back and forth.
+// Locked parameters, CPU Guard and the morph position itself are left alone.
+class ParameterMorph final
+{
+public:
+    static constexpr int numSlots = 4;
+    static constexpr float switchMargin = 0.05f; // in corner weight, 0..1
+
+    struct Slots
+    {
+        std::array<ParameterSnapshot, numSlots> params; // lock bits unused
+        juce::uint32 storedMask = 0;
+
+        bool isStored (int slot) const noexcept { return (storedMask & (1u << slot)) != 0; }
+        bool operator== (const Slots&) const noexcept;
+    };
+
+    static bool isMorphed (int paramIndex) noexcept;
+
+    // Any thread but the audio thread.
+    void storeSlot (int slot, const ParameterSnapshot& params);
+    void clearSlot (int slot);
+    Slots getSlots() const;
+    void setSlots (const Slots&);
+
+    // Audio thread, for each stretch of audio played with one set of parameters: the whole
+    // block, or each sub-block between parameter events, so Morph automation moves within a
+    // block too. Replaces the snapshot's morphed values with the blend at its own Morph and
+    // Morph Y position. Doesn't allocate or wait; changes to the slots are picked up on the
+    // first call that doesn't find them being written.
+    void apply (ParameterSnapshot& snapshot) noexcept;
+
+private:
+    // message side
+    Slots slots;
+    mutable juce::SpinLock slotLock;
+    std::atomic<juce::uint32> slotsVersion { 0 };
+
+    // audio side: the slots as normalised values, and the corner toggles and choices follow
+    Slots playing;
+    std::array<std::array<float, ParamIndex::count>, numSlots> normalised {};
+    juce::uint32 playingVersion = 0;
+    int discreteSlot = -1;
+};
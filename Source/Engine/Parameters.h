@@ -0,0 +1,173 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <array>
+
+namespace ParamIDs
+{
+    static constexpr auto inputGain = "inputGain";
+    static constexpr auto delayTimeMs = "delayTimeMs";
+    static constexpr auto feedback = "feedback";
+    static constexpr auto grainSizeMs = "grainSizeMs";
+    static constexpr auto density = "density";
+    static constexpr auto jitter = "jitter";
+    static constexpr auto pitchSemi = "pitchSemi";
+    static constexpr auto spread = "spread";
+
+    static constexpr auto reverbSize = "reverbSize";
+    static constexpr auto preDelayMs = "preDelayMs";
+    static constexpr auto tone = "tone";
+    static constexpr auto shimmerAmt = "shimmerAmt";
+    static constexpr auto shimmerPitch = "shimmerPitch";
+    static constexpr auto reverbMix = "reverbMix";
+
+    static constexpr auto mix = "mix";
+    static constexpr auto outputGain = "outputGain";
+    static constexpr auto hpEnable = "hpEnable";
+    static constexpr auto hpFreq = "hpFreq";
+    static constexpr auto lpEnable = "lpEnable";
+    static constexpr auto lpFreq = "lpFreq";
+
+    static constexpr auto drift = "drift";
+    static constexpr auto modRate = "modRate";
+    static constexpr auto modDepth = "modDepth";
+    static constexpr auto freeze = "freeze";
+
+    static constexpr auto air = "air";
+    static constexpr auto glass = "glass";
+
+    static constexpr auto cloudDensity = "cloudDensity";
+
+    static constexpr auto cpuGuard = "cpuGuard";
+
+    static constexpr auto memory = "memory";
+
+    static constexpr auto morph = "morph";
+    static constexpr auto morphY = "morphY";
+
+    static constexpr auto early = "early";
+}
+
+// Order of the parameter table below (and of the plugin's parameters); doubles as
+// the bit index in lock masks.
+namespace ParamIndex
+{
+    enum : int
+    {
+        inputGain, delayTimeMs, feedback, grainSizeMs, density, jitter, pitchSemi, spread,
+        reverbSize, preDelayMs, tone, shimmerAmt, shimmerPitch, reverbMix,
+        mix, outputGain, hpEnable, hpFreq, lpEnable, lpFreq,
+        drift, modRate, modDepth, freeze,
+        air, glass,
+        cloudDensity,
+        cpuGuard,
+        memory,
+        morph, morphY,
+        early,
+        count
+    };
+
+    static_assert (count <= 32, "lock masks are 32 bits wide");
+}
+
+struct ParamSpec
+{
+    enum class Kind { continuous, toggle, choice };
+
+    const char* id;
+    const char* name;
+    Kind kind;
+    float minValue;
+    float maxValue;
+    float step;
+    float skew;
+    float defaultValue;
+    const char* choices = nullptr; // comma-separated, for Kind::choice
+};
+
+static constexpr ParamSpec paramSpecs[ParamIndex::count] =
+{
+    { ParamIDs::inputGain,    "Input",         ParamSpec::Kind::continuous, -24.0f,   24.0f,    0.01f,   1.0f,  0.0f },
+    { ParamIDs::delayTimeMs,  "Time",          ParamSpec::Kind::continuous,   1.0f, 2000.0f,    0.01f,   0.35f, 450.0f },
+    { ParamIDs::feedback,     "Feedback",      ParamSpec::Kind::continuous,   0.0f,    0.95f,   0.0001f, 1.0f,  0.35f },
+    { ParamIDs::grainSizeMs,  "Size",          ParamSpec::Kind::continuous,  10.0f,  250.0f,    0.01f,   0.5f,  70.0f },
+    { ParamIDs::density,      "Density",       ParamSpec::Kind::continuous,   0.2f,   40.0f,    0.01f,   0.5f,  40.0f },
+    { ParamIDs::jitter,       "Jitter",        ParamSpec::Kind::continuous,   0.0f,    1.0f,    0.0001f, 1.0f,  0.15f },
+    { ParamIDs::pitchSemi,    "Pitch",         ParamSpec::Kind::continuous, -12.0f,   12.0f,    0.01f,   1.0f,  0.0f },
+    { ParamIDs::spread,       "Spread",        ParamSpec::Kind::continuous,   0.0f,    1.0f,    0.0001f, 1.0f,  0.35f },
+
+    { ParamIDs::reverbSize,   "Reverb Size",   ParamSpec::Kind::continuous,   0.0f,    1.0f,    0.0001f, 1.0f,  0.55f },
+    { ParamIDs::preDelayMs,   "PreDelay",      ParamSpec::Kind::continuous,   0.0f,  250.0f,    0.01f,   0.5f,  20.0f },
+    { ParamIDs::tone,         "Tone",          ParamSpec::Kind::continuous,   0.0f,    1.0f,    0.0001f, 1.0f,  0.55f },
+    { ParamIDs::shimmerAmt,   "Shimmer",       ParamSpec::Kind::continuous,   0.0f,    1.0f,    0.0001f, 1.0f,  0.25f },
+    { ParamIDs::shimmerPitch, "Shimmer Pitch", ParamSpec::Kind::choice,       0.0f,    3.0f,    1.0f,    1.0f,  2.0f, "+5,+7,+12,+24" },
+    { ParamIDs::reverbMix,    "Reverb Mix",    ParamSpec::Kind::continuous,   0.0f,    1.0f,    0.0001f, 1.0f,  1.0f },
+
+    { ParamIDs::mix,          "Mix",           ParamSpec::Kind::continuous,   0.0f,    1.0f,    0.0001f, 1.0f,  1.0f },
+    { ParamIDs::outputGain,   "Output",        ParamSpec::Kind::continuous, -24.0f,   24.0f,    0.01f,   1.0f,  0.0f },
+    { ParamIDs::hpEnable,     "HP Enable",     ParamSpec::Kind::toggle,       0.0f,    1.0f,    1.0f,    1.0f,  0.0f },
+    { ParamIDs::hpFreq,       "HP Freq",       ParamSpec::Kind::continuous,  20.0f, 20000.0f,   0.01f,   0.5f,  120.0f },
+    { ParamIDs::lpEnable,     "LP Enable",     ParamSpec::Kind::toggle,       0.0f,    1.0f,    1.0f,    1.0f,  0.0f },
+    { ParamIDs::lpFreq,       "LP Freq",       ParamSpec::Kind::continuous,  20.0f, 20000.0f,   0.01f,   0.5f,  14000.0f },
+
+    { ParamIDs::drift,        "Drift",         ParamSpec::Kind::continuous,   0.0f,    1.0f,    0.0001f, 1.0f,  0.25f },
+    { ParamIDs::modRate,      "Mod Rate",      ParamSpec::Kind::continuous,   0.01f,   4.0f,    0.0001f, 0.5f,  0.35f },
+    { ParamIDs::modDepth,     "Mod Depth",     ParamSpec::Kind::continuous,   0.0f,    1.0f,    0.0001f, 1.0f,  0.25f },
+    { ParamIDs::freeze,       "Freeze",        ParamSpec::Kind::toggle,       0.0f,    1.0f,    1.0f,    1.0f,  0.0f },
+
+    { ParamIDs::air,          "Air",           ParamSpec::Kind::continuous,   0.0f,    1.0f,    0.0001f, 1.0f,  0.0f },
+    { ParamIDs::glass,        "Glass",         ParamSpec::Kind::continuous,   0.0f,    1.0f,    0.0001f, 1.0f,  0.0f },
+
+    { ParamIDs::cloudDensity, "Cloud",         ParamSpec::Kind::continuous,   0.0f, 5000.0f,    0.1f,    0.3f,  0.0f },
+
+    // Off: always full quality. Auto: the CPU governor degrades as needed. Level n: at least n.
+    { ParamIDs::cpuGuard,     "CPU Guard",     ParamSpec::Kind::choice,       0.0f,    5.0f,    1.0f,    1.0f,  1.0f, "Off,Auto,Level 1,Level 2,Level 3,Level 4" },
+
+    // Share of the long memory grains scatter across; does nothing while the memory is off.
+    { ParamIDs::memory,       "Memory",        ParamSpec::Kind::continuous,   0.0f,    1.0f,    0.0001f, 1.0f,  0.0f },
+
+    // Position between the morph snapshots (see ParameterMorph): left to right, and for the XY pad bottom to top.
+    { ParamIDs::morph,        "Morph",         ParamSpec::Kind::continuous,   0.0f,    1.0f,    0.0001f, 1.0f,  0.0f },
+    { ParamIDs::morphY,       "Morph Y",       ParamSpec::Kind::continuous,   0.0f,    1.0f,    0.0001f, 1.0f,  0.0f },
+
+    // Level of the early reflections between the pre-delay and the reverb; 0 turns them off.
+    { ParamIDs::early,        "Early",         ParamSpec::Kind::continuous,   0.0f,    1.0f,    0.0001f, 1.0f,  0.0f },
+};
+
+// Plain (unnormalised) values of every parameter plus the lock bits, i.e. everything
+// the engine needs to know about the current settings.
+struct ParameterSnapshot
+{
+    ParameterSnapshot()
+    {
+        for (int i = 0; i < ParamIndex::count; ++i)
+            values[(size_t) i] = paramSpecs[i].defaultValue;
+    }
+
+    float get (int index) const noexcept { return values[(size_t) index]; }
+    void set (int index, float value) noexcept { values[(size_t) index] = value; }
+
+    bool getBool (int index) const noexcept { return get (index) > 0.5f; }
+    bool isLocked (int index) const noexcept { return (lockMask & (1u << index)) != 0; }
+
+    static int indexOf (const juce::String& paramId)
+    {
+        for (int i = 0; i < ParamIndex::count; ++i)
+            if (paramId == paramSpecs[i].id)
+                return i;
+
+        return -1;
+    }
+
+    std::array<float, ParamIndex::count> values {};
+    juce::uint32 lockMask = 0;
+};
+
+// A parameter moving to a new plain value partway through a block.
+struct ParameterEvent
+{
+    int sampleOffset = 0;
+    int index = 0; // ParamIndex
+    float value = 0.0f;
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <atomic>
+#include <cmath>
+
+// Watches how long each block takes against its real-time deadline
+// (numSamples / sampleRate) and picks how much of the signal chain's work to shed,
+// from 0 (full quality) to maxLevel. The engine maps levels to cheaper settings:
+//
+//     1  cap the grain voices (core grains and the cloud)
+//     2  nearest-sample instead of interpolated delay reads
+//     3  mono reverb and shimmer pitch shifter
+//     4  drift modulation at a lower control rate
+//
+// It steps up one level as soon as a block overruns its deadline or the smoothed
+// load passes escalateLoad, then holds for a while so the lower cost can show up in
+// the measurement. It only steps back down after the load has stayed under
+// recoverLoad for recoverSeconds, so it doesn't flip between two levels that sit
+// either side of the threshold.
+class QualityGovernor final
+{
+public:
+    static constexpr int maxLevel = 4;
+
+    static constexpr double escalateLoad = 0.7;
+    static constexpr double recoverLoad = 0.35;
+    static constexpr double smoothingSeconds = 0.1;
+    static constexpr double holdSeconds = 0.25;
+    static constexpr double recoverSeconds = 2.0;
+
+    // Message thread, before prepare(). Off by default, i.e. only the minimum level applies;
+    // offline renders leave it off so their output doesn't depend on the machine.
+    void setEnabled (bool shouldAdapt) { enabled = shouldAdapt; }
+    bool isEnabled() const noexcept { return enabled; }
+
+    void prepare (double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        smoothedLoad = 0.0;
+        holdRemaining = 0;
+        calmSamples = 0;
+        governedLevel = 0;
+        level.store (minimumLevel, std::memory_order_relaxed);
+    }
+
+    // Audio thread. adaptive = false pins the level to minimumLevel.
+    void setRange (bool shouldBeAdaptive, int newMinimumLevel) noexcept
+    {
+        adaptive = shouldBeAdaptive;
+        minimumLevel = juce::jlimit (0, maxLevel, newMinimumLevel);
+
+        if (! isAdapting())
+            governedLevel = 0;
+
+        publish();
+    }
+
+    // Audio thread, after every block, with the wall-clock time the block took.
+    void update (juce::int64 elapsedTicks, int numSamples) noexcept
+    {
+        if (! isAdapting() || numSamples <= 0 || sampleRate <= 0.0)
+            return;
+
+        const double deadline = numSamples / sampleRate;
+        const double load = juce::Time::highResolutionTicksToSeconds (elapsedTicks) / deadline;
+
+        smoothedLoad += (1.0 - std::exp (-deadline / smoothingSeconds)) * (load - smoothedLoad);
+        holdRemaining = juce::jmax ((juce::int64) 0, holdRemaining - numSamples);
+
+        if (holdRemaining > 0)
+            return;
+
+        // levels below the minimum are in force anyway, so count from there
+        const int current = juce::jmax (minimumLevel, governedLevel);
+
+        if ((load > 1.0 || smoothedLoad > escalateLoad) && current < maxLevel)
+        {
+            governedLevel = current + 1;
+            holdRemaining = (juce::int64) (holdSeconds * sampleRate);
+            calmSamples = 0;
+        }
+        else if (smoothedLoad < recoverLoad && governedLevel > minimumLevel)
+        {
+            calmSamples += numSamples;
+
+            if (calmSamples >= (juce::int64) (recoverSeconds * sampleRate))
+            {
+                --governedLevel;
+                holdRemaining = (juce::int64) (holdSeconds * sampleRate);
+                calmSamples = 0;
+            }
+        }
+        else
+        {
+            calmSamples = 0;
+        }
+
+        publish();
+    }
+
+    // Any thread.
+    int getLevel() const noexcept { return level.load (std::memory_order_relaxed); }
+
+private:
+    bool isAdapting() const noexcept { return enabled && adaptive; }
+
+    void publish() noexcept
+    {
+        level.store (juce::jmax (minimumLevel, governedLevel), std::memory_order_relaxed);
+    }
+
+    double sampleRate = 48000.0;
+    bool enabled = false;
+    bool adaptive = true;
+    int minimumLevel = 0;
+
+    double smoothedLoad = 0.0;
+    juce::int64 holdRemaining = 0;
+    juce::int64 calmSamples = 0;
+    int governedLevel = 0;
+
+    std::atomic<int> level { 0 };
+};
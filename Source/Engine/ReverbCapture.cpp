@@ -0,0 +1,405 @@
+#include "ReverbCapture.h"
+
+#include <algorithm>
+#include <limits>
+
+// Renders requested captures off the audio thread and deletes the ones it's done with.
+// Polls rather than waits on an event, so the audio thread never has to signal it; a
+// few tens of milliseconds matter little next to settleSeconds.
+class ReverbCapture::Renderer final : public juce::Thread
+{
+public:
+    explicit Renderer (ReverbCapture& c) : juce::Thread ("Starlight reverb capture"), owner (c)
+    {
+        startThread (juce::Thread::Priority::low);
+    }
+
+    ~Renderer() override { stopThread (4000); }
+
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            delete owner.retired.exchange (nullptr);
+
+            if (const auto version = owner.requestVersion.load(); version != renderedVersion)
+            {
+                Settings settings;
+                {
+                    const juce::SpinLock::ScopedLockType sl (owner.requestLock);
+                    settings = owner.request;
+                }
+
+                renderedVersion = version;
+
+                if (auto capture = render (settings, version))
+                    pending = std::move (capture);
+            }
+
+            // the audio thread takes one at a time and throws it back if it's out of date
+            if (pending != nullptr)
+            {
+                Capture* expected = nullptr;
+                if (owner.ready.compare_exchange_strong (expected, pending.get()))
+                    pending.release();
+            }
+
+            wait (20);
+        }
+
+        pending.reset();
+    }
+
+private:
+    bool superseded (juce::uint32 version) const
+    {
+        return threadShouldExit() || owner.requestVersion.load() != version;
+    }
+
+    std::unique_ptr<Capture> render (const Settings& settings, juce::uint32 version)
+    {
+        const bool needsMono = std::find (owner.layout.begin(), owner.layout.end(), 1) != owner.layout.end();
+        const bool needsStereo = std::find (owner.layout.begin(), owner.layout.end(), 2) != owner.layout.end();
+
+        int length = 1;
+        std::array<juce::AudioBuffer<float>, 2> mono, stereo;
+
+        const auto stop = [this, version] { return superseded (version); };
+
+        if ((needsMono && ! renderResponses (settings.params, settings.stereo, owner.sampleRate, owner.format, 1, mono, length, stop))
+            || (needsStereo && ! renderResponses (settings.params, settings.stereo, owner.sampleRate, owner.format, 2, stereo, length, stop)))
+            return nullptr;
+
+        auto capture = std::make_unique<Capture>();
+        capture->settings = settings;
+        capture->length = length;
+
+        for (const int numChannels : owner.layout)
+        {
+            auto& engines = capture->groups.emplace_back();
+            const auto& responses = numChannels > 1 ? stereo : mono;
+
+            for (int c = 0; c < numChannels; ++c)
+            {
+                juce::AudioBuffer<float> ir (numChannels, length);
+                for (int ch = 0; ch < numChannels; ++ch)
+                    ir.copyFrom (ch, 0, responses[(size_t) c], ch, 0, length);
+
+                // loaded before prepare(), the response is in place when prepare() returns
+                auto convolution = std::make_unique<juce::dsp::Convolution> (juce::dsp::Convolution::NonUniform { 512 }, owner.queue);
+                convolution->loadImpulseResponse (std::move (ir), owner.sampleRate,
+                                                  numChannels > 1 ? juce::dsp::Convolution::Stereo::yes : juce::dsp::Convolution::Stereo::no,
+                                                  juce::dsp::Convolution::Trim::no, juce::dsp::Convolution::Normalise::no);
+                convolution->prepare ({ owner.sampleRate, (juce::uint32) owner.maximumBlockSize, (juce::uint32) numChannels });
+
+                if (convolution->getCurrentIRSize() != length)
+                    return nullptr;
+
+                engines[(size_t) c] = std::move (convolution);
+            }
+        }
+
+        return capture;
+    }
+
+    ReverbCapture& owner;
+    juce::uint32 renderedVersion = 0;
+    std::unique_ptr<Capture> pending;
+
+    JUCE_DECLARE_NON_COPYABLE (Renderer)
+};
+
+bool ReverbCapture::Settings::operator== (const Settings& other) const noexcept
+{
+    const auto& a = params;
+    const auto& b = other.params;
+
+    return a.roomSize == b.roomSize && a.preDelayMs == b.preDelayMs && a.tone == b.tone
+           && a.shimmerAmount == b.shimmerAmount && a.pitchSemitones == b.pitchSemitones
+           && a.reverbMix == b.reverbMix && a.earlyLevel == b.earlyLevel && a.freeze == b.freeze
+           && stereo == other.stereo;
+}
+
+bool ReverbCapture::renderResponses (const ShimmerReverb::Params& params, bool stereoQuality, double sampleRate,
+                                     DelayBuffer::Format format, int numChannels,
+                                     std::array<juce::AudioBuffer<float>, 2>& responses, int& length,
+                                     const std::function<bool()>& shouldStop)
+{
+    constexpr int blockSize = 512;
+    constexpr float silence = 1.0e-5f; // -100 dB
+    const int maxLength = (int) (maxImpulseSeconds * sampleRate);
+    const int quietLength = (int) (0.5 * sampleRate); // this much below `silence` and the tail is over
+
+    for (int c = 0; c < numChannels; ++c)
+    {
+        ShimmerReverb reverb;
+        reverb.setStorageFormat (format);
+        reverb.prepare ({ sampleRate, (juce::uint32) blockSize, (juce::uint32) numChannels });
+
+        ShimmerReverb::Quality quality;
+        quality.stereo = stereoQuality;
+        reverb.setQuality (quality);
+        reverb.setParams (params);
+
+        // juce::Reverb glides to its settings over 10 ms; let it get there on silence first
+        {
+            juce::AudioBuffer<float> preRoll (numChannels, blockSize);
+
+            for (int pos = 0; pos < (int) (0.05 * sampleRate); pos += blockSize)
+            {
+                preRoll.clear();
+                reverb.process (preRoll);
+            }
+        }
+
+        auto& response = responses[(size_t) c];
+        response.setSize (numChannels, maxLength);
+        response.clear();
+        response.setSample (c, 0, 1.0f);
+
+        int lastAudible = 0;
+
+        for (int pos = 0; pos < maxLength && pos - lastAudible < quietLength; pos += blockSize)
+        {
+            if (shouldStop != nullptr && shouldStop())
+                return false;
+
+            const int n = juce::jmin (blockSize, maxLength - pos);
+            juce::AudioBuffer<float> block (response.getArrayOfWritePointers(), numChannels, pos, n);
+            reverb.process (block);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+                for (int i = 0; i < n; ++i)
+                    if (std::abs (block.getSample (ch, i)) > silence)
+                        lastAudible = pos + i;
+        }
+
+        if (maxLength - lastAudible < quietLength)
+            return false;
+
+        length = juce::jmax (length, lastAudible + 1);
+    }
+
+    return true;
+}
+
+ReverbCapture::ReverbCapture() = default;
+
+ReverbCapture::~ReverbCapture()
+{
+    renderer.reset();
+    delete ready.exchange (nullptr);
+    delete retired.exchange (nullptr);
+}
+
+void ReverbCapture::prepare (double newSampleRate, int newMaximumBlockSize, const std::vector<int>& groupChannels,
+                             DelayBuffer::Format storageFormat, bool shouldCapture)
+{
+    renderer.reset();
+    delete ready.exchange (nullptr);
+    delete retired.exchange (nullptr);
+    active.reset();
+    previous.reset();
+    stale.reset();
+    convolving = false;
+
+    enabled = shouldCapture;
+    sampleRate = newSampleRate;
+    maximumBlockSize = juce::jmax (1, newMaximumBlockSize);
+    layout = groupChannels;
+    format = storageFormat;
+
+    current = {};
+    stillSamples = 0;
+    requested = false;
+
+    states.clear();
+    states.resize (enabled ? layout.size() : 0);
+
+    for (size_t g = 0; g < states.size(); ++g)
+    {
+        const int numChannels = layout[g];
+        states[g].input.setSize (numChannels, maximumBlockSize);
+        states[g].side.setSize (numChannels, maximumBlockSize);
+        states[g].tail.setSize (numChannels, maximumBlockSize);
+    }
+
+    if (enabled)
+        renderer = std::make_unique<Renderer> (*this);
+}
+
+void ReverbCapture::retire (std::unique_ptr<Capture>& capture) noexcept
+{
+    Capture* expected = nullptr;
+    if (capture != nullptr && retired.compare_exchange_strong (expected, capture.get()))
+        capture.release();
+}
+
+void ReverbCapture::update (const ShimmerReverb::Params& params, const ShimmerReverb::Quality& quality, bool isStatic, int numSamples) noexcept
+{
+    if (! enabled)
+        return;
+
+    Settings settings;
+    settings.params = params;
+    settings.stereo = quality.stereo;
+
+    if (settings != current)
+    {
+        current = settings;
+        stillSamples = 0;
+        requested = false;
+    }
+    else
+    {
+        stillSamples = juce::jmin (stillSamples + numSamples, std::numeric_limits<int>::max() / 2);
+    }
+
+    // anything moving hands back to the reverb at once
+    if (active != nullptr && (! isStatic || active->settings != current))
+    {
+        for (auto& s : states)
+        {
+            s.convolutionTail = active->length;
+            s.reverbTail = 0;
+        }
+
+        previous = std::move (active);
+        convolving = false;
+    }
+
+    if (previous != nullptr && std::all_of (states.begin(), states.end(), [] (const GroupState& s) { return s.convolutionTail <= 0; }))
+        retire (previous);
+
+    retire (stale);
+
+    if (active == nullptr && isStatic && ! requested && stillSamples >= (int) (settleSeconds * sampleRate))
+    {
+        const juce::SpinLock::ScopedTryLockType sl (requestLock);
+        if (sl.isLocked())
+        {
+            request = current;
+            ++requestVersion;
+            requested = true;
+        }
+    }
+
+    // a finished capture: taken if it's for these settings and the last one has played out
+    if (active == nullptr && previous == nullptr && stale == nullptr && isStatic)
+    {
+        if (auto* c = ready.exchange (nullptr))
+        {
+            std::unique_ptr<Capture> capture (c);
+
+            if (capture->settings == current && capture->groups.size() == states.size())
+            {
+                for (auto& s : states)
+                {
+                    s.reverbTail = capture->length;
+                    s.convolutionTail = 0;
+                }
+
+                active = std::move (capture);
+                convolving = true;
+            }
+            else
+            {
+                stale = std::move (capture);
+                retire (stale);
+            }
+        }
+    }
+}
+
+void ReverbCapture::convolve (Capture& capture, int group, const juce::AudioBuffer<float>& in, juce::AudioBuffer<float>& out,
+                              int numChannels, int numSamples) noexcept
+{
+    auto& engines = capture.groups[(size_t) group];
+    auto& side = states[(size_t) group].side;
+
+    for (int c = 0; c < numChannels; ++c)
+    {
+        // input channel c into every output channel
+        juce::AudioBuffer<float> view (side.getArrayOfWritePointers(), numChannels, numSamples);
+        for (int ch = 0; ch < numChannels; ++ch)
+            view.copyFrom (ch, 0, in, c, 0, numSamples);
+
+        juce::dsp::AudioBlock<float> block (view);
+        engines[(size_t) c]->process (juce::dsp::ProcessContextReplacing<float> (block));
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            if (c == 0)
+                out.copyFrom (ch, 0, view, ch, 0, numSamples);
+            else
+                out.addFrom (ch, 0, view, ch, 0, numSamples);
+        }
+    }
+}
+
+void ReverbCapture::process (int group, ShimmerReverb& reverb, juce::AudioBuffer<float>& wet) noexcept
+{
+    auto* state = juce::isPositiveAndBelow (group, (int) states.size()) ? &states[(size_t) group] : nullptr;
+
+    if (state == nullptr || (active == nullptr && (previous == nullptr || state->convolutionTail <= 0)))
+    {
+        reverb.process (wet);
+        return;
+    }
+
+    const int numChannels = wet.getNumChannels();
+    const int numSamples = wet.getNumSamples();
+    juce::AudioBuffer<float> input (state->input.getArrayOfWritePointers(), numChannels, numSamples);
+    juce::AudioBuffer<float> tail (state->tail.getArrayOfWritePointers(), numChannels, numSamples);
+
+    if (active != nullptr)
+    {
+        for (int ch = 0; ch < numChannels; ++ch)
+            input.copyFrom (ch, 0, wet, ch, 0, numSamples);
+
+        convolve (*active, group, input, wet, numChannels, numSamples);
+
+        if (state->reverbTail > 0)
+        {
+            tail.clear();
+            reverb.process (tail);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+                wet.addFrom (ch, 0, tail, ch, 0, numSamples);
+
+            state->reverbTail -= numSamples;
+        }
+    }
+    else
+    {
+        reverb.process (wet);
+
+        input.clear();
+        convolve (*previous, group, input, tail, numChannels, numSamples);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+            wet.addFrom (ch, 0, tail, ch, 0, numSamples);
+
+        state->convolutionTail -= numSamples;
+    }
+}
+
+int ReverbCapture::getTailSamples() const noexcept
+{
+    int longest = 0;
+
+    for (const auto& s : states)
+        longest = juce::jmax (longest, active != nullptr ? s.reverbTail : previous != nullptr ? s.convolutionTail : 0);
+
+    return longest;
+}
+
+size_t ReverbCapture::getMemoryBytes() const noexcept
+{
+    size_t bytes = 0;
+
+    for (const auto& s : states)
+        bytes += (size_t) (3 * s.input.getNumChannels() * s.input.getNumSamples()) * sizeof (float);
+
+    return bytes;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+
+#include "../DSP/ShimmerReverb.h"
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Swaps the reverb for a convolution with its own impulse response while its settings hold
+// still. Once they haven't moved for settleSeconds (and nothing makes the reverb
+// time-varying: Freeze, or a shimmer, whose pitch shifter isn't), a background thread
+// renders a fresh ShimmerReverb's response to an impulse in each channel and loads it into
+// juce::dsp::Convolution engines, non-uniformly partitioned. When they're ready the groups
+// hand over to them, and as soon as a setting changes they hand back.
+//
+// Both systems are linear, so a handover needs no crossfade: from the switch on, the new one
+// takes the input while the old one plays out the tail of what it was given, fed silence,
+// for as long as the impulse response lasts. The sum is what either would have played alone.
+class ReverbCapture final
+{
+public:
+    static constexpr double settleSeconds = 0.5;
+    static constexpr double maxImpulseSeconds = 8.0; // longer responses aren't captured: those rooms keep the reverb
+
+    ReverbCapture();
+    ~ReverbCapture();
+
+    // Not for the audio thread: sizes the handover buffers for groups of 1 or 2 channels
+    // and drops any capture. Disabled, process() is plain ShimmerReverb::process().
+    void prepare (double sampleRate, int maximumBlockSize, const std::vector<int>& groupChannels,
+                  DelayBuffer::Format storageFormat, bool enabled);
+
+    // Audio thread, once a block before the groups run: the block's reverb settings and
+    // whether the reverb is a fixed linear system with them (the engine knows about freeze
+    // refills). Starts a capture once they've settled, and decides whether the groups play
+    // the reverb or the convolution.
+    void update (const ShimmerReverb::Params&, const ShimmerReverb::Quality&, bool isStatic, int numSamples) noexcept;
+
+    // Audio thread, the group's own: runs one group's wet signal through whichever of the
+    // reverb and the convolution is in use, and the other one's tail.
+    void process (int group, ShimmerReverb& reverb, juce::AudioBuffer<float>& wet) noexcept;
+
+    // Any thread: whether the groups are playing a captured response.
+    bool isConvolving() const noexcept { return convolving.load (std::memory_order_relaxed); }
+
+    // Audio thread, after the groups have run: how much longer the reverb or convolution
+    // handed over from plays out, the longest of the groups'; 0 once it has.
+    int getTailSamples() const noexcept;
+
+    // The handover buffers; captures come and go with the settings, so they aren't counted.
+    size_t getMemoryBytes() const noexcept;
+
+    // Not for the audio thread: what a capture is made from. Channel c of `responses` is a
+    // fresh ShimmerReverb's response to an impulse in input channel c, numChannels channels
+    // long, and `length` is raised to cover it. False if shouldStop() says so meanwhile, or
+    // if the response hasn't died away within maxImpulseSeconds: with no crossfade at the
+    // handover a cut-off tail would be heard, so such rooms stay with the reverb.
+    static bool renderResponses (const ShimmerReverb::Params&, bool stereoQuality, double sampleRate,
+                                 DelayBuffer::Format, int numChannels,
+                                 std::array<juce::AudioBuffer<float>, 2>& responses, int& length,
+                                 const std::function<bool()>& shouldStop = nullptr);
+
+private:
+    class Renderer;
+
+    // Everything the reverb's response depends on.
+    struct Settings
+    {
+        ShimmerReverb::Params params;
+        bool stereo = true; // the reverb's stereo quality
+
+        bool operator== (const Settings&) const noexcept;
+        bool operator!= (const Settings& other) const noexcept { return ! operator== (other); }
+    };
+
+    // A response loaded into an engine per group, and per input channel of the group: each
+    // convolves one input channel into every output channel.
+    struct Capture
+    {
+        Settings settings;
+        int length = 0; // samples
+        std::vector<std::array<std::unique_ptr<juce::dsp::Convolution>, 2>> groups;
+    };
+
+    struct GroupState
+    {
+        juce::AudioBuffer<float> input, side, tail;
+        int reverbTail = 0;      // samples the reverb still plays out, fed silence
+        int convolutionTail = 0; // same for the convolution we handed back from
+    };
+
+    // Hands a capture to the renderer to delete, if it has room for one; otherwise it stays put.
+    void retire (std::unique_ptr<Capture>&) noexcept;
+    void convolve (Capture&, int group, const juce::AudioBuffer<float>& in, juce::AudioBuffer<float>& out, int numChannels, int numSamples) noexcept;
+
+    bool enabled = false;
+    double sampleRate = 48000.0;
+    int maximumBlockSize = 512;
+    std::vector<int> layout;
+    DelayBuffer::Format format = DelayBuffer::Format::float32;
+
+    // audio side
+    Settings current;
+    int stillSamples = 0;
+    bool requested = false;
+    std::unique_ptr<Capture> active, previous; // previous: playing out its tail
+    std::unique_ptr<Capture> stale;            // finished for settings that have since moved on
+    std::vector<GroupState> states;
+    std::atomic<bool> convolving { false };
+
+    // handover with the renderer
+    juce::SpinLock requestLock;
+    Settings request;
+    std::atomic<juce::uint32> requestVersion { 0 };
+    std::atomic<Capture*> ready { nullptr }, retired { nullptr };
+
+    juce::dsp::ConvolutionMessageQueue queue;
+    std::unique_ptr<Renderer> renderer;
+};
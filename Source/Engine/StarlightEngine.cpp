@@ -0,0 +1,890 @@
+#include "StarlightEngine.h"
+
+#include "../Diagnostics/RealtimeSafety.h"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+static float dbToLin (float db) { return juce::Decibels::decibelsToGain (db); }
+
+// The delay lines are sized for these ranges.
+static_assert (paramSpecs[ParamIndex::delayTimeMs].maxValue <= GranularDelay::maxDelayTimeMs);
+static_assert (paramSpecs[ParamIndex::grainSizeMs].maxValue <= GranularDelay::maxGrainSizeMs);
+static_assert (paramSpecs[ParamIndex::jitter].maxValue <= GranularDelay::maxJitter);
+static_assert (paramSpecs[ParamIndex::cloudDensity].maxValue <= GranularDelay::maxCloudDensity);
+static_assert (paramSpecs[ParamIndex::pitchSemi].maxValue + 2.0f <= 14.0f, "GranularDelay::maxReadIncrement allows +14 semitones");
+static_assert (paramSpecs[ParamIndex::preDelayMs].maxValue <= ShimmerReverb::maxPreDelayMs);
+
+// Group g's channels in a segment buffer (2g, and 2g + 1 for a pair), as a buffer of its
+// own (no allocation).
+static juce::AudioBuffer<float> groupChannels (juce::AudioBuffer<float>& buffer, int group, int numChannels, int numSamples)
+{
+    return juce::AudioBuffer<float> (buffer.getArrayOfWritePointers() + 2 * group, numChannels, numSamples);
+}
+
+// What each CPU governor level gives up; see QualityGovernor.
+static GranularDelay::Quality granularQuality (int level)
+{
+    GranularDelay::Quality q;
+
+    if (level >= 1)
+    {
+        q.maxVoices = 12;
+        q.maxCloudGrains = 512;
+    }
+
+    q.interpolate = level < 2;
+    q.controlInterval = level >= 4 ? 16 : 1;
+    return q;
+}
+
+static ShimmerReverb::Quality reverbQuality (int level)
+{
+    ShimmerReverb::Quality q;
+    q.interpolate = level < 2;
+    q.stereo = level < 3;
+    return q;
+}
+
+// Runs the granular stage of one segment at a time for the pipelined (offline) path.
+// Waiting here is fine: the pipeline is never used in real time.
+class StarlightEngine::PipelineThread final : public juce::Thread
+{
+public:
+    explicit PipelineThread (StarlightEngine& e) : juce::Thread ("Starlight pipeline"), engine (e)
+    {
+        startThread (juce::Thread::Priority::high);
+    }
+
+    ~PipelineThread() override
+    {
+        signalThreadShouldExit();
+        startEvent.signal();
+        stopThread (2000);
+    }
+
+    void start (Segment& s)
+    {
+        segment = &s;
+        startEvent.signal();
+    }
+
+    void waitUntilDone()
+    {
+        doneEvent.wait();
+    }
+
+    void run() override
+    {
+        for (;;)
+        {
+            startEvent.wait();
+
+            if (threadShouldExit())
+                return;
+
+            {
+                STARLIGHT_RT_AUDIO_THREAD_SCOPE;
+                engine.processGranularStage (*segment);
+            }
+
+            doneEvent.signal();
+        }
+    }
+
+private:
+    StarlightEngine& engine;
+    Segment* segment = nullptr;
+    juce::WaitableEvent startEvent, doneEvent;
+};
+
+// Hands the channel groups of one segment out to whoever asks first: the group pool's
+// workers and the calling thread. A late wake-up finds nothing left to claim.
+class StarlightEngine::GroupTask final : public RealtimeWorkerPool::Task
+{
+public:
+    explicit GroupTask (StarlightEngine& e) : engine (e) {}
+
+    // Only while nobody can claim a group, i.e. between segments. outputOnly: the granular
+    // stage has already run (the pipelined path).
+    void start (Segment& s, bool outputOnly) noexcept
+    {
+        segment = &s;
+        outputStageOnly = outputOnly;
+        done.store (0, std::memory_order_relaxed);
+        next.store (0, std::memory_order_release);
+    }
+
+    void run (int) noexcept override
+    {
+        const int numGroups = (int) engine.groups.size();
+
+        for (int g = next.fetch_add (1, std::memory_order_acquire); g < numGroups; g = next.fetch_add (1, std::memory_order_acquire))
+        {
+            if (! outputStageOnly)
+                engine.processGroupGranular (*segment, g);
+
+            engine.processGroupOutput (*segment, g);
+            done.fetch_add (1, std::memory_order_release);
+        }
+    }
+
+    bool isDone() const noexcept { return done.load (std::memory_order_acquire) == (int) engine.groups.size(); }
+
+private:
+    StarlightEngine& engine;
+    Segment* segment = nullptr;
+    bool outputStageOnly = false;
+    std::atomic<int> next { std::numeric_limits<int>::max() / 2 };
+    std::atomic<int> done { 0 };
+};
+
+StarlightEngine::StarlightEngine() : groupTask (std::make_unique<GroupTask> (*this)) {}
+
+StarlightEngine::~StarlightEngine()
+{
+    // workers woken late may still touch the task
+    groupPool.stop();
+}
+
+void StarlightEngine::prepare (double newSampleRate, int newMaximumBlockSize, int newNumChannels)
+{
+    std::vector<ChannelGroup> pairs;
+    for (int ch = 0; ch < newNumChannels; ch += 2)
+        pairs.push_back ({ ch, ch + 1 < newNumChannels ? ch + 1 : -1 });
+
+    prepare (newSampleRate, newMaximumBlockSize, newNumChannels, pairs);
+}
+
+void StarlightEngine::prepare (double newSampleRate, int newMaximumBlockSize, int newNumChannels,
+                               const std::vector<ChannelGroup>& newGroups)
+{
+    groupPool.stop();
+    pendingLoops.store (nullptr);
+
+    sampleRate = newSampleRate;
+    maximumBlockSize = juce::jmax (1, newMaximumBlockSize);
+    numChannels = juce::jmax (1, newNumChannels);
+
+    std::vector<ChannelGroup> valid;
+    for (const auto& g : newGroups)
+        if (juce::isPositiveAndBelow (g.first, numChannels) && g.second < numChannels && (int) valid.size() < maxGroups)
+            valid.push_back (g);
+
+    jassert (valid.size() == newGroups.size());
+
+    if (valid.empty())
+        valid.push_back ({ 0, numChannels > 1 ? 1 : -1 });
+
+    // keep existing groups so their clouds' worker threads survive a re-prepare
+    while (groups.size() > valid.size())
+        groups.pop_back();
+    while (groups.size() < valid.size())
+        groups.push_back (std::make_unique<Group>());
+
+    const int numGroups = (int) groups.size();
+
+    for (int i = 0; i < numGroups; ++i)
+    {
+        auto& g = *groups[(size_t) i];
+        g.channels = valid[(size_t) i];
+
+        juce::dsp::ProcessSpec spec;
+        spec.sampleRate = sampleRate;
+        spec.maximumBlockSize = (juce::uint32) maximumBlockSize;
+        spec.numChannels = (juce::uint32) g.getNumChannels();
+
+        // with several groups the parallelism is across groups instead
+        g.granular.setCloudWorkers (numGroups > 1 ? 0 : cloudWorkers);
+        g.granular.setCloudBudget (cloudBudget);
+        g.granular.setStorageFormat (delayStorage);
+        g.granular.setLongMemory (longMemorySeconds, longMemoryWaitsForPages);
+        g.granular.prepare (spec);
+        g.shimmer.setStorageFormat (delayStorage);
+        g.shimmer.prepare (spec);
+
+        g.limiter.prepare (spec);
+        g.limiter.setThreshold (-0.5f);
+        g.reverbRefill = 0;
+
+        // size the coefficient storage up front so later updates on the audio thread never allocate
+        *g.wetHP.state = juce::dsp::IIR::ArrayCoefficients<float>::makeHighPass (sampleRate, 120.0f);
+        *g.wetLP.state = juce::dsp::IIR::ArrayCoefficients<float>::makeLowPass (sampleRate, 14000.0f);
+
+        g.wetHP.prepare (spec);
+        g.wetLP.prepare (spec);
+    }
+
+    // every group's long memory is the same length, unless one couldn't map its file
+    scheduler.prepare (sampleRate, maximumBlockSize, groups.front()->granular.getLongMemory().getLength());
+    governor.prepare (sampleRate);
+
+    std::vector<int> groupLayout;
+    for (const auto& g : groups)
+        groupLayout.push_back (g->getNumChannels());
+
+    reverbCapture.prepare (sampleRate, maximumBlockSize, groupLayout, delayStorage, reverbCaptureRequested && ! pipelineRequested);
+
+    for (auto& segment : segments)
+    {
+        segment.dry.setSize (2 * numGroups, maximumBlockSize);
+        segment.wet.setSize (2 * numGroups, maximumBlockSize);
+        segment.mixRamp.assign ((size_t) maximumBlockSize, 0.0f);
+        segment.gainRamp.assign ((size_t) maximumBlockSize, 0.0f);
+        segment.ramping = false;
+        segment.numSamples = 0;
+    }
+
+    tailLengthSeconds = -1.0;
+
+    mixSmoother.reset (sampleRate, outputSmoothingSeconds);
+    gainSmoother.reset (sampleRate, outputSmoothingSeconds);
+    smoothersPrimed = false;
+
+    currentSegment = 0;
+
+    if (pipelineRequested)
+    {
+        if (pipeline == nullptr)
+            pipeline = std::make_unique<PipelineThread> (*this);
+
+        // starts out holding one block of silence: the pipeline's latency
+        outputRing.setSize (2 * numGroups, 4 * maximumBlockSize);
+        outputRing.clear();
+        ringReadPos = 0;
+        ringWritePos = maximumBlockSize;
+    }
+    else
+    {
+        pipeline.reset();
+        outputRing.setSize (0, 0);
+    }
+
+    if (numGroups > 1)
+        groupPool.start (juce::jlimit (0, numGroups - 1, groupWorkers < 0 ? juce::SystemStats::getNumCpus() - 1 : groupWorkers));
+
+   #if STARLIGHT_TRACING
+    updateTraceRecorders();
+   #endif
+}
+
+std::vector<StarlightEngine::ChannelGroup> StarlightEngine::makeChannelGroups (const juce::AudioChannelSet& layout)
+{
+    using Set = juce::AudioChannelSet;
+
+    std::vector<ChannelGroup> result;
+    const int n = layout.size();
+
+    if (layout.getAmbisonicOrder() >= 0)
+    {
+        for (int ch = 0; ch < n; ++ch)
+            result.push_back ({ ch, -1 });
+
+        return result;
+    }
+
+    if (layout.isDiscreteLayout())
+    {
+        for (int ch = 0; ch < n; ch += 2)
+            result.push_back ({ ch, ch + 1 < n ? ch + 1 : -1 });
+
+        return result;
+    }
+
+    static constexpr std::pair<Set::ChannelType, Set::ChannelType> pairs[] =
+    {
+        { Set::left,              Set::right },
+        { Set::leftCentre,        Set::rightCentre },
+        { Set::wideLeft,          Set::wideRight },
+        { Set::leftSurround,      Set::rightSurround },
+        { Set::leftSurroundSide,  Set::rightSurroundSide },
+        { Set::leftSurroundRear,  Set::rightSurroundRear },
+        { Set::topFrontLeft,      Set::topFrontRight },
+        { Set::topSideLeft,       Set::topSideRight },
+        { Set::topRearLeft,       Set::topRearRight },
+    };
+
+    std::vector<bool> grouped ((size_t) n, false);
+
+    for (const auto& [leftType, rightType] : pairs)
+    {
+        const int l = layout.getChannelIndexForType (leftType);
+        const int r = layout.getChannelIndexForType (rightType);
+
+        if (l >= 0 && r >= 0)
+        {
+            result.push_back ({ l, r });
+            grouped[(size_t) l] = grouped[(size_t) r] = true;
+        }
+    }
+
+    for (int ch = 0; ch < n; ++ch)
+    {
+        const auto type = layout.getTypeOfChannel (ch);
+        if (! grouped[(size_t) ch] && type != Set::LFE && type != Set::LFE2)
+            result.push_back ({ ch, -1 });
+    }
+
+    return result;
+}
+
+size_t StarlightEngine::getMemoryBytes() const noexcept
+{
+    size_t bytes = 0;
+
+    for (const auto& g : groups)
+        bytes += g->granular.getMemoryBytes() + g->shimmer.getMemoryBytes();
+
+    bytes += reverbCapture.getMemoryBytes();
+
+    // the segments shrink to the block at hand without giving memory back, so count them at full size
+    const size_t segmentBytes = (2 * groups.size() + 1) * (size_t) maximumBlockSize * sizeof (float);
+    bytes += std::size (segments) * 2 * segmentBytes;
+
+    return bytes + (size_t) outputRing.getNumChannels() * (size_t) outputRing.getNumSamples() * sizeof (float);
+}
+
+std::unique_ptr<FrozenTexture> StarlightEngine::getFrozenTexture() const
+{
+    if (groups.empty())
+        return nullptr;
+
+    const auto& first = groups.front()->granular;
+
+    auto texture = std::make_unique<FrozenTexture>();
+    texture->sampleRate = sampleRate;
+    texture->seamLength = first.getFreezeSeamLength();
+    texture->audio.setSize (2 * (int) groups.size(), first.getFrozenLoopLength());
+    texture->audio.clear();
+
+    for (int g = 0; g < (int) groups.size(); ++g)
+        if (! groups[(size_t) g]->granular.copyFrozenLoop (texture->audio.getArrayOfWritePointers() + 2 * g))
+            return nullptr;
+
+    return texture;
+}
+
+std::unique_ptr<StarlightEngine::FrozenLoops> StarlightEngine::makeFrozenLoops (const FrozenTexture& texture) const
+{
+    if (groups.empty() || texture.audio.getNumChannels() != 2 * (int) groups.size())
+        return nullptr;
+
+    const auto& first = groups.front()->granular;
+    const int length = first.getFrozenLoopLength();
+    const int seam = first.getFreezeSeamLength();
+    const auto format = first.getStorageFormat();
+
+    // lead-in and loop are stretched separately, so the loop starts where it should
+    const int sourceSeam = texture.seamLength;
+    const double seamStep = (double) sourceSeam / seam;
+    const double loopStep = (double) (texture.audio.getNumSamples() - sourceSeam) / (length - seam);
+
+    auto loops = std::make_unique<FrozenLoops>();
+    loops->groups.resize (groups.size());
+
+    for (int g = 0; g < (int) groups.size(); ++g)
+    {
+        for (int ch = 0; ch < 2; ++ch)
+        {
+            auto& loop = loops->groups[(size_t) g][(size_t) ch];
+
+            if (ch == 1 && groups[(size_t) g]->getNumChannels() < 2)
+            {
+                loop.setSize (1, format);
+                continue;
+            }
+
+            loop.setSize (length, format);
+
+            const auto* x = texture.audio.getReadPointer (2 * g + ch);
+            const int last = texture.audio.getNumSamples() - 1;
+
+            for (int i = 0; i < length; ++i)
+            {
+                const double pos = i < seam ? i * seamStep : sourceSeam + (i - seam) * loopStep;
+                const int i0 = juce::jmin ((int) pos, last);
+                const int i1 = juce::jmin (i0 + 1, last);
+                const float frac = (float) (pos - i0);
+                loop.write (i, x[i0] + frac * (x[i1] - x[i0]));
+            }
+        }
+    }
+
+    return loops;
+}
+
+void StarlightEngine::restoreFrozenLoops() noexcept
+{
+    auto* loops = pendingLoops.exchange (nullptr, std::memory_order_acquire);
+    if (loops == nullptr || ! params.getBool (ParamIndex::freeze) || loops->groups.size() != groups.size())
+        return;
+
+    for (size_t g = 0; g < groups.size(); ++g)
+        if (groups[g]->granular.restoreFrozenLoop (loops->groups[g]))
+            groups[g]->reverbRefill = groups[g]->granular.getFrozenLoopLength();
+}
+
+void StarlightEngine::setCloudBudget (float fractionOfBlock)
+{
+    cloudBudget = fractionOfBlock;
+
+    for (auto& g : groups)
+        g->granular.setCloudBudget (fractionOfBlock);
+}
+
+void StarlightEngine::setTaps (const std::vector<GranularDelay::Tap>& newTaps)
+{
+    STARLIGHT_RT_NOTE_LOCK ("StarlightEngine::tapLock");
+    const juce::SpinLock::ScopedLockType sl (tapLock);
+    numTaps = juce::jmin ((int) newTaps.size(), GranularDelay::maxTaps);
+    std::copy_n (newTaps.begin(), numTaps, taps.begin());
+    ++tapVersion;
+}
+
+std::vector<GranularDelay::Tap> StarlightEngine::getTaps() const
+{
+    STARLIGHT_RT_NOTE_LOCK ("StarlightEngine::tapLock");
+    const juce::SpinLock::ScopedLockType sl (tapLock);
+    return { taps.begin(), taps.begin() + numTaps };
+}
+
+double StarlightEngine::computeTailLengthSeconds (const ParameterSnapshot& p, float longestTapMs)
+{
+    if (p.get (ParamIndex::mix) <= 0.0f)
+        return 0.0;
+
+    // frozen, or replaying minutes of history from the long memory
+    if (p.getBool (ParamIndex::freeze) || p.get (ParamIndex::memory) > 0.0f)
+        return maxTailLengthSeconds;
+
+    const double minus60dB = std::log (0.001);
+
+    // granular echoes: one delay time per repeat until the feedback has taken them down 60 dB
+    const double feedback = juce::jlimit (0.0, 0.95, (double) p.get (ParamIndex::feedback));
+    const double repeats = feedback > 0.001 ? minus60dB / std::log (feedback) : 0.0;
+    const double delayTail = (juce::jmax (p.get (ParamIndex::delayTimeMs), longestTapMs) / 1000.0) * (repeats + 1.0)
+                             + p.get (ParamIndex::grainSizeMs) / 1000.0;
+
+    // juce::Reverb's combs are ~35 ms long with feedback 0.7 + 0.28 * roomSize; the pitched
+    // feedback stretches that further. Ignores damping, so it errs on the long side.
+    const double combFeedback = 0.7 + 0.28 * juce::jlimit (0.0, 1.0, (double) p.get (ParamIndex::reverbSize));
+    const double shimmerAmount = juce::jlimit (0.0, 1.0, (double) p.get (ParamIndex::shimmerAmt));
+    const double reverbTail = p.get (ParamIndex::preDelayMs) / 1000.0
+                              + 0.035 * (minus60dB / std::log (combFeedback)) * (1.0 + shimmerAmount);
+
+    return juce::jmin (maxTailLengthSeconds, delayTail + reverbTail);
+}
+
+#if STARLIGHT_TRACING
+void StarlightEngine::setTraceRecorder (TraceRecorder* r)
+{
+    trace = r;
+    updateTraceRecorders();
+}
+
+void StarlightEngine::updateTraceRecorders()
+{
+    // The recorder takes events from one thread only: the pipeline runs the granular stage
+    // on a thread of its own, and groups may be rendered on the group pool's threads.
+    const bool oneGroup = groups.size() == 1;
+
+    granularTrace = pipeline == nullptr && oneGroup ? trace : nullptr;
+    outputTrace = oneGroup ? trace : nullptr;
+    scheduler.setTraceRecorder (pipeline == nullptr ? trace : nullptr);
+
+    for (auto& g : groups)
+    {
+        g->granular.setTraceRecorder (granularTrace);
+        g->shimmer.setTraceRecorder (outputTrace);
+    }
+}
+#endif
+
+// p has been through the modulation matrix
+static GranularDelay::Params makeGranularParams (const ParameterSnapshot& p)
+{
+    GranularDelay::Params g;
+    g.inputGain = dbToLin (p.get (ParamIndex::inputGain));
+    g.delayTimeMs = p.get (ParamIndex::delayTimeMs);
+    g.feedback = p.get (ParamIndex::feedback);
+    g.grainSizeMs = p.get (ParamIndex::grainSizeMs);
+    g.density = p.get (ParamIndex::density);
+    g.jitter = p.get (ParamIndex::jitter);
+    g.pitchSemitones = p.get (ParamIndex::pitchSemi);
+    g.spread = p.get (ParamIndex::spread);
+    g.drift = p.get (ParamIndex::drift);
+    g.modRateHz = p.get (ParamIndex::modRate);
+    g.modDepth = p.get (ParamIndex::modDepth);
+    g.freeze = p.getBool (ParamIndex::freeze);
+    g.cloudDensity = p.get (ParamIndex::cloudDensity);
+    g.memory = p.get (ParamIndex::memory);
+    return g;
+}
+
+static float getShimmerInterval (const ParameterSnapshot& p)
+{
+    const auto shimmerPitchChoice = (int) p.get (ParamIndex::shimmerPitch);
+
+    return shimmerPitchChoice == 0 ? 5.0f
+         : shimmerPitchChoice == 1 ? 7.0f
+         : shimmerPitchChoice == 2 ? 12.0f
+                                   : 24.0f;
+}
+
+static ShimmerReverb::Params makeReverbParams (const ParameterSnapshot& p, float shimmerInterval)
+{
+    ShimmerReverb::Params r;
+    r.roomSize = p.get (ParamIndex::reverbSize);
+    r.preDelayMs = p.get (ParamIndex::preDelayMs);
+    r.tone = p.get (ParamIndex::tone);
+    r.shimmerAmount = p.get (ParamIndex::shimmerAmt);
+    r.reverbMix = p.get (ParamIndex::reverbMix);
+    r.earlyLevel = p.get (ParamIndex::early);
+    r.drift = p.get (ParamIndex::drift);
+    r.modRateHz = p.get (ParamIndex::modRate);
+    r.modDepth = p.get (ParamIndex::modDepth);
+    r.freeze = p.getBool (ParamIndex::freeze);
+    r.pitchSemitones = shimmerInterval;
+    return r;
+}
+
+void StarlightEngine::scheduleGrains (Segment& segment)
+{
+    scheduler.schedule (segment.granular, granularQuality (segment.qualityLevel), segment.numSamples);
+}
+
+void StarlightEngine::processGranularStage (Segment& segment)
+{
+    STARLIGHT_TRACE_SCOPE (granularTrace, "granular");
+
+    scheduleGrains (segment);
+
+    for (int g = 0; g < (int) groups.size(); ++g)
+        processGroupGranular (segment, g);
+}
+
+void StarlightEngine::processOutputStage (Segment& segment)
+{
+    if (groupPool.getNumWorkers() > 0)
+    {
+        processGroupsInParallel (segment, true);
+        return;
+    }
+
+    for (int g = 0; g < (int) groups.size(); ++g)
+        processGroupOutput (segment, g);
+}
+
+void StarlightEngine::processGroupGranular (Segment& segment, int index)
+{
+    auto& group = *groups[(size_t) index];
+
+    group.granular.setQuality (granularQuality (segment.qualityLevel));
+    group.granular.setParams (segment.granular);
+
+    auto dry = groupChannels (segment.dry, index, group.getNumChannels(), segment.numSamples);
+    auto wet = groupChannels (segment.wet, index, group.getNumChannels(), segment.numSamples);
+    wet.clear();
+
+    group.granular.process (dry, wet, scheduler);
+}
+
+void StarlightEngine::processGroupOutput (Segment& segment, int index)
+{
+    auto& group = *groups[(size_t) index];
+    const auto& p = segment.params;
+    const int numSamples = segment.numSamples;
+
+    group.shimmer.setQuality (reverbQuality (segment.qualityLevel));
+
+    if (group.reverbRefill > 0)
+    {
+        auto refill = segment.reverb;
+        refill.freeze = false;
+        group.shimmer.setParams (refill);
+        group.reverbRefill -= numSamples;
+    }
+    else
+    {
+        group.shimmer.setParams (segment.reverb);
+    }
+
+    const bool hpEnabled = p.getBool (ParamIndex::hpEnable);
+    const bool lpEnabled = p.getBool (ParamIndex::lpEnable);
+
+    // ArrayCoefficients write into the existing coefficient storage instead of allocating a new object
+    if (hpEnabled)
+    {
+        *group.wetHP.state = segment.highPass;
+    }
+
+    if (lpEnabled)
+    {
+        *group.wetLP.state = segment.lowPass;
+    }
+
+    auto dryBuffer = groupChannels (segment.dry, index, group.getNumChannels(), numSamples);
+    auto wetBuffer = groupChannels (segment.wet, index, group.getNumChannels(), numSamples);
+
+    {
+        STARLIGHT_TRACE_SCOPE (outputTrace, "shimmer");
+        reverbCapture.process (index, group.shimmer, wetBuffer);
+    }
+
+    juce::dsp::AudioBlock<float> wetBlock (wetBuffer);
+    {
+        STARLIGHT_TRACE_SCOPE (outputTrace, "wetFilters");
+
+        if (hpEnabled)
+        {
+            group.wetHP.process (juce::dsp::ProcessContextReplacing<float> (wetBlock));
+        }
+
+        if (lpEnabled)
+        {
+            group.wetLP.process (juce::dsp::ProcessContextReplacing<float> (wetBlock));
+        }
+    }
+
+    if (segment.ramping)
+    {
+        const auto* mix = segment.mixRamp.data();
+        const auto* outGain = segment.gainRamp.data();
+
+        for (int ch = 0; ch < dryBuffer.getNumChannels(); ++ch)
+        {
+            auto* dry = dryBuffer.getWritePointer (ch);
+            auto* wet = wetBuffer.getReadPointer (ch);
+
+            for (int i = 0; i < numSamples; ++i)
+                dry[i] = ((1.0f - mix[i]) * dry[i] + mix[i] * wet[i]) * outGain[i];
+        }
+    }
+    else
+    {
+        const float mix = p.get (ParamIndex::mix);
+        const float outGain = dbToLin (p.get (ParamIndex::outputGain));
+
+        for (int ch = 0; ch < dryBuffer.getNumChannels(); ++ch)
+        {
+            auto* dry = dryBuffer.getWritePointer (ch);
+            auto* wet = wetBuffer.getReadPointer (ch);
+
+            for (int i = 0; i < numSamples; ++i)
+                dry[i] = (1.0f - mix) * dry[i] + mix * wet[i];
+        }
+
+        dryBuffer.applyGain (outGain);
+    }
+
+    juce::dsp::AudioBlock<float> block (dryBuffer);
+    {
+        STARLIGHT_TRACE_SCOPE (outputTrace, "limiter");
+        group.limiter.process (juce::dsp::ProcessContextReplacing<float> (block));
+    }
+}
+
+void StarlightEngine::processGroupsInParallel (Segment& segment, bool outputStageOnly)
+{
+    groupTask->start (segment, outputStageOnly);
+    groupPool.dispatch (*groupTask);
+    groupTask->run (0);
+
+    while (! groupTask->isDone())
+        RealtimeWorkerPool::pause();
+}
+
+void StarlightEngine::loadInput (Segment& segment, const float* const* channels, int offset, int numSamples)
+{
+    // process() splits anything bigger, so the segment's buffers never have to grow
+    jassert (numSamples <= maximumBlockSize);
+
+    segment.numSamples = numSamples;
+    segment.params = params;
+
+    // the macros and any other routings; everything below sees the modulated values
+    float shimmerInterval = getShimmerInterval (params);
+    modulation.apply (segment.params, shimmerInterval);
+    const auto& p = segment.params;
+
+    // CPU Guard: 0 = off, 1 = auto, 2.. = auto with a minimum level of 1..
+    const int guard = (int) p.get (ParamIndex::cpuGuard);
+    governor.setRange (guard > 0, guard - 1);
+    segment.qualityLevel = governor.getLevel();
+
+    segment.granular = makeGranularParams (p);
+    segment.granular.source = sampleSource.load (std::memory_order_acquire);
+
+    if (const auto version = tapVersion.load(); version != tapVersionInUse)
+    {
+        const juce::SpinLock::ScopedTryLockType sl (tapLock);
+        if (sl.isLocked())
+        {
+            tapsInUse = taps;
+            numTapsInUse = numTaps;
+            tapVersionInUse = version;
+        }
+    }
+
+    segment.granular.taps = tapsInUse;
+    segment.granular.numTaps = numTapsInUse;
+
+    float longestTapMs = 0.0f;
+    for (int t = 0; t < numTapsInUse; ++t)
+        longestTapMs = juce::jmax (longestTapMs, tapsInUse[(size_t) t].delayTimeMs);
+
+    tailLengthSeconds.store (computeTailLengthSeconds (p, longestTapMs), std::memory_order_relaxed);
+    segment.reverb = makeReverbParams (p, shimmerInterval);
+
+    // the shimmer's pitch shifter and a freeze, or a restored one refilling, make the reverb time-varying
+    const bool reverbIsStatic = ! segment.reverb.freeze && segment.reverb.shimmerAmount <= 0.0f
+                                && std::none_of (groups.begin(), groups.end(), [] (const auto& g) { return g->reverbRefill > 0; });
+    reverbCapture.update (segment.reverb, reverbQuality (segment.qualityLevel), reverbIsStatic, numSamples);
+
+    // Mix and Output glide sample by sample; once they've arrived the segment uses the plain values
+    const float mixTarget = p.get (ParamIndex::mix);
+    const float gainTarget = dbToLin (p.get (ParamIndex::outputGain));
+
+    if (! smoothersPrimed)
+    {
+        mixSmoother.setCurrentAndTargetValue (mixTarget);
+        gainSmoother.setCurrentAndTargetValue (gainTarget);
+        smoothersPrimed = true;
+    }
+    else
+    {
+        mixSmoother.setTargetValue (mixTarget);
+        gainSmoother.setTargetValue (gainTarget);
+    }
+
+    segment.ramping = mixSmoother.isSmoothing() || gainSmoother.isSmoothing();
+
+    if (segment.ramping)
+    {
+        for (int i = 0; i < numSamples; ++i)
+        {
+            segment.mixRamp[(size_t) i] = mixSmoother.getNextValue();
+            segment.gainRamp[(size_t) i] = gainSmoother.getNextValue();
+        }
+    }
+
+    if (p.getBool (ParamIndex::hpEnable))
+        segment.highPass = juce::dsp::IIR::ArrayCoefficients<float>::makeHighPass (sampleRate, p.get (ParamIndex::hpFreq));
+
+    if (p.getBool (ParamIndex::lpEnable))
+        segment.lowPass = juce::dsp::IIR::ArrayCoefficients<float>::makeLowPass (sampleRate, p.get (ParamIndex::lpFreq));
+
+    const int numGroups = (int) groups.size();
+    segment.dry.setSize (2 * numGroups, numSamples, false, false, true);
+    segment.wet.setSize (2 * numGroups, numSamples, false, false, true);
+
+    for (int g = 0; g < numGroups; ++g)
+    {
+        const auto& c = groups[(size_t) g]->channels;
+        segment.dry.copyFrom (2 * g, 0, channels[c.first] + offset, numSamples);
+
+        if (c.second >= 0)
+            segment.dry.copyFrom (2 * g + 1, 0, channels[c.second] + offset, numSamples);
+    }
+}
+
+void StarlightEngine::writeOutput (float* const* channels, int offset, const float* const* sources, int numSamples)
+{
+    for (int g = 0; g < (int) groups.size(); ++g)
+    {
+        const auto& c = groups[(size_t) g]->channels;
+        juce::FloatVectorOperations::copy (channels[c.first] + offset, sources[2 * g], numSamples);
+
+        if (c.second >= 0)
+            juce::FloatVectorOperations::copy (channels[c.second] + offset, sources[2 * g + 1], numSamples);
+    }
+}
+
+void StarlightEngine::process (float* const* channels, int numSamples)
+{
+    if (numSamples <= 0)
+        return;
+
+    restoreFrozenLoops();
+
+    // the segments are sized for one maximum-size block, and turbo's latency is one such block,
+    // so bigger calls are split rather than growing buffers on the audio thread
+    for (int start = 0; start < numSamples; start += maximumBlockSize)
+    {
+        const int chunk = juce::jmin (maximumBlockSize, numSamples - start);
+
+        if (pipeline != nullptr)
+            processPipelined (channels, start, chunk);
+        else
+            processSerial (channels, start, chunk);
+    }
+
+    processedBlocks.fetch_add (1, std::memory_order_release);
+}
+
+void StarlightEngine::processSerial (float* const* channels, int offset, int numSamples)
+{
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+
+    auto& segment = segments[0];
+    loadInput (segment, channels, offset, numSamples);
+
+    if (groupPool.getNumWorkers() > 0)
+    {
+        STARLIGHT_TRACE_SCOPE (trace, "groups");
+        scheduleGrains (segment);
+        processGroupsInParallel (segment, false);
+    }
+    else
+    {
+        processGranularStage (segment);
+        processOutputStage (segment);
+    }
+
+    writeOutput (channels, offset, segment.dry.getArrayOfReadPointers(), numSamples);
+
+    governor.update (juce::Time::getHighResolutionTicks() - startTicks, numSamples);
+}
+
+void StarlightEngine::processPipelined (float* const* channels, int offset, int numSamples)
+{
+    auto& segment = segments[currentSegment];
+    auto& previous = segments[1 - currentSegment];
+    currentSegment = 1 - currentSegment;
+
+    loadInput (segment, channels, offset, numSamples);
+    pipeline->start (segment);
+
+    const int ringSize = outputRing.getNumSamples();
+    const int numBuffers = outputRing.getNumChannels();
+
+    if (previous.numSamples > 0)
+    {
+        processOutputStage (previous);
+
+        const int first = juce::jmin (previous.numSamples, ringSize - ringWritePos);
+        for (int ch = 0; ch < numBuffers; ++ch)
+        {
+            outputRing.copyFrom (ch, ringWritePos, previous.dry, ch, 0, first);
+            outputRing.copyFrom (ch, 0, previous.dry, ch, first, previous.numSamples - first);
+        }
+
+        ringWritePos = (ringWritePos + previous.numSamples) % ringSize;
+    }
+
+    pipeline->waitUntilDone();
+
+    const int first = juce::jmin (numSamples, ringSize - ringReadPos);
+    std::array<const float*, 2 * maxGroups> ring {};
+
+    for (int ch = 0; ch < numBuffers; ++ch)
+        ring[(size_t) ch] = outputRing.getReadPointer (ch, ringReadPos);
+    writeOutput (channels, offset, ring.data(), first);
+
+    for (int ch = 0; ch < numBuffers; ++ch)
+        ring[(size_t) ch] = outputRing.getReadPointer (ch);
+    writeOutput (channels, offset + first, ring.data(), numSamples - first);
+
+    ringReadPos = (ringReadPos + numSamples) % ringSize;
+}
@@ -0,0 +1,295 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_dsp/juce_dsp.h>
+
+#include "FrozenTexture.h"
+#include "ModulationMatrix.h"
+#include "Parameters.h"
+#include "QualityGovernor.h"
+#include "ReverbCapture.h"
+#include "../DSP/GranularDelay.h"
+#include "../DSP/RealtimeWorkerPool.h"
+#include "../DSP/ShimmerReverb.h"
+#include "../Diagnostics/TraceRecorder.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// The complete Starlight Drift signal chain with no plugin or GUI dependencies:
+// granular delay -> shimmer reverb -> wet HP/LP -> dry/wet mix -> output gain -> limiter.
+//
+//     StarlightEngine engine;
+//     engine.prepare (48000.0, 512, 2);
+//     engine.setParameters (snapshot);
+//     engine.process (channels, numSamples); // in place
+//
+// Multichannel buses are split into channel groups (pairs, or single channels), each
+// with its own delay line, reverb, filters and limiter. One grain scheduler drives
+// every group, so they all play the same grain pattern and drift together; with more
+// than one group the groups are rendered in parallel on a few helper threads.
+class StarlightEngine final
+{
+public:
+    static constexpr double maxTailLengthSeconds = 20.0;
+    static constexpr int maxGroups = 16;
+    static constexpr double outputSmoothingSeconds = 0.02;
+
+    // Channels processed together: a pair, or a single channel (second < 0) that gets the
+    // mono chain, with one pitch shifter, a mono reverb and single-channel filters and
+    // limiter. Channels in no group pass through.
+    struct ChannelGroup
+    {
+        int first = 0;
+        int second = -1;
+    };
+
+    StarlightEngine();
+    ~StarlightEngine();
+
+    // Estimated time for the output to decay by 60 dB once the input stops, capped
+    // at maxTailLengthSeconds (which is also what freeze gets). The snapshot is what the
+    // engine plays, after the morph and the routings (see ModulationMatrix::modulate()).
+    // longestTapMs: the longest delay time among the taps, if it's longer than Time (see setTaps()).
+    static double computeTailLengthSeconds (const ParameterSnapshot& snapshot, float longestTapMs = 0.0f);
+
+    // Any thread: computeTailLengthSeconds() for the parameters and taps the last process()
+    // call played; negative until the first call after prepare().
+    double getTailLengthSeconds() const noexcept { return tailLengthSeconds.load (std::memory_order_relaxed); }
+
+    // Groups for a host channel layout: the left/right pairs of surround layouts (front,
+    // sides, rears, wides, heights), other channels on their own except the LFE, which
+    // passes through dry. Ambisonic components each get a group, so the shared grain
+    // pattern and identical reverbs leave the sound field's directions intact.
+    static std::vector<ChannelGroup> makeChannelGroups (const juce::AudioChannelSet& layout);
+
+    // Pairs channels 0+1, 2+3, ...; an odd last channel gets a group of its own.
+    void prepare (double sampleRate, int maximumBlockSize, int numChannels);
+    void prepare (double sampleRate, int maximumBlockSize, int numChannels, const std::vector<ChannelGroup>& groups);
+
+    // Cheap and allocation-free; takes effect from the next process() call. Mix and Output
+    // glide to their new values sample by sample over outputSmoothingSeconds, so a block can
+    // be split into short calls at automation points without zipper noise; the first call
+    // after prepare() starts at the values given.
+    void setParameters (const ParameterSnapshot& snapshot) noexcept { params = snapshot; }
+    const ParameterSnapshot& getParameters() const noexcept { return params; }
+
+    // The macros' routings, applied to the parameters at the start of every process() call.
+    // Any thread but the audio thread may change them (see ModulationMatrix).
+    ModulationMatrix& getModulation() noexcept { return modulation; }
+    const ModulationMatrix& getModulation() const noexcept { return modulation; }
+
+    // Any thread but the audio thread: grain streams played alongside the main one from the
+    // same delay line (see GranularDelay::Tap); any past GranularDelay::maxTaps are dropped.
+    // Picked up by the first process() call that doesn't find them being changed.
+    void setTaps (const std::vector<GranularDelay::Tap>&);
+    std::vector<GranularDelay::Tap> getTaps() const;
+
+    // Allocation-free for any numSamples: calls longer than the prepared maximumBlockSize are
+    // processed in pieces of at most that size.
+    void process (float* const* channels, int numSamples);
+
+    // Offline only, applied on the next prepare(): runs the granular stage of each block on
+    // a second thread while this one runs the reverb and output stages of the previous block,
+    // shared with the group workers when there are several channel groups. The output is
+    // bit-identical to the serial path, delayed by getLatencySamples().
+    void setPipelined (bool shouldPipeline) { pipelineRequested = shouldPipeline; }
+    bool isPipelined() const noexcept { return pipeline != nullptr; }
+    int getLatencySamples() const noexcept { return pipeline != nullptr ? maximumBlockSize : 0; }
+
+    // Real-time only, applied on the next prepare() (ignored when pipelined): plays the reverb
+    // through a convolution with its own captured response while its settings hold still,
+    // and goes back to the reverb when they move (see ReverbCapture).
+    void setReverbCapture (bool shouldCapture) { reverbCaptureRequested = shouldCapture; }
+
+    // Any thread: whether the groups are playing a captured reverb response right now.
+    bool isReverbConvolving() const noexcept { return reverbCapture.isConvolving(); }
+
+    // Deterministic grain scheduling, applied on the next prepare().
+    void setRandomSeed (juce::int64 seed) { scheduler.setRandomSeed (seed); }
+
+    // Helper threads for the grain cloud (see GranularDelay::setCloudWorkers), applied on the
+    // next prepare(). With several channel groups the clouds stay on their group's thread.
+    void setCloudWorkers (int numWorkers) { cloudWorkers = numWorkers; }
+    void setCloudBudget (float fractionOfBlock);
+    const GrainCloud& getGrainCloud() const noexcept { return groups.front()->granular.getCloud(); }
+
+    // Helper threads rendering channel groups alongside the caller, applied on the next
+    // prepare(). -1 uses up to one per group (bar the caller's), within the core count;
+    // 0 renders the groups one after the other. When pipelined they share the output stage.
+    void setGroupWorkers (int numWorkers) { groupWorkers = numWorkers; }
+
+    int getNumChannels() const noexcept { return numChannels; }
+    int getNumGroups() const noexcept { return (int) groups.size(); }
+
+    // How the grain and pre-delay lines store their samples, applied on the next prepare().
+    // The 16-bit formats halve the biggest allocations at a small cost in fidelity (see DelayBuffer).
+    void setDelayStorage (DelayBuffer::Format newFormat) { delayStorage = newFormat; }
+    DelayBuffer::Format getDelayStorage() const noexcept { return delayStorage; }
+
+    // Seconds of input each group keeps in its long memory for the Memory parameter to
+    // scatter grains across (see LongMemory), applied on the next prepare(); 0 turns it off.
+    // Offline renders should wait for pages so the output doesn't depend on disk speed.
+    void setLongMemory (double seconds, bool waitForPages)
+    {
+        longMemorySeconds = seconds;
+        longMemoryWaitsForPages = waitForPages;
+    }
+
+    double getLongMemory() const noexcept { return longMemorySeconds; }
+
+    // Any thread: a file for the grain engine to play in place of the input (sampler mode),
+    // or nullptr for the live input. Takes effect from the next process() call; the previous
+    // source may still be read until getProcessedBlocks() has moved on from its value just
+    // after this call.
+    void setSampleSource (const SampleSource* source) noexcept { sampleSource.store (source, std::memory_order_release); }
+
+    // Message thread (allocates): every group's completed freeze loop, for saving with the
+    // session; nullptr unless all of them are replaying one.
+    std::unique_ptr<FrozenTexture> getFrozenTexture() const;
+
+    // The groups' freeze recordings as they store them, built off the audio thread.
+    struct FrozenLoops
+    {
+        std::vector<std::array<DelayBuffer, 2>> groups;
+    };
+
+    // Not for the audio thread: a texture converted for the engine as it's prepared now, and
+    // resampled if it was captured at another rate; nullptr if it was captured with a
+    // different number of channel groups.
+    std::unique_ptr<FrozenLoops> makeFrozenLoops (const FrozenTexture&) const;
+
+    // Any thread: the next process() call replays `loops` in place of the groups' freeze
+    // recordings, if Freeze is on then, and drops them otherwise. juce::Reverb's state can't
+    // be saved, so the reverb takes in one pass of the loop before it freezes again. The
+    // engine swaps its previous buffers into `loops`, which has to stay alive until
+    // getProcessedBlocks() has moved on from its value just after this call. prepare()
+    // drops loops that haven't been picked up.
+    void setFrozenLoops (FrozenLoops* loops) noexcept { pendingLoops.store (loops, std::memory_order_release); }
+
+    // Any thread: process() calls completed since construction.
+    juce::uint64 getProcessedBlocks() const noexcept { return processedBlocks.load (std::memory_order_acquire); }
+
+    // Heap memory held by the signal chain since the last prepare(): delay lines, grain
+    // pools, reverbs and block buffers.
+    size_t getMemoryBytes() const noexcept;
+
+    // Lets the CPU governor shed work when blocks get close to their deadline (see
+    // QualityGovernor); the CPU Guard parameter picks Off, Auto or a minimum level.
+    // Real-time use only: offline renders should stay deterministic.
+    void setGovernorEnabled (bool shouldAdapt) { governor.setEnabled (shouldAdapt); }
+
+    // Any thread: the degradation level in force, 0 (full quality) to QualityGovernor::maxLevel.
+    int getQualityLevel() const noexcept { return governor.getLevel(); }
+
+   #if STARLIGHT_TRACING
+    void setTraceRecorder (TraceRecorder* r);
+   #endif
+
+private:
+    class PipelineThread;
+    class GroupTask;
+
+    using Filter = juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>, juce::dsp::IIR::Coefficients<float>>;
+
+    // Everything that holds per-channel state for one channel group.
+    struct Group
+    {
+        int getNumChannels() const noexcept { return channels.second >= 0 ? 2 : 1; }
+
+        ChannelGroup channels;
+        GranularDelay granular;
+        ShimmerReverb shimmer;
+        Filter wetHP, wetLP;
+        juce::dsp::Limiter<float> limiter;
+        int reverbRefill = 0; // samples the reverb still takes in after a restored freeze
+    };
+
+    // One host block on its way through the chain, with the settings it arrived with.
+    // Group g's channels are 2g and 2g + 1 of dry and wet (a mono group leaves 2g + 1 unused).
+    struct Segment
+    {
+        juce::AudioBuffer<float> dry, wet;
+        ParameterSnapshot params;
+        GranularDelay::Params granular;
+        ShimmerReverb::Params reverb;
+        std::array<float, 6> highPass {}, lowPass {};
+        std::vector<float> mixRamp, gainRamp; // per sample, while Mix or Output is gliding
+        bool ramping = false;
+        int qualityLevel = 0;
+        int numSamples = 0;
+    };
+
+    void scheduleGrains (Segment&);
+    void processGranularStage (Segment&);
+    void processOutputStage (Segment&);
+    void processGroupGranular (Segment&, int group);
+    void processGroupOutput (Segment&, int group);
+    void processGroupsInParallel (Segment&, bool outputStageOnly);
+    void processSerial (float* const* channels, int offset, int numSamples);
+    void processPipelined (float* const* channels, int offset, int numSamples);
+
+    // offset: where the segment starts in the host's channels
+    void loadInput (Segment&, const float* const* channels, int offset, int numSamples);
+    void restoreFrozenLoops() noexcept;
+    void writeOutput (float* const* channels, int offset, const float* const* sources, int numSamples);
+
+   #if STARLIGHT_TRACING
+    void updateTraceRecorders();
+   #endif
+
+    double sampleRate = 48000.0;
+    int maximumBlockSize = 512;
+    int numChannels = 2;
+    ParameterSnapshot params;
+    ModulationMatrix modulation;
+
+    // the taps as set, and as the audio thread last picked them up
+    std::array<GranularDelay::Tap, GranularDelay::maxTaps> taps {}, tapsInUse {};
+    int numTaps = 0, numTapsInUse = 0;
+    mutable juce::SpinLock tapLock;
+    std::atomic<juce::uint32> tapVersion { 0 };
+    juce::uint32 tapVersionInUse = 0;
+
+    GranularDelay::Scheduler scheduler;
+    std::vector<std::unique_ptr<Group>> groups;
+    int cloudWorkers = -1;
+    float cloudBudget = 0.5f;
+
+    DelayBuffer::Format delayStorage = DelayBuffer::Format::float32;
+    double longMemorySeconds = 0.0;
+    bool longMemoryWaitsForPages = false;
+
+    std::atomic<const SampleSource*> sampleSource { nullptr };
+    std::atomic<FrozenLoops*> pendingLoops { nullptr };
+    std::atomic<juce::uint64> processedBlocks { 0 };
+    std::atomic<double> tailLengthSeconds { -1.0 };
+
+    int groupWorkers = -1;
+    RealtimeWorkerPool groupPool;
+    std::unique_ptr<GroupTask> groupTask;
+
+    QualityGovernor governor;
+
+    ReverbCapture reverbCapture;
+    bool reverbCaptureRequested = false;
+
+    juce::SmoothedValue<float> mixSmoother, gainSmoother;
+    bool smoothersPrimed = false;
+
+    Segment segments[2];
+    int currentSegment = 0;
+
+    bool pipelineRequested = false;
+    std::unique_ptr<PipelineThread> pipeline;
+    juce::AudioBuffer<float> outputRing; // latency line for the pipelined path
+    int ringWritePos = 0, ringReadPos = 0;
+
+   #if STARLIGHT_TRACING
+    TraceRecorder* trace = nullptr;
+    TraceRecorder* granularTrace = nullptr; // null wherever the stage may run off the calling thread
+    TraceRecorder* outputTrace = nullptr;
+   #endif
+};
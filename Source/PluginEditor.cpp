@@ -1,48 +1,28 @@
 #include "PluginEditor.h"
 
+static constexpr int headerHeight = 88; // the title, and three rows of header controls beside it
+
 struct StarlightDriftAudioProcessorEditor::Impl
 {
     juce::Label noInputLabel;
+    juce::ToggleButton turboBounce { "TURBO BOUNCE" };
+    juce::ComboBox cpuGuard;
+    juce::Label qualityLabel;
+    juce::ComboBox delayStorage;
+    juce::Label memoryLabel;
+    juce::ComboBox longMemory;
+    juce::TextButton sampleButton;
+    juce::ToggleButton keepFreeze { "KEEP FREEZE" };
+    juce::TextButton presetButton;
+    juce::TextButton tapButton;
+    juce::ToggleButton reverbCapture { "IR REVERB" };
+    std::unique_ptr<MorphPad> morphPad;
+    std::unique_ptr<juce::FileChooser> sampleChooser;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> attCpuGuard;
     juce::AudioBuffer<float> waveformScratch;
     int silentFrameCount = 0;
 };
 
-// ... ParamIDs namespace (same as before, omitted for brevity if duplicate, but must include for full file) ...
-// Actually better to include the namespace to ensure compiling.
-namespace ParamIDs
-{
-    static constexpr auto inputGain = "inputGain";
-    static constexpr auto delayTimeMs = "delayTimeMs";
-    static constexpr auto feedback = "feedback";
-    static constexpr auto grainSizeMs = "grainSizeMs";
-    static constexpr auto density = "density";
-    static constexpr auto jitter = "jitter";
-    static constexpr auto pitchSemi = "pitchSemi";
-    static constexpr auto spread = "spread";
-
-    static constexpr auto reverbSize = "reverbSize";
-    static constexpr auto preDelayMs = "preDelayMs";
-    static constexpr auto tone = "tone";
-    static constexpr auto shimmerAmt = "shimmerAmt";
-    static constexpr auto shimmerPitch = "shimmerPitch";
-    static constexpr auto reverbMix = "reverbMix";
-
-    static constexpr auto mix = "mix";
-    static constexpr auto outputGain = "outputGain";
-    static constexpr auto hpEnable = "hpEnable";
-    static constexpr auto hpFreq = "hpFreq";
-    static constexpr auto lpEnable = "lpEnable";
-    static constexpr auto lpFreq = "lpFreq";
-
-    static constexpr auto drift = "drift";
-    static constexpr auto modRate = "modRate";
-    static constexpr auto modDepth = "modDepth";
-    static constexpr auto freeze = "freeze";
-
-    static constexpr auto air = "air";
-    static constexpr auto glass = "glass";
-}
-
 StarlightDriftAudioProcessorEditor::StarlightDriftAudioProcessorEditor (StarlightDriftAudioProcessor& p)
     : AudioProcessorEditor (&p), processor (p), apvts (p.getAPVTS()),
       drift (p, ParamIDs::drift, "DRIFT", LockableSlider::Style::Large),
@@ -63,8 +43,11 @@ StarlightDriftAudioProcessorEditor::StarlightDriftAudioProcessorEditor (Starligh
       jitter (p, ParamIDs::jitter, "JITTER", LockableSlider::Style::Tiny),
       pitch (p, ParamIDs::pitchSemi, "PITCH", LockableSlider::Style::Tiny),
       spread (p, ParamIDs::spread, "SPREAD", LockableSlider::Style::Tiny),
+      cloud (p, ParamIDs::cloudDensity, "CLOUD", LockableSlider::Style::Tiny),
+      memory (p, ParamIDs::memory, "MEMORY", LockableSlider::Style::Tiny),
       reverbSize (p, ParamIDs::reverbSize, "SIZE", LockableSlider::Style::Tiny),
       preDelay (p, ParamIDs::preDelayMs, "PRE-DLY", LockableSlider::Style::Tiny),
+      early (p, ParamIDs::early, "EARLY", LockableSlider::Style::Tiny),
       tone (p, ParamIDs::tone, "TONE", LockableSlider::Style::Tiny),
       shimmerAmt (p, ParamIDs::shimmerAmt, "SHIM AMT", LockableSlider::Style::Tiny),
       reverbMix (p, ParamIDs::reverbMix, "VERB MIX", LockableSlider::Style::Tiny),
@@ -76,13 +59,112 @@ StarlightDriftAudioProcessorEditor::StarlightDriftAudioProcessorEditor (Starligh
     impl = std::make_unique<Impl>();
 
     for (auto* c : { &drift, &air, &glass, &mix, &output, &hpFreq, &lpFreq,
-                     &inputGain, &timeMs, &feedback, &grainSize, &density, &jitter, &pitch, &spread,
-                     &reverbSize, &preDelay, &tone, &shimmerAmt, &reverbMix, &modRate, &modDepth })
+                     &inputGain, &timeMs, &feedback, &grainSize, &density, &jitter, &pitch, &spread, &cloud, &memory,
+                     &reverbSize, &preDelay, &early, &tone, &shimmerAmt, &reverbMix, &modRate, &modDepth })
         addAndMakeVisible (*c);
 
     addAndMakeVisible (waveform);
     addAndMakeVisible (impl->noInputLabel);
 
+    impl->turboBounce.setTooltip ("Use all cores for offline bounces (adds one block of latency)");
+    impl->turboBounce.setToggleState (processor.isOfflineTurbo(), juce::dontSendNotification);
+    impl->turboBounce.onClick = [this] { processor.setOfflineTurbo (impl->turboBounce.getToggleState()); };
+    addAndMakeVisible (impl->turboBounce);
+
+    if (auto* choice = dynamic_cast<juce::AudioParameterChoice*> (apvts.getParameter (ParamIDs::cpuGuard)))
+        impl->cpuGuard.addItemList (choice->choices, 1);
+    impl->cpuGuard.setJustificationType (juce::Justification::centred);
+    impl->cpuGuard.setTooltip ("CPU Guard: sheds grain voices, interpolation, reverb width and modulation rate when the CPU can't keep up");
+    impl->attCpuGuard = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment> (apvts, ParamIDs::cpuGuard, impl->cpuGuard);
+    addAndMakeVisible (impl->cpuGuard);
+
+    impl->qualityLabel.setJustificationType (juce::Justification::centredRight);
+    impl->qualityLabel.setColour (juce::Label::textColourId, lnf.txtDim);
+    addAndMakeVisible (impl->qualityLabel);
+
+    // item ids are DelayBuffer::Format + 1
+    impl->delayStorage.addItem ("32-BIT LINES", 1);
+    impl->delayStorage.addItem ("16-BIT LINES", 2);
+    impl->delayStorage.addItem ("BFLOAT16 LINES", 3);
+    impl->delayStorage.setJustificationType (juce::Justification::centred);
+    impl->delayStorage.setTooltip ("Sample format of the grain and pre-delay lines; 16-bit halves their memory. Applies when the host next prepares the plugin");
+    impl->delayStorage.setSelectedId ((int) processor.getDelayStorage() + 1, juce::dontSendNotification);
+    impl->delayStorage.onChange = [this] { processor.setDelayStorage ((DelayBuffer::Format) (impl->delayStorage.getSelectedId() - 1)); };
+    addAndMakeVisible (impl->delayStorage);
+
+    impl->memoryLabel.setJustificationType (juce::Justification::centredRight);
+    impl->memoryLabel.setColour (juce::Label::textColourId, lnf.txtDim);
+    addAndMakeVisible (impl->memoryLabel);
+
+    // item ids are minutes + 1
+    impl->longMemory.addItem ("NO HISTORY", 1);
+    impl->longMemory.addItem ("1 MIN HISTORY", 2);
+    impl->longMemory.addItem ("5 MIN HISTORY", 6);
+    impl->longMemory.addItem ("10 MIN HISTORY", 11);
+    impl->longMemory.setJustificationType (juce::Justification::centred);
+    impl->longMemory.setTooltip ("Input kept on disk for the Memory knob to scatter grains across. Applies when the host next prepares the plugin");
+    impl->longMemory.setSelectedId (processor.getLongMemoryMinutes() + 1, juce::dontSendNotification);
+    impl->longMemory.onChange = [this] { processor.setLongMemoryMinutes (impl->longMemory.getSelectedId() - 1); };
+    addAndMakeVisible (impl->longMemory);
+
+    impl->sampleButton.setTooltip ("Sampler mode: play an uncompressed WAV or AIFF file through the grain engine instead of the input");
+    impl->sampleButton.onClick = [this]
+    {
+        juce::PopupMenu menu;
+
+        menu.addItem ("Load audio file...", [this]
+        {
+            impl->sampleChooser = std::make_unique<juce::FileChooser> ("Play an audio file through the grains", processor.getSampleFile(), "*.wav;*.aif;*.aiff");
+            impl->sampleChooser->launchAsync (juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles,
+                                              [this] (const juce::FileChooser& chooser)
+            {
+                const auto file = chooser.getResult();
+                if (file == juce::File())
+                    return;
+
+                const auto previous = processor.getSampleFile();
+                if (! processor.setSampleFile (file))
+                {
+                    processor.setSampleFile (previous);
+                    juce::AlertWindow::showMessageBoxAsync (juce::MessageBoxIconType::WarningIcon, "Starlight Drift",
+                                                            "Couldn't open " + file.getFileName() + ". Only uncompressed WAV and AIFF files can be played.");
+                }
+            });
+        });
+
+        menu.addItem ("Live input", true, processor.getSampleFile() == juce::File(), [this] { processor.setSampleFile ({}); });
+        menu.showMenuAsync (juce::PopupMenu::Options().withTargetComponent (&impl->sampleButton));
+    };
+    addAndMakeVisible (impl->sampleButton);
+
+    impl->keepFreeze.setTooltip ("Save a captured freeze with the session, so the project reopens with the same frozen texture");
+    impl->keepFreeze.setToggleState (processor.isKeepingFrozenTexture(), juce::dontSendNotification);
+    impl->keepFreeze.onClick = [this] { processor.setKeepFrozenTexture (impl->keepFreeze.getToggleState()); };
+    addAndMakeVisible (impl->keepFreeze);
+
+    impl->presetButton.setTooltip ("Browse and load presets");
+    impl->presetButton.onClick = [this]
+    {
+        juce::CallOutBox::launchAsynchronously (std::make_unique<PresetBrowser> (processor), impl->presetButton.getScreenBounds(), nullptr);
+    };
+    addAndMakeVisible (impl->presetButton);
+
+    impl->tapButton.setTooltip ("Extra grain taps reading the same delay line at their own time, rate, pitch, position and level");
+    impl->tapButton.onClick = [this]
+    {
+        juce::CallOutBox::launchAsynchronously (std::make_unique<TapEditor> (processor), impl->tapButton.getScreenBounds(), nullptr);
+    };
+    addAndMakeVisible (impl->tapButton);
+
+    impl->reverbCapture.setTooltip ("While the reverb settings hold still, play the reverb through a convolution with its own "
+                                    "captured impulse response. Takes effect when the host next prepares the plugin");
+    impl->reverbCapture.setToggleState (processor.isReverbCapture(), juce::dontSendNotification);
+    impl->reverbCapture.onClick = [this] { processor.setReverbCapture (impl->reverbCapture.getToggleState()); };
+    addAndMakeVisible (impl->reverbCapture);
+
+    impl->morphPad = std::make_unique<MorphPad> (processor, lnf.accGold);
+    addAndMakeVisible (*impl->morphPad);
+
     addAndMakeVisible (freeze);
     addAndMakeVisible (hpEnable);
     addAndMakeVisible (lpEnable);
@@ -116,9 +198,12 @@ StarlightDriftAudioProcessorEditor::StarlightDriftAudioProcessorEditor (Starligh
     attJitter = std::make_unique<SliderAttachment> (apvts, ParamIDs::jitter, jitter);
     attPitch = std::make_unique<SliderAttachment> (apvts, ParamIDs::pitchSemi, pitch);
     attSpread = std::make_unique<SliderAttachment> (apvts, ParamIDs::spread, spread);
+    attCloud = std::make_unique<SliderAttachment> (apvts, ParamIDs::cloudDensity, cloud);
+    attMemory = std::make_unique<SliderAttachment> (apvts, ParamIDs::memory, memory);
 
     attReverbSize = std::make_unique<SliderAttachment> (apvts, ParamIDs::reverbSize, reverbSize);
     attPreDelay = std::make_unique<SliderAttachment> (apvts, ParamIDs::preDelayMs, preDelay);
+    attEarly = std::make_unique<SliderAttachment> (apvts, ParamIDs::early, early);
     attTone = std::make_unique<SliderAttachment> (apvts, ParamIDs::tone, tone);
     attShimmerAmt = std::make_unique<SliderAttachment> (apvts, ParamIDs::shimmerAmt, shimmerAmt);
     attShimmerPitch = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment> (apvts, ParamIDs::shimmerPitch, shimmerPitch);
@@ -145,12 +230,12 @@ StarlightDriftAudioProcessorEditor::StarlightDriftAudioProcessorEditor (Starligh
                 s.setDoubleClickReturnValue (true, ranged->convertFrom0to1 (param->getDefaultValue()));
     };
     for (auto* s : { &drift, &air, &glass, &mix, &output, &hpFreq, &lpFreq,
-                     &inputGain, &timeMs, &feedback, &grainSize, &density, &jitter, &pitch, &spread,
-                     &reverbSize, &preDelay, &tone, &shimmerAmt, &reverbMix, &modRate, &modDepth })
+                     &inputGain, &timeMs, &feedback, &grainSize, &density, &jitter, &pitch, &spread, &cloud, &memory,
+                     &reverbSize, &preDelay, &early, &tone, &shimmerAmt, &reverbMix, &modRate, &modDepth })
         setDefault (*s);
 
     setResizable (true, true);
-    setResizeLimits (1000, 650, 1920, 1200);
+    setResizeLimits (1200, 680, 1920, 1200);
     // Non-fullscreen size
     setSize (1200, 700);
 
@@ -176,7 +261,7 @@ void StarlightDriftAudioProcessorEditor::paint (juce::Graphics& g)
     
     // Calculate Layout Areas (mirrors resized)
     auto area = getLocalBounds().reduced(24);
-    area.removeFromTop(60); // Header
+    area.removeFromTop(headerHeight);
     auto topSection = area.removeFromTop(area.getHeight() * 0.42f);
     auto bottomSection = area.reduced(0, 16);
     
@@ -215,7 +300,20 @@ void StarlightDriftAudioProcessorEditor::paint (juce::Graphics& g)
 void StarlightDriftAudioProcessorEditor::resized()
 {
     auto area = getLocalBounds().reduced(24);
-    area.removeFromTop(60);
+    // Three rows of four columns, 630 px wide: at the minimum width they start right of
+    // the title's 500 px box.
+    impl->turboBounce.setBounds (area.getRight() - 150, area.getY() + 4, 150, 24);
+    impl->cpuGuard.setBounds (area.getRight() - 150, area.getY() + 32, 150, 22);
+    impl->qualityLabel.setBounds (area.getRight() - 310, area.getY() + 32, 150, 22);
+    impl->delayStorage.setBounds (area.getRight() - 310, area.getY() + 4, 150, 22);
+    impl->memoryLabel.setBounds (area.getRight() - 470, area.getY() + 4, 150, 22);
+    impl->longMemory.setBounds (area.getRight() - 470, area.getY() + 32, 150, 22);
+    impl->sampleButton.setBounds (area.getRight() - 630, area.getY() + 4, 150, 22);
+    impl->keepFreeze.setBounds (area.getRight() - 630, area.getY() + 30, 150, 24);
+    impl->presetButton.setBounds (area.getRight() - 630, area.getY() + 60, 150, 22);
+    impl->tapButton.setBounds (area.getRight() - 470, area.getY() + 60, 150, 22);
+    impl->reverbCapture.setBounds (area.getRight() - 150, area.getY() + 58, 150, 24);
+    area.removeFromTop(headerHeight);
 
     auto waveformArea = area.removeFromTop(80);
     waveform.setBounds(waveformArea.reduced(0, 10));
@@ -235,6 +333,9 @@ void StarlightDriftAudioProcessorEditor::resized()
     air.setBounds(centerX - offset - sideSize, topSection.getCentreY() - sideSize/2, sideSize, sideSize);
     glass.setBounds(centerX + offset, topSection.getCentreY() - sideSize/2, sideSize, sideSize);
 
+    const int padSize = juce::jmin (150, topSection.getHeight() - 20, air.getX() - topSection.getX() - 20);
+    impl->morphPad->setBounds (topSection.getX(), topSection.getCentreY() - padSize / 2, padSize, padSize);
+
     // === BOTTOM MODULES ===
     int moduleSpacing = 20;
     int moduleW = (bottomSection.getWidth() - moduleSpacing * 2) / 3;
@@ -246,8 +347,8 @@ void StarlightDriftAudioProcessorEditor::resized()
     auto box3 = bottomSection.reduced(16, 40);
     
     // 1. Grains (Cyan Theme)
-    layoutKnobGrid(box1, { &inputGain, &timeMs, &feedback, &grainSize, 
-                           &density, &jitter, &pitch, &spread }, 2, 4);
+    layoutKnobGrid(box1, { &inputGain, &timeMs, &feedback, &grainSize, &density,
+                           &jitter, &pitch, &spread, &cloud, &memory }, 2, 5);
 
     // 2. Global (Orange Theme)
     int rowH = box2.getHeight() / 4;
@@ -266,9 +367,9 @@ void StarlightDriftAudioProcessorEditor::resized()
     output.setBounds(mx.reduced(5,0));
     
     // 3. Reverb (Pink Theme)
-    // Row 1: Size/Pre/Tone/Amt
+    // Row 1: Size/Pre/Early/Tone/Amt
     int rH = box3.getHeight() / 3;
-    layoutKnobGrid(box3.removeFromTop(rH), {&reverbSize, &preDelay, &tone, &shimmerAmt}, 1, 4);
+    layoutKnobGrid(box3.removeFromTop(rH), {&reverbSize, &preDelay, &early, &tone, &shimmerAmt}, 1, 5);
     
     // Row 2: Pitch Combo / Verb Mix
     auto r2 = box3.removeFromTop(rH);
@@ -284,6 +385,33 @@ void StarlightDriftAudioProcessorEditor::timerCallback()
     processor.copyLastBuffer (impl->waveformScratch);
     waveform.setBuffer (impl->waveformScratch);
 
+    const int qualityLevel = processor.getQualityLevel();
+    impl->qualityLabel.setText (qualityLevel == 0 ? juce::String ("FULL QUALITY")
+                                                  : "SAVING CPU " + juce::String (qualityLevel) + "/" + juce::String (QualityGovernor::maxLevel),
+                                juce::dontSendNotification);
+    impl->qualityLabel.setColour (juce::Label::textColourId, qualityLevel == 0 ? lnf.txtDim : lnf.accOrange);
+
+    impl->memoryLabel.setText ("MEMORY " + juce::File::descriptionOfSizeInBytes ((juce::int64) processor.getMemoryFootprint()).toUpperCase(),
+                               juce::dontSendNotification);
+
+    // the state can bring a different file in while the editor is open
+    const auto sampleFile = processor.getSampleFile();
+    impl->sampleButton.setButtonText (sampleFile == juce::File() ? juce::String ("LIVE INPUT") : sampleFile.getFileName().toUpperCase());
+
+    // the state can bring other snapshots in too
+    impl->morphPad->repaint();
+
+    // hosts change programs too
+    impl->presetButton.setButtonText (processor.getProgramName (processor.getCurrentProgram()).toUpperCase());
+
+    // and the state can bring taps in
+    const auto numTaps = processor.getTaps().size();
+    impl->tapButton.setButtonText (numTaps == 0 ? juce::String ("NO TAPS") : numTaps == 1 ? juce::String ("1 TAP") : juce::String (numTaps) + " TAPS");
+
+    // and the reverb capture setting; says so while the captured response is playing
+    impl->reverbCapture.setToggleState (processor.isReverbCapture(), juce::dontSendNotification);
+    impl->reverbCapture.setButtonText (processor.isReverbConvolving() ? "IR REVERB LIVE" : "IR REVERB");
+
     // const auto wrapper = processor.getWrapperType();
     // if (wrapper != juce::AudioProcessor::wrapperType_Standalone)
     // {
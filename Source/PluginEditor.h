@@ -6,6 +6,9 @@
 #include "UI/LookAndFeel.h"
 #include "UI/LockableSlider.h"
 #include "UI/LockableButton.h"
+#include "UI/MorphPad.h"
+#include "UI/PresetBrowser.h"
+#include "UI/TapEditor.h"
 #include "UI/WaveformComponent.h"
 
 class StarlightDriftAudioProcessorEditor final : public juce::AudioProcessorEditor, public juce::Timer
@@ -54,10 +57,13 @@ private:
     LockableSlider jitter;
     LockableSlider pitch;
     LockableSlider spread;
+    LockableSlider cloud;
+    LockableSlider memory;
 
     // Reverb controls
     LockableSlider reverbSize;
     LockableSlider preDelay;
+    LockableSlider early;
     LockableSlider tone;
     LockableSlider shimmerAmt;
     juce::ComboBox shimmerPitch;
@@ -79,8 +85,8 @@ private:
     std::unique_ptr<SliderAttachment> attMix, attOutput;
     std::unique_ptr<ButtonAttachment> attHpEnable, attLpEnable;
     std::unique_ptr<SliderAttachment> attHpFreq, attLpFreq;
-    std::unique_ptr<SliderAttachment> attInputGain, attTimeMs, attFeedback, attGrainSize, attDensity, attJitter, attPitch, attSpread;
-    std::unique_ptr<SliderAttachment> attReverbSize, attPreDelay, attTone, attShimmerAmt, attReverbMix;
+    std::unique_ptr<SliderAttachment> attInputGain, attTimeMs, attFeedback, attGrainSize, attDensity, attJitter, attPitch, attSpread, attCloud, attMemory;
+    std::unique_ptr<SliderAttachment> attReverbSize, attPreDelay, attEarly, attTone, attShimmerAmt, attReverbMix;
     std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> attShimmerPitch;
     std::unique_ptr<SliderAttachment> attModRate, attModDepth;
 
@@ -1,47 +1,77 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
-namespace ParamIDs
-{
-    static constexpr auto inputGain = "inputGain";
-    static constexpr auto delayTimeMs = "delayTimeMs";
-    static constexpr auto feedback = "feedback";
-    static constexpr auto grainSizeMs = "grainSizeMs";
-    static constexpr auto density = "density";
-    static constexpr auto jitter = "jitter";
-    static constexpr auto pitchSemi = "pitchSemi";
-    static constexpr auto spread = "spread";
-
-    static constexpr auto reverbSize = "reverbSize";
-    static constexpr auto preDelayMs = "preDelayMs";
-    static constexpr auto tone = "tone";
-    static constexpr auto shimmerAmt = "shimmerAmt";
-    static constexpr auto shimmerPitch = "shimmerPitch";
-    static constexpr auto reverbMix = "reverbMix";
-
-    static constexpr auto mix = "mix";
-    static constexpr auto outputGain = "outputGain";
-    static constexpr auto hpEnable = "hpEnable";
-    static constexpr auto hpFreq = "hpFreq";
-    static constexpr auto lpEnable = "lpEnable";
-    static constexpr auto lpFreq = "lpFreq";
-
-    static constexpr auto drift = "drift";
-    static constexpr auto modRate = "modRate";
-    static constexpr auto modDepth = "modDepth";
-    static constexpr auto freeze = "freeze";
-
-    static constexpr auto air = "air";
-    static constexpr auto glass = "glass";
-}
+#include <limits>
+
+// Decodes a frozen texture saved with the state and hands it to the engine, so loading a
+// session doesn't wait for it. The decode checks threadShouldExit() as it goes.
+class StarlightDriftAudioProcessor::TextureLoader final : public juce::Thread
+{
+public:
+    TextureLoader (StarlightDriftAudioProcessor& p, juce::MemoryBlock data)
+        : juce::Thread ("Starlight texture loader"), processor (p), encoded (std::move (data))
+    {
+        startThread();
+    }
 
-static float dbToLin (float db) { return juce::Decibels::decibelsToGain (db); }
+    ~TextureLoader() override { stopThread (2000); }
+
+    // The texture as it was saved, for saving again before it's been decoded.
+    const juce::MemoryBlock& getEncoded() const noexcept { return encoded; }
+
+    void run() override
+    {
+        auto texture = FrozenTexture::readFrom (encoded.getData(), encoded.getSize());
+
+        if (texture != nullptr && ! threadShouldExit())
+            processor.restoreFrozenTexture (std::move (texture));
+    }
+
+private:
+    StarlightDriftAudioProcessor& processor;
+    juce::MemoryBlock encoded;
+
+    JUCE_DECLARE_NON_COPYABLE (TextureLoader)
+};
 
 StarlightDriftAudioProcessor::StarlightDriftAudioProcessor()
     : AudioProcessor (BusesProperties().withInput ("Input", juce::AudioChannelSet::stereo(), true)
                                      .withOutput ("Output", juce::AudioChannelSet::stereo(), true)),
       apvts (*this, nullptr, "PARAMS", createParameterLayout())
 {
+    jassert (getParameters().size() == ParamIndex::count);
+
+    for (int i = 0; i < ParamIndex::count; ++i)
+        rawParams[(size_t) i] = apvts.getRawParameterValue (paramSpecs[i].id);
+
+    presets = PresetBank::open (getPresetBankFile());
+    if (presets == nullptr)
+        presets = PresetBank::createFactoryBank();
+
+    // picks up program changes made off the message thread
+    startTimerHz (30);
+
+   #if STARLIGHT_TRACING
+    engine.setTraceRecorder (&trace);
+
+    for (auto* p : getParameters())
+    {
+        if (auto* withId = dynamic_cast<juce::AudioProcessorParameterWithID*> (p))
+            tracedParamIds.add (withId->getParameterID());
+        else
+            tracedParamIds.add (p->getName (64));
+
+        tracedParamValues.push_back (p->getValue());
+    }
+
+    // Hosts give us no UI hook for this, so allow arming from the environment.
+    const auto traceDir = juce::SystemStats::getEnvironmentVariable ("STARLIGHT_TRACE_DIR", {});
+    if (traceDir.isNotEmpty())
+        startTraceRecording (juce::File (traceDir).getChildFile ("starlight-trace-"
+                                                                 + juce::Time::getCurrentTime().formatted ("%Y%m%d-%H%M%S")
+                                                                 + "-" + juce::String::toHexString (juce::Random::getSystemRandom().nextInt())
+                                                                 + ".json"));
+   #endif
 }
 
 juce::AudioProcessorValueTreeState::ParameterLayout StarlightDriftAudioProcessor::createParameterLayout()
@@ -50,61 +80,85 @@ juce::AudioProcessorValueTreeState::ParameterLayout StarlightDriftAudioProcessor
 
     std::vector<std::unique_ptr<RangedAudioParameter>> params;
 
-    params.push_back (std::make_unique<AudioParameterFloat> (ParamIDs::inputGain, "Input", NormalisableRange<float> (-24.0f, 24.0f, 0.01f), 0.0f));
-    params.push_back (std::make_unique<AudioParameterFloat> (ParamIDs::delayTimeMs, "Time", NormalisableRange<float> (1.0f, 2000.0f, 0.01f, 0.35f), 450.0f));
-    params.push_back (std::make_unique<AudioParameterFloat> (ParamIDs::feedback, "Feedback", NormalisableRange<float> (0.0f, 0.95f, 0.0001f), 0.35f));
-    params.push_back (std::make_unique<AudioParameterFloat> (ParamIDs::grainSizeMs, "Size", NormalisableRange<float> (10.0f, 250.0f, 0.01f, 0.5f), 70.0f));
-    params.push_back (std::make_unique<AudioParameterFloat> (ParamIDs::density, "Density", NormalisableRange<float> (0.2f, 40.0f, 0.01f, 0.5f), 40.0f));
-    params.push_back (std::make_unique<AudioParameterFloat> (ParamIDs::jitter, "Jitter", NormalisableRange<float> (0.0f, 1.0f, 0.0001f), 0.15f));
-    params.push_back (std::make_unique<AudioParameterFloat> (ParamIDs::pitchSemi, "Pitch", NormalisableRange<float> (-12.0f, 12.0f, 0.01f), 0.0f));
-    params.push_back (std::make_unique<AudioParameterFloat> (ParamIDs::spread, "Spread", NormalisableRange<float> (0.0f, 1.0f, 0.0001f), 0.35f));
-
-    params.push_back (std::make_unique<AudioParameterFloat> (ParamIDs::reverbSize, "Reverb Size", NormalisableRange<float> (0.0f, 1.0f, 0.0001f), 0.55f));
-    params.push_back (std::make_unique<AudioParameterFloat> (ParamIDs::preDelayMs, "PreDelay", NormalisableRange<float> (0.0f, 250.0f, 0.01f, 0.5f), 20.0f));
-    params.push_back (std::make_unique<AudioParameterFloat> (ParamIDs::tone, "Tone", NormalisableRange<float> (0.0f, 1.0f, 0.0001f), 0.55f));
-    params.push_back (std::make_unique<AudioParameterFloat> (ParamIDs::shimmerAmt, "Shimmer", NormalisableRange<float> (0.0f, 1.0f, 0.0001f), 0.25f));
-    params.push_back (std::make_unique<AudioParameterChoice> (ParamIDs::shimmerPitch, "Shimmer Pitch", StringArray { "+5", "+7", "+12", "+24" }, 2));
-    params.push_back (std::make_unique<AudioParameterFloat> (ParamIDs::reverbMix, "Reverb Mix", NormalisableRange<float> (0.0f, 1.0f, 0.0001f), 1.0f));
-
-    params.push_back (std::make_unique<AudioParameterFloat> (ParamIDs::mix, "Mix", NormalisableRange<float> (0.0f, 1.0f, 0.0001f), 1.0f));
-    params.push_back (std::make_unique<AudioParameterFloat> (ParamIDs::outputGain, "Output", NormalisableRange<float> (-24.0f, 24.0f, 0.01f), 0.0f));
-    params.push_back (std::make_unique<AudioParameterBool> (ParamIDs::hpEnable, "HP Enable", false));
-    params.push_back (std::make_unique<AudioParameterFloat> (ParamIDs::hpFreq, "HP Freq", NormalisableRange<float> (20.0f, 20000.0f, 0.01f, 0.5f), 120.0f));
-    params.push_back (std::make_unique<AudioParameterBool> (ParamIDs::lpEnable, "LP Enable", false));
-    params.push_back (std::make_unique<AudioParameterFloat> (ParamIDs::lpFreq, "LP Freq", NormalisableRange<float> (20.0f, 20000.0f, 0.01f, 0.5f), 14000.0f));
-
-    params.push_back (std::make_unique<AudioParameterFloat> (ParamIDs::drift, "Drift", NormalisableRange<float> (0.0f, 1.0f, 0.0001f), 0.25f));
-    params.push_back (std::make_unique<AudioParameterFloat> (ParamIDs::modRate, "Mod Rate", NormalisableRange<float> (0.01f, 4.0f, 0.0001f, 0.5f), 0.35f));
-    params.push_back (std::make_unique<AudioParameterFloat> (ParamIDs::modDepth, "Mod Depth", NormalisableRange<float> (0.0f, 1.0f, 0.0001f), 0.25f));
-    params.push_back (std::make_unique<AudioParameterBool> (ParamIDs::freeze, "Freeze", false));
-
-    params.push_back (std::make_unique<AudioParameterFloat> (ParamIDs::air, "Air", NormalisableRange<float> (0.0f, 1.0f, 0.0001f), 0.0f));
-    params.push_back (std::make_unique<AudioParameterFloat> (ParamIDs::glass, "Glass", NormalisableRange<float> (0.0f, 1.0f, 0.0001f), 0.0f));
+    for (const auto& spec : paramSpecs)
+    {
+        switch (spec.kind)
+        {
+            case ParamSpec::Kind::continuous:
+                params.push_back (std::make_unique<AudioParameterFloat> (spec.id, spec.name,
+                                                                         NormalisableRange<float> (spec.minValue, spec.maxValue, spec.step, spec.skew),
+                                                                         spec.defaultValue));
+                break;
+
+            case ParamSpec::Kind::toggle:
+                params.push_back (std::make_unique<AudioParameterBool> (spec.id, spec.name, spec.defaultValue > 0.5f));
+                break;
+
+            case ParamSpec::Kind::choice:
+                params.push_back (std::make_unique<AudioParameterChoice> (spec.id, spec.name,
+                                                                          StringArray::fromTokens (spec.choices, ",", {}),
+                                                                          (int) spec.defaultValue));
+                break;
+        }
+    }
 
     return { params.begin(), params.end() };
 }
 
 void StarlightDriftAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    juce::dsp::ProcessSpec spec;
-    spec.sampleRate = sampleRate;
-    spec.maximumBlockSize = (juce::uint32) samplesPerBlock;
-    spec.numChannels = 2;
-
-    granular.prepare (spec);
-    shimmer.prepare (spec);
-
-    limiter.prepare (spec);
-    limiter.setThreshold (-0.5f);
-
-    stereoBuffer.setSize (2, samplesPerBlock);
-    wetBuffer.setSize (2, samplesPerBlock);
     lastBuffer.setSize (2, samplesPerBlock);
+    lastBufferCapacity = samplesPerBlock;
+
+    // Offline there's no deadline to meet, so the CPU governor stays out of it and the cloud
+    // never drops grains and sums them in a fixed order; turbo mode additionally pipelines the chain over two threads and uses
+    // the cloud's workers. Both give the same output as rendering on one thread.
+    const bool offline = isNonRealtime();
+    const bool turbo = offline && offlineTurbo.load();
+
+    engine.setPipelined (turbo);
+    engine.setCloudWorkers (offline && ! turbo ? 0 : -1);
+    engine.setGroupWorkers (offline && ! turbo ? 0 : -1);
+    engine.setCloudBudget (offline ? 0.0f : 0.5f);
+    engine.setGovernorEnabled (! offline);
+    engine.setDelayStorage (getDelayStorage());
+    engine.setLongMemory (60.0 * getLongMemoryMinutes(), offline);
+    engine.setReverbCapture (! offline && reverbCapture.load());
+
+    // a render starts with the texture the state was loaded with, whenever the decode finishes
+    if (offline && textureLoader != nullptr)
+        textureLoader->waitForThreadToExit (-1);
+
+    const juce::ScopedLock tl (textureLock);
+
+    // a freeze survives being prepared again, even at another rate, the way a saved one is restored
+    if (auto live = engine.getFrozenTexture())
+    {
+        savedTexture = std::move (live);
+        savedTextureBlock = std::numeric_limits<juce::uint64>::max();
+    }
 
-    wetHP.prepare (spec);
-    wetLP.prepare (spec);
+    {
+        // the engine isn't running, so nothing can be reading a replaced sample file
+        const juce::ScopedLock sl (sampleSourceLock);
+        retiredSources.clear();
+    }
 
-    updateDSPFromParams();
+    engine.prepare (sampleRate, samplesPerBlock, getTotalNumOutputChannels(),
+                    StarlightEngine::makeChannelGroups (getChannelLayoutOfBus (false, 0)));
+    setLatencySamples (engine.getLatencySamples());
+    memoryFootprint = engine.getMemoryBytes();
+    engine.setParameters (getParameterSnapshot());
+    lastBlockParams = getParameterSnapshot();
+    subBlockChannels.assign ((size_t) juce::jmax (getTotalNumInputChannels(), getTotalNumOutputChannels()), nullptr);
+    numParameterEvents = 0;
+
+    // the engine has dropped loops it hadn't picked up, and isn't running
+    frozenLoops.reset();
+    retiredLoops.clear();
+
+    if (isSavedTexturePending())
+        installSavedTexture();
 }
 
 void StarlightDriftAudioProcessor::releaseResources() {}
@@ -117,125 +171,114 @@ bool StarlightDriftAudioProcessor::isBusesLayoutSupported (const BusesLayout& la
     if (in.isDisabled() || out.isDisabled())
         return false;
 
+    // mono in, stereo out: the input is spread over a stereo chain for width
+    if (in == juce::AudioChannelSet::mono() && out == juce::AudioChannelSet::stereo())
+        return true;
+
     if (in != out)
         return false;
 
-    return in == juce::AudioChannelSet::mono() || in == juce::AudioChannelSet::stereo();
+    for (const auto& supported : { juce::AudioChannelSet::mono(),
+                                   juce::AudioChannelSet::stereo(),
+                                   juce::AudioChannelSet::create5point1(),
+                                   juce::AudioChannelSet::create7point1(),
+                                   juce::AudioChannelSet::create7point1point4(),
+                                   juce::AudioChannelSet::ambisonic (1) })
+        if (in == supported)
+            return true;
+
+    return false;
 }
 
 double StarlightDriftAudioProcessor::getTailLengthSeconds() const
 {
-    return 20.0;
+    // what the engine last played, after the morph and the routings
+    if (const auto played = engine.getTailLengthSeconds(); played >= 0.0)
+        return played;
+
+    // nothing played since prepareToPlay(): the parameters as set, through the routings
+    auto snapshot = getParameterSnapshot();
+    float shimmerInterval = 12.0f;
+    getModulation().modulate (snapshot, shimmerInterval);
+
+    float longestTapMs = 0.0f;
+    for (const auto& tap : getTaps())
+        longestTapMs = juce::jmax (longestTapMs, tap.delayTimeMs);
+
+    return StarlightEngine::computeTailLengthSeconds (snapshot, longestTapMs);
 }
 
 bool StarlightDriftAudioProcessor::isParamLocked (const juce::String& paramId) const
 {
-    return locksState.getProperty (paramId, false);
+    const int i = ParameterSnapshot::indexOf (paramId);
+    return i >= 0 && (lockMask.load() & (1u << i)) != 0;
 }
 
 void StarlightDriftAudioProcessor::setParamLocked (const juce::String& paramId, bool locked)
 {
-    locksState.setProperty (paramId, locked, nullptr);
+    const int i = ParameterSnapshot::indexOf (paramId);
+    if (i < 0)
+        return;
+
+    if (locked)
+        lockMask.fetch_or (1u << i);
+    else
+        lockMask.fetch_and (~(1u << i));
 }
 
+#if STARLIGHT_TRACING
+bool StarlightDriftAudioProcessor::startTraceRecording (const juce::File& file)
+{
+    file.getParentDirectory().createDirectory();
+    return trace.start (file);
+}
+
+void StarlightDriftAudioProcessor::stopTraceRecording()
+{
+    trace.stop();
+}
+
+void StarlightDriftAudioProcessor::traceParameterChanges()
+{
+    if (! trace.isRecording())
+        return;
+
+    const auto& params = getParameters();
+    for (int i = 0; i < params.size() && i < (int) tracedParamValues.size(); ++i)
+    {
+        const float v = params[i]->getValue();
+        if (v != tracedParamValues[(size_t) i])
+        {
+            tracedParamValues[(size_t) i] = v;
+            trace.record (TraceRecorder::Phase::counter, tracedParamIds[i].toRawUTF8(), v);
+        }
+    }
+}
+#endif
+
 void StarlightDriftAudioProcessor::copyLastBuffer (juce::AudioBuffer<float>& dest) const
 {
+    STARLIGHT_RT_NOTE_LOCK ("StarlightDriftAudioProcessor::lastBufferLock");
     const juce::SpinLock::ScopedLockType sl (lastBufferLock);
     dest.makeCopyOf (lastBuffer, true);
 }
 
-void StarlightDriftAudioProcessor::updateDSPFromParams()
-{
-    const auto inputDb = apvts.getRawParameterValue (ParamIDs::inputGain)->load();
-    const auto delayTimeMs = apvts.getRawParameterValue (ParamIDs::delayTimeMs)->load();
-    const auto feedback = apvts.getRawParameterValue (ParamIDs::feedback)->load();
-    const auto grainSizeMs = apvts.getRawParameterValue (ParamIDs::grainSizeMs)->load();
-    const auto density = apvts.getRawParameterValue (ParamIDs::density)->load();
-    const auto jitter = apvts.getRawParameterValue (ParamIDs::jitter)->load();
-    const auto pitchSemi = apvts.getRawParameterValue (ParamIDs::pitchSemi)->load();
-    const auto spread = apvts.getRawParameterValue (ParamIDs::spread)->load();
-
-    const auto reverbSize = apvts.getRawParameterValue (ParamIDs::reverbSize)->load();
-    const auto preDelayMs = apvts.getRawParameterValue (ParamIDs::preDelayMs)->load();
-    const auto tone = apvts.getRawParameterValue (ParamIDs::tone)->load();
-    const auto shimmerAmt = apvts.getRawParameterValue (ParamIDs::shimmerAmt)->load();
-    const auto shimmerPitchChoice = (int) apvts.getRawParameterValue (ParamIDs::shimmerPitch)->load();
-    const auto reverbMix = apvts.getRawParameterValue (ParamIDs::reverbMix)->load();
-
-    const auto drift = apvts.getRawParameterValue (ParamIDs::drift)->load();
-    const auto modRate = apvts.getRawParameterValue (ParamIDs::modRate)->load();
-    const auto modDepth = apvts.getRawParameterValue (ParamIDs::modDepth)->load();
-    const auto freeze = apvts.getRawParameterValue (ParamIDs::freeze)->load() > 0.5f;
-
-    const auto air = apvts.getRawParameterValue (ParamIDs::air)->load();
-    const auto glass = apvts.getRawParameterValue (ParamIDs::glass)->load();
-
-    const auto densityEff = isParamLocked (ParamIDs::density) ? density
-                            : density * (1.0f + 0.8f * air);
-    const auto toneEff = isParamLocked (ParamIDs::tone) ? tone
-                         : juce::jlimit (0.0f, 1.0f, tone + 0.25f * air);
-    const auto shimmerAmtEff = isParamLocked (ParamIDs::shimmerAmt) ? shimmerAmt
-                              : juce::jlimit (0.0f, 1.0f, shimmerAmt + 0.35f * air);
-    const auto grainSizeEff = isParamLocked (ParamIDs::grainSizeMs) ? grainSizeMs
-                              : grainSizeMs * (1.0f - 0.35f * glass);
-    const auto spreadEff = isParamLocked (ParamIDs::spread) ? spread
-                         : juce::jlimit (0.0f, 1.0f, spread + 0.5f * glass);
-    const auto pitchSemiEff = isParamLocked (ParamIDs::pitchSemi) ? pitchSemi
-                            : pitchSemi + 2.0f * glass;
-
-    GranularDelay::Params g;
-    g.inputGain = dbToLin (inputDb);
-    g.delayTimeMs = delayTimeMs;
-    g.feedback = feedback;
-    g.grainSizeMs = grainSizeEff;
-    g.density = densityEff;
-    g.jitter = jitter;
-    g.pitchSemitones = pitchSemiEff;
-    g.spread = spreadEff;
-    g.drift = drift;
-    g.modRateHz = modRate;
-    g.modDepth = modDepth;
-    g.freeze = freeze;
-
-    granular.setParams (g);
-
-    ShimmerReverb::Params r;
-    r.roomSize = reverbSize;
-    r.preDelayMs = preDelayMs;
-    r.tone = toneEff;
-    r.shimmerAmount = shimmerAmtEff;
-    r.reverbMix = reverbMix;
-    r.drift = drift;
-    r.modRateHz = modRate;
-    r.modDepth = modDepth;
-    r.freeze = freeze;
-    const float baseShimmerPitch = (shimmerPitchChoice == 0 ? 5.0f
-                      : shimmerPitchChoice == 1 ? 7.0f
-                      : shimmerPitchChoice == 2 ? 12.0f
-                                               : 24.0f);
-    r.pitchSemitones = baseShimmerPitch + (glass * 12.0f);
-
-    shimmer.setParams (r);
-
-    const bool hpEnabled = apvts.getRawParameterValue (ParamIDs::hpEnable)->load() > 0.5f;
-    const bool lpEnabled = apvts.getRawParameterValue (ParamIDs::lpEnable)->load() > 0.5f;
-    const float hpFreq = apvts.getRawParameterValue (ParamIDs::hpFreq)->load();
-    const float lpFreq = apvts.getRawParameterValue (ParamIDs::lpFreq)->load();
-
-    if (hpEnabled)
-    {
-        *wetHP.state = *juce::dsp::IIR::Coefficients<float>::makeHighPass (getSampleRate(), hpFreq);
-    }
+ParameterSnapshot StarlightDriftAudioProcessor::getParameterSnapshot() const
+{
+    ParameterSnapshot snapshot;
 
-    if (lpEnabled)
-    {
-        *wetLP.state = *juce::dsp::IIR::Coefficients<float>::makeLowPass (getSampleRate(), lpFreq);
-    }
+    for (int i = 0; i < ParamIndex::count; ++i)
+        snapshot.set (i, rawParams[(size_t) i]->load());
+
+    snapshot.lockMask = lockMask.load();
+    return snapshot;
 }
 
 void StarlightDriftAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&)
 {
     juce::ScopedNoDenormals noDenormals;
+    STARLIGHT_RT_AUDIO_THREAD_SCOPE;
+    STARLIGHT_TRACE_SCOPE (&trace, "processBlock");
 
     const int numSamples = buffer.getNumSamples();
     if (numSamples <= 0)
@@ -243,79 +286,175 @@ void StarlightDriftAudioProcessor::processBlock (juce::AudioBuffer<float>& buffe
 
     const int totalNumInputChannels = getTotalNumInputChannels();
     const int totalNumOutputChannels = getTotalNumOutputChannels();
+    jassert (buffer.getNumChannels() >= engine.getNumChannels());
 
-    for (int ch = totalNumInputChannels; ch < totalNumOutputChannels; ++ch)
-        buffer.clear (ch, 0, numSamples);
+    // mono in, stereo out: both sides of the stereo chain start from the one input
+    if (totalNumInputChannels == 1 && totalNumOutputChannels == 2)
+        buffer.copyFrom (1, 0, buffer, 0, 0, numSamples);
+    else
+        for (int ch = totalNumInputChannels; ch < totalNumOutputChannels; ++ch)
+            buffer.clear (ch, 0, numSamples);
 
-    stereoBuffer.setSize (2, numSamples, false, false, true);
-    stereoBuffer.clear();
-
-    if (totalNumInputChannels > 0)
+    // Capture input for waveform display (always stereo for the UI).
+    // Never wait for the editor here: if it holds the lock, skip this block's snapshot.
     {
-        stereoBuffer.copyFrom (0, 0, buffer, 0, 0, numSamples);
-
-        if (totalNumInputChannels > 1)
-            stereoBuffer.copyFrom (1, 0, buffer, 1, 0, numSamples);
-        else
-            stereoBuffer.copyFrom (1, 0, buffer, 0, 0, numSamples);
+        const juce::SpinLock::ScopedTryLockType sl (lastBufferLock);
+        if (sl.isLocked())
+        {
+            // a host block bigger than announced keeps its newest samples; growing would allocate
+            const int numToCopy = juce::jmin (numSamples, lastBufferCapacity);
+            const int start = numSamples - numToCopy;
+            lastBuffer.setSize (2, numToCopy, false, false, true);
+            lastBuffer.copyFrom (0, 0, buffer, 0, start, numToCopy);
+            lastBuffer.copyFrom (1, 0, buffer, juce::jmin (1, buffer.getNumChannels() - 1), start, numToCopy);
+        }
     }
 
-    // Capture input for waveform display (always stereo for the UI)
+   #if STARLIGHT_TRACING
+    traceParameterChanges();
+   #endif
+
+    auto snapshot = getParameterSnapshot();
+    takeProgramChanges (snapshot);
+
+    if (numParameterEvents > 0 && buffer.getNumChannels() <= (int) subBlockChannels.size())
+        processSubBlocks (buffer, snapshot);
+    else
+        processEngine (buffer.getArrayOfWritePointers(), numSamples, snapshot);
+
+    numParameterEvents = 0;
+    lastBlockParams = snapshot;
+}
+
+void StarlightDriftAudioProcessor::addParameterEvent (int sampleOffset, int paramIndex, float value) noexcept
+{
+    if (! juce::isPositiveAndBelow (paramIndex, (int) ParamIndex::count) || numParameterEvents >= maxParameterEvents)
+        return;
+
+    // kept in order, and in arrival order at the same offset
+    int i = numParameterEvents++;
+    for (; i > 0 && parameterEvents[(size_t) i - 1].sampleOffset > sampleOffset; --i)
+        parameterEvents[(size_t) i] = parameterEvents[(size_t) i - 1];
+
+    const auto& spec = paramSpecs[paramIndex];
+    parameterEvents[(size_t) i] = { juce::jmax (0, sampleOffset), paramIndex, juce::jlimit (spec.minValue, spec.maxValue, value) };
+}
+
+// Splits the block at its parameter events. Parameters with events start from where the
+// last block left them and step through their events; the engine's smoothing glides Mix and
+// Output between them, and grains pick up the settings in force when they start.
+void StarlightDriftAudioProcessor::processSubBlocks (juce::AudioBuffer<float>& buffer, const ParameterSnapshot& blockParams)
+{
+    const int numSamples = buffer.getNumSamples();
+    auto params = blockParams;
+
+    for (int e = 0; e < numParameterEvents; ++e)
     {
-        const juce::SpinLock::ScopedLockType sl (lastBufferLock);
-        lastBuffer.setSize (2, numSamples, false, false, true);
-        lastBuffer.makeCopyOf (stereoBuffer, true);
+        const int index = parameterEvents[(size_t) e].index;
+        if (! params.isLocked (index))
+            params.set (index, lastBlockParams.get (index));
     }
 
-    updateDSPFromParams();
+    int next = 0;
+
+    for (int start = 0; start < numSamples;)
+    {
+        for (; next < numParameterEvents && parameterEvents[(size_t) next].sampleOffset < start + minSubBlockSamples; ++next)
+            if (! params.isLocked (parameterEvents[(size_t) next].index))
+                params.set (parameterEvents[(size_t) next].index, parameterEvents[(size_t) next].value);
 
-    wetBuffer.setSize (2, numSamples, false, false, true);
-    wetBuffer.clear();
+        const int end = next < numParameterEvents ? juce::jmin (numSamples, parameterEvents[(size_t) next].sampleOffset) : numSamples;
 
-    granular.process (stereoBuffer, wetBuffer);
-    shimmer.process (wetBuffer);
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+            subBlockChannels[(size_t) ch] = buffer.getWritePointer (ch, start);
 
-    const bool hpEnabled = apvts.getRawParameterValue (ParamIDs::hpEnable)->load() > 0.5f;
-    const bool lpEnabled = apvts.getRawParameterValue (ParamIDs::lpEnable)->load() > 0.5f;
+        processEngine (subBlockChannels.data(), end - start, params);
+        start = end;
+    }
+}
 
-    juce::dsp::AudioBlock<float> wetBlock (wetBuffer);
-    if (hpEnabled)
+void StarlightDriftAudioProcessor::processEngine (float* const* channels, int numSamples, ParameterSnapshot params)
+{
     {
-        wetHP.process (juce::dsp::ProcessContextReplacing<float> (wetBlock));
+        STARLIGHT_TRACE_SCOPE (&trace, "setParameters");
+        morph.apply (params);
+        engine.setParameters (params);
     }
 
-    if (lpEnabled)
+    engine.process (channels, numSamples);
+}
+
+juce::File StarlightDriftAudioProcessor::getPresetBankFile()
+{
+    return juce::File::getSpecialLocation (juce::File::userApplicationDataDirectory)
+               .getChildFile ("Starlight Drift").getChildFile ("Presets.sdbank");
+}
+
+void StarlightDriftAudioProcessor::setCurrentProgram (int index)
+{
+    if (! juce::isPositiveAndBelow (index, presets->getNumPresets()))
+        return;
+
+    const auto serial = programSerial.fetch_add (1) + 1;
+    const auto request = ((juce::uint64) serial << 32) | (juce::uint32) index;
+
+    // a caller that lost the race to a newer change leaves it in place
+    auto latest = requestedProgram.load();
+    while ((juce::uint32) (latest >> 32) < serial)
     {
-        wetLP.process (juce::dsp::ProcessContextReplacing<float> (wetBlock));
+        if (requestedProgram.compare_exchange_weak (latest, request))
+        {
+            currentProgram = index;
+            break;
+        }
     }
 
-    const float mix = apvts.getRawParameterValue (ParamIDs::mix)->load();
-    const float outGain = dbToLin (apvts.getRawParameterValue (ParamIDs::outputGain)->load());
+    // hosts may change programs from the audio thread, where the parameters can't be set;
+    // the timer gets to those
+    if (juce::MessageManager::existsAndIsCurrentThread() || juce::MessageManager::getInstanceWithoutCreating() == nullptr)
+        timerCallback();
+}
 
-    for (int ch = 0; ch < 2; ++ch)
-    {
-        auto* dry = stereoBuffer.getWritePointer (ch);
-        auto* wet = wetBuffer.getReadPointer (ch);
+// Message thread: brings the parameters in line with the latest program change.
+void StarlightDriftAudioProcessor::timerCallback()
+{
+    const auto request = requestedProgram.load();
+    const auto serial = (juce::uint32) (request >> 32);
 
-        for (int i = 0; i < numSamples; ++i)
-            dry[i] = (1.0f - mix) * dry[i] + mix * wet[i];
-    }
+    if (serial > appliedProgramSerial.load())
+        applyProgram ((int) (juce::uint32) request, serial);
+}
+
+void StarlightDriftAudioProcessor::applyProgram (int index, juce::uint32 serial)
+{
+    const auto preset = presets->getParameters (index);
+    const auto locks = lockMask.load();
 
-    stereoBuffer.applyGain (outGain);
+    for (int i = 0; i < ParamIndex::count; ++i)
+        if ((locks & (1u << i)) == 0)
+            if (auto* param = apvts.getParameter (paramSpecs[i].id))
+                param->setValueNotifyingHost (param->convertTo0to1 (preset.get (i)));
 
-    juce::dsp::AudioBlock<float> block (stereoBuffer);
-    limiter.process (juce::dsp::ProcessContextReplacing<float> (block));
+    if (serial > appliedProgramSerial.load())
+        appliedProgramSerial = serial;
+}
 
-    if (totalNumOutputChannels == 1)
-    {
-        buffer.copyFrom (0, 0, stereoBuffer, 0, 0, numSamples);
-        buffer.addFrom (0, 0, stereoBuffer, 1, 0, numSamples, 1.0f);
-        buffer.applyGain (0.5f);
+// Audio thread: plays the latest program change in place of the parameters until they've
+// been updated to match it, so a change lands on the next block whatever the message thread is doing.
+void StarlightDriftAudioProcessor::takeProgramChanges (ParameterSnapshot& snapshot) noexcept
+{
+    const auto request = requestedProgram.load();
+    const auto serial = (juce::uint32) (request >> 32);
+
+    if (serial > latestProgram.serial)
+        latestProgram = { presets->getParameters ((int) (juce::uint32) request), serial };
+
+    if (latestProgram.serial <= appliedProgramSerial.load())
         return;
-    }
 
-    buffer.copyFrom (0, 0, stereoBuffer, 0, 0, numSamples);
-    buffer.copyFrom (1, 0, stereoBuffer, 1, 0, numSamples);
+    for (int i = 0; i < ParamIndex::count; ++i)
+        if (! snapshot.isLocked (i))
+            snapshot.set (i, latestProgram.params.get (i));
 }
 
 juce::AudioProcessorEditor* StarlightDriftAudioProcessor::createEditor()
@@ -323,29 +462,180 @@ juce::AudioProcessorEditor* StarlightDriftAudioProcessor::createEditor()
     return new StarlightDriftAudioProcessorEditor (*this);
 }
 
+PluginState StarlightDriftAudioProcessor::captureState() const
+{
+    PluginState state;
+    state.params = getParameterSnapshot();
+    state.offlineTurbo = offlineTurbo.load();
+    state.delayStorage = delayStorage.load();
+    state.longMemoryMinutes = longMemoryMinutes.load();
+    state.keepFrozenTexture = keepFrozenTexture.load();
+    state.sampleFile = getSampleFile().getFullPathName();
+    state.program = currentProgram.load();
+    state.morph = morph.getSlots();
+    state.routings = getModulation().getRoutings();
+    state.taps = getTaps();
+    state.reverbCapture = reverbCapture.load();
+    return state;
+}
+
 void StarlightDriftAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    juce::ValueTree state ("StarlightDriftState");
-    state.appendChild (apvts.copyState(), nullptr);
-    state.appendChild (locksState, nullptr);
+    const auto state = captureState();
 
-    juce::MemoryOutputStream stream (destData, false);
-    state.writeToStream (stream);
+    {
+        // hosts ask for the state far more often than it changes (autosaves, undo
+        // snapshots, switching sessions), so it's only written out again when it has
+        const juce::ScopedLock sl (stateLock);
+
+        if (cachedState.isEmpty() || state != cachedStateSource)
+        {
+            cachedState.reset();
+            juce::MemoryOutputStream out (cachedState, false);
+            state.writeTo (out);
+            cachedStateSource = state;
+        }
+
+        destData = cachedState;
+    }
+
+    juce::MemoryOutputStream stream (destData, true);
+
+    // the frozen texture follows the state as a side block
+    if (keepFrozenTexture.load() && rawParams[(size_t) ParamIndex::freeze]->load() >= 0.5f)
+    {
+        const juce::ScopedLock sl (textureLock);
+        const auto live = engine.getFrozenTexture();
+
+        // a session saved straight after it was loaded keeps the texture it was loaded with,
+        // still encoded if the loader hasn't got to the end of it
+        if (live != nullptr)
+            live->writeTo (stream);
+        else if (textureLoader != nullptr && textureLoader->isThreadRunning())
+            stream.write (textureLoader->getEncoded().getData(), textureLoader->getEncoded().getSize());
+        else if (isSavedTexturePending())
+            savedTexture->writeTo (stream);
+    }
 }
 
 void StarlightDriftAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    const auto state = juce::ValueTree::readFromData (data, (size_t) sizeInBytes);
-    if (! state.isValid())
+    juce::MemoryInputStream in (data, (size_t) sizeInBytes, false);
+
+    PluginState state;
+    if (! state.readFrom (in))
         return;
 
-    const auto params = state.getChildWithName ("PARAMS");
-    if (params.isValid())
-        apvts.replaceState (params);
+    for (int i = 0; i < ParamIndex::count; ++i)
+        if (auto* param = apvts.getParameter (paramSpecs[i].id))
+            param->setValueNotifyingHost (param->convertTo0to1 (state.params.get (i)));
+
+    lockMask = state.params.lockMask;
+    offlineTurbo = state.offlineTurbo;
+    delayStorage = state.delayStorage;
+    longMemoryMinutes = state.longMemoryMinutes;
+    keepFrozenTexture = state.keepFrozenTexture;
+    reverbCapture = state.reverbCapture;
+    setSampleFile (juce::File::isAbsolutePath (state.sampleFile) ? juce::File (state.sampleFile) : juce::File());
+
+    // the saved parameters already hold whatever the program set
+    currentProgram = juce::jlimit (0, getNumPrograms() - 1, state.program);
+    morph.setSlots (state.morph);
+    getModulation().setRoutings (state.routings);
+    setTaps (state.taps);
 
-    const auto locks = state.getChildWithName ("Locks");
-    if (locks.isValid())
-        locksState = locks;
+    textureLoader.reset();
+
+    {
+        const juce::ScopedLock sl (textureLock);
+        savedTexture.reset();
+        engine.setFrozenLoops (nullptr);
+    }
+
+    if (in.getNumBytesRemaining() <= 0)
+        return;
+
+    juce::MemoryBlock encoded (static_cast<const char*> (data) + in.getPosition(), (size_t) in.getNumBytesRemaining());
+
+    // offline the texture has to be in place for the first block, so renders don't depend on
+    // how long the decode takes
+    if (isNonRealtime())
+    {
+        if (auto texture = FrozenTexture::readFrom (encoded.getData(), encoded.getSize()))
+            restoreFrozenTexture (std::move (texture));
+    }
+    else
+    {
+        textureLoader = std::make_unique<TextureLoader> (*this, std::move (encoded));
+    }
+}
+
+void StarlightDriftAudioProcessor::restoreFrozenTexture (std::unique_ptr<FrozenTexture> texture)
+{
+    const juce::ScopedLock sl (textureLock);
+    savedTexture = std::move (texture);
+    installSavedTexture();
+}
+
+// Hands savedTexture to the engine; textureLock must be held. Without a matching layout
+// (or before prepareToPlay()) it stays pending, for the next prepareToPlay() to try again.
+void StarlightDriftAudioProcessor::installSavedTexture()
+{
+    savedTextureBlock = std::numeric_limits<juce::uint64>::max();
+
+    auto loops = engine.makeFrozenLoops (*savedTexture);
+    if (loops == nullptr)
+        return;
+
+    engine.setFrozenLoops (loops.get());
+
+    // replaced loops are safe to let go of once a block has finished after the switch
+    const auto blocks = engine.getProcessedBlocks();
+    retiredLoops.erase (std::remove_if (retiredLoops.begin(), retiredLoops.end(),
+                                        [blocks] (const auto& r) { return blocks > r.second; }),
+                        retiredLoops.end());
+
+    if (frozenLoops != nullptr)
+        retiredLoops.emplace_back (std::move (frozenLoops), blocks);
+
+    frozenLoops = std::move (loops);
+    savedTextureBlock = blocks;
+}
+
+// Whether savedTexture hasn't reached the engine yet: a block that started after it was
+// handed over will have picked it up. textureLock must be held.
+bool StarlightDriftAudioProcessor::isSavedTexturePending() const
+{
+    return savedTexture != nullptr
+           && (savedTextureBlock == std::numeric_limits<juce::uint64>::max() || engine.getProcessedBlocks() <= savedTextureBlock + 1);
+}
+
+bool StarlightDriftAudioProcessor::setSampleFile (const juce::File& file)
+{
+    auto source = file != juce::File() ? SampleSource::open (file) : nullptr;
+
+    const juce::ScopedLock sl (sampleSourceLock);
+
+    sampleFile = file;
+    engine.setSampleSource (source.get());
+
+    // a replaced source is safe to let go of once a block has finished after the switch
+    const auto blocks = engine.getProcessedBlocks();
+    retiredSources.erase (std::remove_if (retiredSources.begin(), retiredSources.end(),
+                                          [blocks] (const auto& r) { return blocks > r.second; }),
+                          retiredSources.end());
+
+    if (sampleSource != nullptr)
+        retiredSources.emplace_back (std::move (sampleSource), blocks);
+
+    sampleSource = std::move (source);
+    return sampleSource != nullptr || file == juce::File();
+}
+
+juce::File StarlightDriftAudioProcessor::getSampleFile() const
+{
+    const juce::ScopedLock sl (sampleSourceLock);
+    return sampleFile;
 }
 
 juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
@@ -3,16 +3,20 @@
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_dsp/juce_dsp.h>
 
-#include "DSP/GranularDelay.h"
-#include "DSP/ShimmerReverb.h"
+#include "Diagnostics/RealtimeSafety.h"
+#include "Diagnostics/TraceRecorder.h"
+#include "Engine/StarlightEngine.h"
+#include "PluginState.h"
+#include "PresetBank.h"
 
 class StarlightDriftAudioProcessorEditor;
 
-class StarlightDriftAudioProcessor final : public juce::AudioProcessor
+class StarlightDriftAudioProcessor final : public juce::AudioProcessor,
+                                           private juce::Timer
 {
 public:
     StarlightDriftAudioProcessor();
-    ~StarlightDriftAudioProcessor() override = default;
+    ~StarlightDriftAudioProcessor() override { stopTimer(); }
 
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
@@ -29,12 +33,20 @@ public:
     bool isMidiEffect() const override { return false; }
     double getTailLengthSeconds() const override;
 
-    int getNumPrograms() override { return 1; }
-    int getCurrentProgram() override { return 0; }
-    void setCurrentProgram (int) override {}
-    const juce::String getProgramName (int) override { return {}; }
+    // Programs are the presets in the bank. setCurrentProgram() may be called from any
+    // thread, by several at once, and doesn't allocate, lock or signal: it publishes the
+    // program in one atomic word that the audio thread reads at the next block, and the
+    // message thread polls to bring the parameters in line. Locked parameters keep their values.
+    int getNumPrograms() override { return juce::jmax (1, presets->getNumPresets()); }
+    int getCurrentProgram() override { return currentProgram.load(); }
+    void setCurrentProgram (int index) override;
+    const juce::String getProgramName (int index) override { return presets->getName (index); }
     void changeProgramName (int, const juce::String&) override {}
 
+    // The presets: the bank in getPresetBankFile() if there is one, otherwise the factory bank.
+    const PresetBank& getPresetBank() const noexcept { return *presets; }
+    static juce::File getPresetBankFile();
+
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
@@ -42,27 +54,174 @@ public:
     const juce::AudioBuffer<float>& getLastBuffer() const { return lastBuffer; }
     void copyLastBuffer (juce::AudioBuffer<float>& dest) const;
     bool isParamLocked (const juce::String& paramId) const;
+    ParameterSnapshot getParameterSnapshot() const;
     void setParamLocked (const juce::String& paramId, bool locked);
 
+    // The snapshots the Morph and Morph Y parameters move between; saved with the state.
+    ParameterMorph& getMorph() noexcept { return morph; }
+
+    // What Air, Glass and any other macro routings drive; saved with the state.
+    ModulationMatrix& getModulation() noexcept { return engine.getModulation(); }
+    const ModulationMatrix& getModulation() const noexcept { return engine.getModulation(); }
+
+    // Grain streams played alongside the main one from the same delay line, each at its own
+    // time, rate, pitch, position and level (see GranularDelay::Tap); saved with the state.
+    // Not for the audio thread.
+    void setTaps (const std::vector<GranularDelay::Tap>& taps) { engine.setTaps (taps); }
+    std::vector<GranularDelay::Tap> getTaps() const { return engine.getTaps(); }
+
+    // Audio thread, just before processBlock(): a parameter reached the plain `value`
+    // `sampleOffset` samples into the coming block. JUCE's wrappers only hand over each
+    // parameter's last value in a block, so this is for callers that know when within the
+    // block automation moved (the offline renderer, embedding applications, tests); the
+    // parameter itself should still end up at its final value, as hosts leave it. The block
+    // is split at the events, no more often than every minSubBlockSamples: events closer
+    // together than that land with the one before. Locked parameters ignore them.
+    void addParameterEvent (int sampleOffset, int paramIndex, float value) noexcept;
+
+    static constexpr int minSubBlockSamples = 32;
+    static constexpr int maxParameterEvents = 256;
+
+    // Pipelines offline renders over several threads (bit-identical output, one block of
+    // reported latency). Takes effect on the next prepareToPlay().
+    void setOfflineTurbo (bool shouldUseTurbo) { offlineTurbo = shouldUseTurbo; }
+    bool isOfflineTurbo() const { return offlineTurbo.load(); }
+
+    // How much work the CPU governor is currently shedding, 0 (none) to QualityGovernor::maxLevel.
+    int getQualityLevel() const noexcept { return engine.getQualityLevel(); }
+
+    // Sample format of the grain and pre-delay lines (saved with the state). The 16-bit
+    // formats halve the instance's biggest allocations. Takes effect on the next prepareToPlay().
+    void setDelayStorage (DelayBuffer::Format format) { delayStorage = (int) format; }
+    DelayBuffer::Format getDelayStorage() const { return (DelayBuffer::Format) delayStorage.load(); }
+
+    // Minutes of input kept on disk for the Memory parameter to scatter grains across (saved
+    // with the state); 0 turns the long memory off. Takes effect on the next prepareToPlay().
+    void setLongMemoryMinutes (int minutes) { longMemoryMinutes = minutes; }
+    int getLongMemoryMinutes() const { return longMemoryMinutes.load(); }
+
+    // Sampler mode: plays an uncompressed WAV or AIFF file through the grain engine in place
+    // of the input; an empty File goes back to the live input. The file is remembered (and
+    // saved with the state) even if it can't be opened, so a session moved to a machine
+    // without it keeps the reference. Returns whether the file is playing. Not for the audio thread.
+    bool setSampleFile (const juce::File& file);
+    juce::File getSampleFile() const;
+
+    // Saves a completed freeze with the state (16-bit and compressed, see FrozenTexture), so
+    // the session reopens with the same frozen texture. The saved loop is decoded on a
+    // background thread and swapped into the engine without blocking the load; a freeze
+    // also survives the host preparing the plugin again, whether or not this is on.
+    void setKeepFrozenTexture (bool shouldKeep) { keepFrozenTexture = shouldKeep; }
+    bool isKeepingFrozenTexture() const { return keepFrozenTexture.load(); }
+
+    // Real-time only (offline renders keep the reverb itself): while the reverb settings hold
+    // still, plays the reverb through a convolution with a captured impulse response of it
+    // (see ReverbCapture); saved with the state. Takes effect on the next prepareToPlay().
+    void setReverbCapture (bool shouldCapture) { reverbCapture = shouldCapture; }
+    bool isReverbCapture() const { return reverbCapture.load(); }
+
+    // Whether the reverb is playing a captured response right now.
+    bool isReverbConvolving() const noexcept { return engine.isReverbConvolving(); }
+
+    // Heap memory the signal chain holds, as of the last prepareToPlay().
+    size_t getMemoryFootprint() const noexcept { return memoryFootprint.load(); }
+
+   #if STARLIGHT_TRACING
+    bool startTraceRecording (const juce::File& file);
+    void stopTraceRecording();
+    bool isTraceRecording() const { return trace.isRecording(); }
+   #endif
+
+    // Deterministic grain scheduling, applied on the next prepareToPlay().
+    void setRandomSeed (juce::int64 seed) { engine.setRandomSeed (seed); }
+
     static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
 
 private:
-    void updateDSPFromParams();
+    class TextureLoader;
+
+    PluginState captureState() const;
+    void timerCallback() override;
+    void applyProgram (int index, juce::uint32 serial);
+    void takeProgramChanges (ParameterSnapshot&) noexcept;
+    void processSubBlocks (juce::AudioBuffer<float>&, const ParameterSnapshot& blockParams);
+    void processEngine (float* const* channels, int numSamples, ParameterSnapshot params);
+    void restoreFrozenTexture (std::unique_ptr<FrozenTexture>);
+    void installSavedTexture();
+    bool isSavedTexturePending() const;
 
     juce::AudioProcessorValueTreeState apvts;
-    juce::ValueTree locksState { "Locks" };
-
-    GranularDelay granular;
-    ShimmerReverb shimmer;
+    std::atomic<juce::uint32> lockMask { 0 }; // bit n: parameter n (ParamIndex) is locked
+    std::atomic<bool> offlineTurbo { false };
+    std::atomic<int> delayStorage { (int) DelayBuffer::Format::float32 };
+    std::atomic<int> longMemoryMinutes { 0 };
+    std::atomic<bool> keepFrozenTexture { false };
+    std::atomic<bool> reverbCapture { false };
+    std::atomic<size_t> memoryFootprint { 0 };
+
+    // getStateInformation()'s last result and what it was made from, reused while that
+    // doesn't change
+    juce::CriticalSection stateLock;
+    PluginState cachedStateSource;
+    juce::MemoryBlock cachedState;
+
+    // sampler mode: the file in use, and replaced ones the engine may still be reading,
+    // with the block count they were replaced at
+    juce::File sampleFile;
+    std::shared_ptr<const SampleSource> sampleSource;
+    std::vector<std::pair<std::shared_ptr<const SampleSource>, juce::uint64>> retiredSources;
+    mutable juce::CriticalSection sampleSourceLock;
+
+    // Program changes are numbered. requestedProgram holds the latest one, its serial in the
+    // top half and its index in the bottom half; the parameters have been updated up to
+    // appliedProgramSerial, and the audio thread plays `latestProgram` in their place until
+    // they've caught up with it.
+    struct ProgramChange
+    {
+        ParameterSnapshot params;
+        juce::uint32 serial = 0;
+    };
+
+    std::unique_ptr<PresetBank> presets;
+    std::atomic<int> currentProgram { 0 };
+    std::atomic<juce::uint32> programSerial { 0 }, appliedProgramSerial { 0 };
+    std::atomic<juce::uint64> requestedProgram { 0 };
+    ProgramChange latestProgram;
+
+    ParameterMorph morph;
+
+    // this block's events in order of sampleOffset, and where the last block left the parameters
+    std::array<ParameterEvent, maxParameterEvents> parameterEvents;
+    int numParameterEvents = 0;
+    ParameterSnapshot lastBlockParams;
+    std::vector<float*> subBlockChannels;
+
+    std::array<std::atomic<float>*, ParamIndex::count> rawParams {};
+    StarlightEngine engine;
+
+    // A freeze to put back: restored from the state or kept across prepareToPlay(), until
+    // the engine has picked up its loops (the block count they were handed over at; the
+    // maximum until then). Then the loops given to the engine, and replaced ones it may
+    // still be swapping, with the block count they were replaced at. textureLock also keeps
+    // the engine's layout still while loops are built for it.
+    juce::CriticalSection textureLock;
+    std::unique_ptr<FrozenTexture> savedTexture;
+    juce::uint64 savedTextureBlock = 0;
+    std::unique_ptr<StarlightEngine::FrozenLoops> frozenLoops;
+    std::vector<std::pair<std::unique_ptr<StarlightEngine::FrozenLoops>, juce::uint64>> retiredLoops;
+    std::unique_ptr<TextureLoader> textureLoader;
 
-    juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>, juce::dsp::IIR::Coefficients<float>> wetHP;
-    juce::dsp::ProcessorDuplicator<juce::dsp::IIR::Filter<float>, juce::dsp::IIR::Coefficients<float>> wetLP;
-    juce::dsp::Limiter<float> limiter;
-
-    juce::AudioBuffer<float> stereoBuffer;
-    juce::AudioBuffer<float> wetBuffer;
     juce::AudioBuffer<float> lastBuffer;
+    int lastBufferCapacity = 0; // samplesPerBlock from prepareToPlay()
     mutable juce::SpinLock lastBufferLock;
 
+   #if STARLIGHT_TRACING
+    void traceParameterChanges();
+
+    TraceRecorder trace;
+    juce::StringArray tracedParamIds;
+    std::vector<float> tracedParamValues;
+   #endif
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StarlightDriftAudioProcessor)
 };
@@ -0,0 +1,202 @@
+#include "PluginState.h"
+
+static constexpr int stateMagic = 0x74734453; // "SDst"
+static constexpr int stateVersion = 1;
+
+// ModulationMatrix::shimmerInterval as a routing destination in the state. The matrix puts it
+// just past the parameters, which moves whenever one is appended, so it's saved as this.
+static constexpr int savedShimmerInterval = 255;
+
+static constexpr juce::uint32 allLocks = ParamIndex::count < 32 ? (1u << ParamIndex::count) - 1 : ~0u;
+
+bool PluginState::operator== (const PluginState& other) const noexcept
+{
+    return params.values == other.params.values && params.lockMask == other.params.lockMask
+           && offlineTurbo == other.offlineTurbo && delayStorage == other.delayStorage
+           && longMemoryMinutes == other.longMemoryMinutes && keepFrozenTexture == other.keepFrozenTexture
+           && sampleFile == other.sampleFile && program == other.program && morph == other.morph
+           && routings == other.routings && taps == other.taps && reverbCapture == other.reverbCapture;
+}
+
+void PluginState::writeTo (juce::OutputStream& out) const
+{
+    out.writeInt (stateMagic);
+    out.writeInt (stateVersion);
+
+    out.writeInt (ParamIndex::count);
+    for (const auto v : params.values)
+        out.writeFloat (v);
+
+    out.writeInt ((int) params.lockMask);
+
+    out.writeBool (offlineTurbo);
+    out.writeByte ((char) delayStorage);
+    out.writeByte ((char) longMemoryMinutes);
+    out.writeBool (keepFrozenTexture);
+    out.writeString (sampleFile);
+    out.writeInt (program);
+
+    // the stored snapshots' values, as for the parameters
+    out.writeInt ((int) morph.storedMask);
+    for (int s = 0; s < ParameterMorph::numSlots; ++s)
+        if (morph.isStored (s))
+            for (const auto v : morph.params[(size_t) s].values)
+                out.writeFloat (v);
+
+    out.writeInt ((int) routings.size());
+    for (const auto& r : routings)
+    {
+        out.writeByte ((char) r.source);
+        out.writeByte ((char) (r.destination == ModulationMatrix::shimmerInterval ? savedShimmerInterval : r.destination));
+        out.writeByte ((char) r.mode);
+        out.writeByte ((char) r.curve);
+        out.writeFloat (r.amount);
+        out.writeInt ((int) r.lockMask);
+    }
+
+    out.writeInt ((int) taps.size());
+    for (const auto& t : taps)
+    {
+        out.writeFloat (t.delayTimeMs);
+        out.writeFloat (t.density);
+        out.writeFloat (t.pitchSemitones);
+        out.writeFloat (t.pan);
+        out.writeFloat (t.level);
+    }
+
+    out.writeBool (reverbCapture);
+}
+
+bool PluginState::readFrom (juce::InputStream& in)
+{
+    const auto start = in.getPosition();
+
+    if (in.readInt() == stateMagic)
+        return readBinary (in);
+
+    in.setPosition (start);
+    return readValueTree (in);
+}
+
+bool PluginState::readBinary (juce::InputStream& in)
+{
+    if (in.readInt() != stateVersion)
+        return false;
+
+    const int numValues = in.readInt();
+    if (numValues < 0 || numValues > 32 || in.getNumBytesRemaining() < (juce::int64) numValues * 4 + 8)
+        return false;
+
+    *this = {};
+
+    for (int i = 0; i < numValues; ++i)
+    {
+        const float v = in.readFloat();
+        if (i < ParamIndex::count)
+            params.set (i, juce::jlimit (paramSpecs[i].minValue, paramSpecs[i].maxValue, v));
+    }
+
+    params.lockMask = (juce::uint32) in.readInt() & allLocks;
+
+    offlineTurbo = in.readBool();
+    delayStorage = juce::jlimit (0, 2, (int) in.readByte());
+    longMemoryMinutes = juce::jlimit (0, 10, (int) in.readByte());
+    keepFrozenTexture = in.readBool();
+    sampleFile = in.readString();
+
+    program = juce::jmax (0, in.readInt());
+
+    morph.storedMask = (juce::uint32) in.readInt() & ((1u << ParameterMorph::numSlots) - 1);
+
+    for (int s = 0; s < ParameterMorph::numSlots; ++s)
+    {
+        if (! morph.isStored (s))
+            continue;
+
+        if (in.getNumBytesRemaining() < (juce::int64) numValues * 4)
+            return false;
+
+        for (int i = 0; i < numValues; ++i)
+        {
+            const float v = in.readFloat();
+            if (i < ParamIndex::count)
+                morph.params[(size_t) s].set (i, juce::jlimit (paramSpecs[i].minValue, paramSpecs[i].maxValue, v));
+        }
+    }
+
+    const int numRoutings = in.readInt();
+    if (numRoutings < 0 || numRoutings > ModulationMatrix::maxRoutings || in.getNumBytesRemaining() < (juce::int64) numRoutings * 12)
+        return false;
+
+    routings.clear();
+
+    for (int n = 0; n < numRoutings; ++n)
+    {
+        ModulationMatrix::Routing r;
+        r.source = (juce::uint8) in.readByte();
+        r.destination = (juce::uint8) in.readByte();
+        r.mode = (ModulationMatrix::Mode) juce::jlimit (0, 1, (int) in.readByte());
+        r.curve = (ModulationMatrix::Curve) juce::jlimit (0, 2, (int) in.readByte());
+        r.amount = in.readFloat();
+        r.lockMask = (juce::uint32) in.readInt();
+
+        if (r.destination == savedShimmerInterval)
+            r.destination = ModulationMatrix::shimmerInterval;
+
+        // the matrix drops any it can't use
+        routings.push_back (r);
+    }
+
+    const int numTaps = in.readInt();
+    if (numTaps < 0 || numTaps > GranularDelay::maxTaps || in.getNumBytesRemaining() < (juce::int64) numTaps * 20)
+        return false;
+
+    for (int n = 0; n < numTaps; ++n)
+    {
+        GranularDelay::Tap t;
+        t.delayTimeMs = juce::jlimit (0.0f, GranularDelay::maxDelayTimeMs, in.readFloat());
+        t.density = juce::jlimit (0.0f, paramSpecs[ParamIndex::density].maxValue, in.readFloat());
+        t.pitchSemitones = juce::jlimit (paramSpecs[ParamIndex::pitchSemi].minValue, paramSpecs[ParamIndex::pitchSemi].maxValue, in.readFloat());
+        t.pan = juce::jlimit (-1.0f, 1.0f, in.readFloat());
+        t.level = juce::jlimit (0.0f, 1.0f, in.readFloat());
+        taps.push_back (t);
+    }
+
+    reverbCapture = in.readBool();
+
+    return true;
+}
+
+// The format before the binary one: a "StarlightDriftState" tree holding the APVTS state and a
+// "Locks" tree of booleans by parameter ID, with the settings as properties.
+bool PluginState::readValueTree (juce::InputStream& in)
+{
+    const auto state = juce::ValueTree::readFromStream (in);
+    if (! state.isValid())
+        return false;
+
+    *this = {};
+
+    for (const auto& param : state.getChildWithName ("PARAMS"))
+    {
+        const int i = ParameterSnapshot::indexOf (param.getProperty ("id").toString());
+        if (i >= 0 && param.hasProperty ("value"))
+            params.set (i, juce::jlimit (paramSpecs[i].minValue, paramSpecs[i].maxValue, (float) param.getProperty ("value")));
+    }
+
+    const auto locks = state.getChildWithName ("Locks");
+    for (int p = 0; p < locks.getNumProperties(); ++p)
+    {
+        const auto id = locks.getPropertyName (p);
+        const int i = ParameterSnapshot::indexOf (id.toString());
+        if (i >= 0 && (bool) locks.getProperty (id))
+            params.lockMask |= 1u << i;
+    }
+
+    offlineTurbo = (bool) state.getProperty ("offlineTurbo", false);
+    delayStorage = juce::jlimit (0, 2, (int) state.getProperty ("delayStorage", 0));
+    longMemoryMinutes = juce::jlimit (0, 10, (int) state.getProperty ("longMemoryMinutes", 0));
+    keepFrozenTexture = (bool) state.getProperty ("keepFrozenTexture", false);
+    sampleFile = state.getProperty ("sampleFile", {}).toString();
+    return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <juce_data_structures/juce_data_structures.h>
+
+#include "DSP/GranularDelay.h"
+#include "Engine/ModulationMatrix.h"
+#include "Engine/ParameterMorph.h"
+#include "Engine/Parameters.h"
+
+// Everything the plugin saves with a session but the frozen texture, and the binary format
+// it's saved in: a tag and version, the parameters' plain values in ParamIndex order, the
+// lock bits, the processor's settings, the morph snapshots, the macro routings, the grain
+// taps and the reverb capture setting. Parameters appended after a state was saved keep
+// their defaults. readFrom() also takes the ValueTree the plugin saved before this format.
+struct PluginState
+{
+    ParameterSnapshot params;
+    bool offlineTurbo = false;
+    int delayStorage = 0;
+    int longMemoryMinutes = 0;
+    bool keepFrozenTexture = false;
+    juce::String sampleFile;
+    int program = 0; // the host's current program: an index into the preset bank
+    ParameterMorph::Slots morph;
+    std::vector<ModulationMatrix::Routing> routings = ModulationMatrix::getDefaultRoutings();
+    std::vector<GranularDelay::Tap> taps;
+    bool reverbCapture = false;
+
+    bool operator== (const PluginState&) const noexcept;
+    bool operator!= (const PluginState& other) const noexcept { return ! operator== (other); }
+
+    void writeTo (juce::OutputStream&) const;
+
+    // Leaves the stream just past the state, where the frozen texture's side block starts;
+    // false if it holds neither format. Settings come back clamped to their ranges.
+    bool readFrom (juce::InputStream&);
+
+private:
+    bool readBinary (juce::InputStream&);
+    bool readValueTree (juce::InputStream&);
+};
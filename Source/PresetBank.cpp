@@ -0,0 +1,264 @@
+#include "PresetBank.h"
+
+#include <cstring>
+
+static constexpr int bankMagic = 0x62704453; // "SDpb"
+static constexpr int bankVersion = 1;
+static constexpr int headerSize = 32;
+static constexpr int valuesOffset = PresetBank::maxNameBytes + PresetBank::maxCategoryBytes;
+
+static int readInt (const char* p) noexcept
+{
+    return (int) juce::ByteOrder::littleEndianInt (p);
+}
+
+static float readFloat (const char* p) noexcept
+{
+    const auto bits = juce::ByteOrder::littleEndianInt (p);
+    float v;
+    std::memcpy (&v, &bits, sizeof (v));
+    return v;
+}
+
+static juce::String readText (const char* p, int maxBytes)
+{
+    int n = 0;
+    while (n < maxBytes && p[n] != 0)
+        ++n;
+
+    return juce::String::fromUTF8 (p, n);
+}
+
+// Whether the NUL-padded field contains `lowerText`, comparing ASCII letters in any case.
+static bool fieldContains (const char* field, int maxBytes, const char* lowerText, int textLength) noexcept
+{
+    if (textLength == 0)
+        return true;
+
+    for (int start = 0; start + textLength <= maxBytes && field[start] != 0; ++start)
+    {
+        int i = 0;
+        while (i < textLength && juce::CharacterFunctions::toLowerCase ((juce::juce_wchar) (unsigned char) field[start + i])
+                                     == (juce::juce_wchar) (unsigned char) lowerText[i])
+            ++i;
+
+        if (i == textLength)
+            return true;
+    }
+
+    return false;
+}
+
+std::unique_ptr<PresetBank> PresetBank::open (const juce::File& file)
+{
+    std::unique_ptr<PresetBank> bank (new PresetBank());
+    bank->map = std::make_unique<juce::MemoryMappedFile> (file, juce::MemoryMappedFile::readOnly, false);
+
+    if (bank->map->getData() == nullptr || ! bank->attach (bank->map->getData(), bank->map->getSize()))
+        return nullptr;
+
+    return bank;
+}
+
+std::unique_ptr<PresetBank> PresetBank::fromMemory (juce::MemoryBlock data)
+{
+    std::unique_ptr<PresetBank> bank (new PresetBank());
+    bank->memory = std::move (data);
+
+    if (! bank->attach (bank->memory.getData(), bank->memory.getSize()))
+        return nullptr;
+
+    return bank;
+}
+
+bool PresetBank::attach (const void* data, size_t numBytes)
+{
+    const auto* p = static_cast<const char*> (data);
+
+    if (numBytes < (size_t) headerSize || readInt (p) != bankMagic || readInt (p + 4) != bankVersion)
+        return false;
+
+    numPresets = readInt (p + 8);
+    recordSize = readInt (p + 12);
+    numValues = readInt (p + 16);
+
+    if (numPresets < 0 || numValues < 0 || numValues > 32 || recordSize < valuesOffset + 4 * numValues
+        || (size_t) numPresets * (size_t) recordSize > numBytes - (size_t) headerSize)
+    {
+        numPresets = 0;
+        return false;
+    }
+
+    records = p + headerSize;
+    return true;
+}
+
+juce::String PresetBank::getName (int index) const
+{
+    return juce::isPositiveAndBelow (index, numPresets) ? readText (getRecord (index), maxNameBytes) : juce::String();
+}
+
+juce::String PresetBank::getCategory (int index) const
+{
+    return juce::isPositiveAndBelow (index, numPresets) ? readText (getRecord (index) + maxNameBytes, maxCategoryBytes) : juce::String();
+}
+
+ParameterSnapshot PresetBank::getParameters (int index) const noexcept
+{
+    ParameterSnapshot snapshot;
+
+    if (! juce::isPositiveAndBelow (index, numPresets))
+        return snapshot;
+
+    const auto* values = getRecord (index) + valuesOffset;
+
+    for (int i = 0; i < juce::jmin (numValues, (int) ParamIndex::count); ++i)
+        snapshot.set (i, juce::jlimit (paramSpecs[i].minValue, paramSpecs[i].maxValue, readFloat (values + 4 * i)));
+
+    return snapshot;
+}
+
+std::vector<int> PresetBank::find (const juce::String& text, const juce::String& category) const
+{
+    const auto lower = text.trim().toLowerCase();
+    const auto* lowerText = lower.toRawUTF8();
+    const int textLength = (int) lower.getNumBytesAsUTF8();
+
+    const auto categoryUtf8 = category.toRawUTF8();
+    const int categoryLength = (int) category.getNumBytesAsUTF8();
+
+    std::vector<int> matches;
+
+    for (int i = 0; i < numPresets; ++i)
+    {
+        const auto* record = getRecord (i);
+        const auto* recordCategory = record + maxNameBytes;
+
+        if (categoryLength > 0
+            && (categoryLength > maxCategoryBytes || std::memcmp (recordCategory, categoryUtf8, (size_t) categoryLength) != 0
+                || (categoryLength < maxCategoryBytes && recordCategory[categoryLength] != 0)))
+            continue;
+
+        if (fieldContains (record, maxNameBytes, lowerText, textLength)
+            || fieldContains (recordCategory, maxCategoryBytes, lowerText, textLength))
+            matches.push_back (i);
+    }
+
+    return matches;
+}
+
+juce::StringArray PresetBank::getCategories() const
+{
+    juce::StringArray categories;
+
+    for (int i = 0; i < numPresets; ++i)
+        categories.addIfNotAlreadyThere (getCategory (i));
+
+    categories.removeEmptyStrings();
+    return categories;
+}
+
+// Cuts text to at most maxBytes of UTF-8 without splitting a character.
+static void writeText (char* dest, const juce::String& text, int maxBytes)
+{
+    auto t = text;
+    while ((int) t.getNumBytesAsUTF8() > maxBytes)
+        t = t.dropLastCharacters (1);
+
+    std::memcpy (dest, t.toRawUTF8(), t.getNumBytesAsUTF8());
+}
+
+static void writeInt (char* dest, int value) noexcept
+{
+    const auto bits = juce::ByteOrder::swapIfBigEndian ((juce::uint32) value);
+    std::memcpy (dest, &bits, sizeof (bits));
+}
+
+static void writeFloat (char* dest, float value) noexcept
+{
+    juce::uint32 bits;
+    std::memcpy (&bits, &value, sizeof (bits));
+    writeInt (dest, (int) bits);
+}
+
+juce::MemoryBlock PresetBank::build (const std::vector<Preset>& presets)
+{
+    const int size = valuesOffset + 4 * ParamIndex::count;
+    juce::MemoryBlock data ((size_t) headerSize + presets.size() * (size_t) size, true);
+    auto* p = static_cast<char*> (data.getData());
+
+    writeInt (p, bankMagic);
+    writeInt (p + 4, bankVersion);
+    writeInt (p + 8, (int) presets.size());
+    writeInt (p + 12, size);
+    writeInt (p + 16, ParamIndex::count);
+
+    auto* record = p + headerSize;
+
+    for (const auto& preset : presets)
+    {
+        writeText (record, preset.name, maxNameBytes);
+        writeText (record + maxNameBytes, preset.category, maxCategoryBytes);
+
+        for (int i = 0; i < ParamIndex::count; ++i)
+            writeFloat (record + valuesOffset + 4 * i, preset.params.get (i));
+
+        record += size;
+    }
+
+    return data;
+}
+
+bool PresetBank::write (const juce::File& file, const std::vector<Preset>& presets)
+{
+    const auto data = build (presets);
+    return file.getParentDirectory().createDirectory() && file.replaceWithData (data.getData(), data.getSize());
+}
+
+std::unique_ptr<PresetBank> PresetBank::createFactoryBank()
+{
+    struct Setting
+    {
+        const char* id;
+        float value;
+    };
+
+    auto make = [] (const char* name, const char* category, std::initializer_list<Setting> settings)
+    {
+        Preset preset { name, category, {} };
+
+        for (const auto& s : settings)
+            preset.params.set (ParameterSnapshot::indexOf (s.id), s.value);
+
+        return preset;
+    };
+
+    const std::vector<Preset> presets
+    {
+        make ("Init", "Basic", {}),
+        make ("Subtle Space", "Basic",
+              { { ParamIDs::mix, 0.25f }, { ParamIDs::feedback, 0.2f }, { ParamIDs::density, 10.0f },
+                { ParamIDs::reverbSize, 0.45f }, { ParamIDs::shimmerAmt, 0.1f } }),
+        make ("Tape Echo", "Delay",
+              { { ParamIDs::delayTimeMs, 375.0f }, { ParamIDs::feedback, 0.55f }, { ParamIDs::grainSizeMs, 120.0f },
+                { ParamIDs::density, 8.0f }, { ParamIDs::jitter, 0.05f }, { ParamIDs::spread, 0.2f },
+                { ParamIDs::reverbMix, 0.3f }, { ParamIDs::mix, 0.4f }, { ParamIDs::lpEnable, 1.0f }, { ParamIDs::lpFreq, 5000.0f } }),
+        make ("Slow Bloom", "Pad",
+              { { ParamIDs::delayTimeMs, 900.0f }, { ParamIDs::feedback, 0.6f }, { ParamIDs::grainSizeMs, 180.0f },
+                { ParamIDs::density, 12.0f }, { ParamIDs::jitter, 0.35f }, { ParamIDs::reverbSize, 0.8f },
+                { ParamIDs::shimmerAmt, 0.35f }, { ParamIDs::mix, 0.6f }, { ParamIDs::air, 0.3f } }),
+        make ("Octave Drone", "Pad",
+              { { ParamIDs::pitchSemi, -12.0f }, { ParamIDs::feedback, 0.75f }, { ParamIDs::grainSizeMs, 220.0f },
+                { ParamIDs::density, 6.0f }, { ParamIDs::drift, 0.6f }, { ParamIDs::modDepth, 0.5f },
+                { ParamIDs::hpEnable, 1.0f }, { ParamIDs::hpFreq, 80.0f } }),
+        make ("Glass Rain", "Shimmer",
+              { { ParamIDs::grainSizeMs, 40.0f }, { ParamIDs::density, 30.0f }, { ParamIDs::pitchSemi, 12.0f },
+                { ParamIDs::spread, 0.8f }, { ParamIDs::glass, 0.7f }, { ParamIDs::shimmerPitch, 3.0f },
+                { ParamIDs::shimmerAmt, 0.5f }, { ParamIDs::reverbMix, 0.8f } }),
+        make ("Particle Cloud", "Texture",
+              { { ParamIDs::cloudDensity, 800.0f }, { ParamIDs::density, 20.0f }, { ParamIDs::grainSizeMs, 30.0f },
+                { ParamIDs::jitter, 0.8f }, { ParamIDs::spread, 1.0f } }),
+    };
+
+    return fromMemory (build (presets));
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include "Engine/Parameters.h"
+
+#include <memory>
+#include <vector>
+
+// A bank of presets in one binary file that is memory-mapped rather than loaded: a header,
+// then a fixed-size record per preset holding its name, its category and the plain values
+// of its parameters in ParamIndex order. Opening a bank reads only the header, names are
+// matched in place, and applying a preset copies one record's values.
+//
+// Parameters added since a bank was written keep their defaults. Everything here may be
+// called from any thread once the bank is open; it never changes after that.
+class PresetBank final
+{
+public:
+    struct Preset
+    {
+        juce::String name, category;
+        ParameterSnapshot params;
+    };
+
+    static constexpr int maxNameBytes = 48;
+    static constexpr int maxCategoryBytes = 16;
+
+    // nullptr if the file isn't a bank this version can read.
+    static std::unique_ptr<PresetBank> open (const juce::File& file);
+
+    // A bank held in memory, as written by build().
+    static std::unique_ptr<PresetBank> fromMemory (juce::MemoryBlock data);
+
+    // The bank a new installation starts with.
+    static std::unique_ptr<PresetBank> createFactoryBank();
+
+    // Names and categories longer than the record allows are cut short.
+    static juce::MemoryBlock build (const std::vector<Preset>& presets);
+    static bool write (const juce::File& file, const std::vector<Preset>& presets);
+
+    int getNumPresets() const noexcept { return numPresets; }
+    juce::String getName (int index) const;
+    juce::String getCategory (int index) const;
+
+    // The preset's values, with lockMask left clear. Out-of-range indices give the defaults.
+    ParameterSnapshot getParameters (int index) const noexcept;
+
+    // Indices of the presets whose name or category contains `text` (ASCII letters in any
+    // case) and, unless `category` is empty, whose category is exactly `category`.
+    std::vector<int> find (const juce::String& text, const juce::String& category = {}) const;
+
+    // Every category in the bank, in the order they first appear.
+    juce::StringArray getCategories() const;
+
+private:
+    PresetBank() = default;
+
+    bool attach (const void* data, size_t numBytes);
+    const char* getRecord (int index) const noexcept { return records + (size_t) index * (size_t) recordSize; }
+
+    std::unique_ptr<juce::MemoryMappedFile> map;
+    juce::MemoryBlock memory;
+
+    const char* records = nullptr;
+    int numPresets = 0;
+    int recordSize = 0;
+    int numValues = 0;
+
+    JUCE_DECLARE_NON_COPYABLE (PresetBank)
+};
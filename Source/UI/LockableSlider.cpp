@@ -2,6 +2,8 @@
 
 #include "../PluginProcessor.h"
 
+#include <algorithm>
+
 static juce::Path makeLockIcon()
 {
     juce::Path p;
@@ -11,6 +13,57 @@ static juce::Path makeLockIcon()
     return p;
 }
 
+// Air and Glass can drive any knob: a submenu for each, with menu ids from firstId
+// (off, then the amounts at full macro).
+static constexpr std::array<float, 6> macroAmounts { 1.0f, 0.5f, 0.25f, -0.25f, -0.5f, -1.0f };
+
+// What the menu means by an amount: a share of the knob's range, or of its value for knobs
+// with a skewed scale (times, frequencies, rates), where a fixed step would be lopsided.
+static ModulationMatrix::Routing makeMacroRouting (int source, int destination, float amount)
+{
+    const auto& spec = paramSpecs[destination];
+    return spec.skew == 1.0f ? ModulationMatrix::Routing::make (source, destination, amount * (spec.maxValue - spec.minValue), ModulationMatrix::Mode::add)
+                             : ModulationMatrix::Routing::make (source, destination, amount, ModulationMatrix::Mode::scale);
+}
+
+static juce::PopupMenu makeMacroMenu (const std::vector<ModulationMatrix::Routing>& routings, int source, int destination, int firstId)
+{
+    std::vector<ModulationMatrix::Routing> current;
+    for (const auto& r : routings)
+        if (r.source == source && r.destination == destination)
+            current.push_back (r);
+
+    juce::PopupMenu m;
+    m.addItem (firstId, "Off", true, current.empty());
+
+    bool matched = current.empty();
+
+    for (size_t n = 0; n < macroAmounts.size(); ++n)
+    {
+        const bool ticked = current.size() == 1 && current.front() == makeMacroRouting (source, destination, macroAmounts[n]);
+        matched = matched || ticked;
+        m.addItem (firstId + 1 + (int) n, (macroAmounts[n] > 0.0f ? "+" : "") + juce::String (juce::roundToInt (macroAmounts[n] * 100.0f)) + "%", true, ticked);
+    }
+
+    if (! matched)
+        m.addItem (firstId + 1 + (int) macroAmounts.size(), "Custom", false, true);
+
+    return m;
+}
+
+static void setMacroRouting (ModulationMatrix& matrix, int source, int destination, int option)
+{
+    auto routings = matrix.getRoutings();
+    routings.erase (std::remove_if (routings.begin(), routings.end(),
+                                    [&] (const auto& r) { return r.source == source && r.destination == destination; }),
+                    routings.end());
+
+    if (juce::isPositiveAndBelow (option - 1, (int) macroAmounts.size()))
+        routings.push_back (makeMacroRouting (source, destination, macroAmounts[(size_t) option - 1]));
+
+    matrix.setRoutings (routings);
+}
+
 void LockableSlider::mouseDown (const juce::MouseEvent& e)
 {
     if (! prevInitialised)
@@ -27,13 +80,28 @@ void LockableSlider::mouseDown (const juce::MouseEvent& e)
         m.addSeparator();
         m.addItem (2, "Reset to default");
 
+        const int index = ParameterSnapshot::indexOf (paramId);
+        const bool isMacro = index == ParamIndex::air || index == ParamIndex::glass;
+
+        if (index >= 0 && ! isMacro)
+        {
+            const auto routings = processor.getModulation().getRoutings();
+            m.addSeparator();
+            m.addSubMenu ("Air", makeMacroMenu (routings, ParamIndex::air, index, 100));
+            m.addSubMenu ("Glass", makeMacroMenu (routings, ParamIndex::glass, index, 200));
+        }
+
         m.showMenuAsync (juce::PopupMenu::Options(),
-            [this, locked] (int res)
+            [this, locked, index] (int res)
             {
                 if (res == 1)
                     processor.setParamLocked (paramId, ! locked);
                 else if (res == 2)
                     setValue (getDoubleClickReturnValue(), juce::sendNotificationSync);
+                else if (res >= 200)
+                    setMacroRouting (processor.getModulation(), ParamIndex::glass, index, res - 200);
+                else if (res >= 100)
+                    setMacroRouting (processor.getModulation(), ParamIndex::air, index, res - 100);
 
                 repaint();
             });
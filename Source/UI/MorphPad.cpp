@@ -0,0 +1,127 @@
+#include "MorphPad.h"
+
+#include "../PluginProcessor.h"
+
+static constexpr float cornerSize = 18.0f;
+
+MorphPad::MorphPad (StarlightDriftAudioProcessor& p, juce::Colour accentIn)
+    : processor (p), accent (accentIn)
+{
+    auto& apvts = processor.getAPVTS();
+
+    attX = std::make_unique<juce::ParameterAttachment> (*apvts.getParameter (ParamIDs::morph), [this] (float v) { x = v; repaint(); });
+    attY = std::make_unique<juce::ParameterAttachment> (*apvts.getParameter (ParamIDs::morphY), [this] (float v) { y = v; repaint(); });
+    attX->sendInitialUpdate();
+    attY->sendInitialUpdate();
+
+    setTooltip ("Morph: drag between the snapshots stored at the corners. Click a letter to store or clear a snapshot");
+}
+
+juce::Rectangle<float> MorphPad::getPadArea() const
+{
+    return getLocalBounds().toFloat().reduced (cornerSize * 0.5f);
+}
+
+// A bottom left, B bottom right, C top left, D top right, as ParameterMorph lays them out
+juce::Rectangle<float> MorphPad::getCornerArea (int slot) const
+{
+    const auto pad = getPadArea();
+    const auto centre = juce::Point<float> ((slot & 1) != 0 ? pad.getRight() : pad.getX(),
+                                            (slot & 2) != 0 ? pad.getY() : pad.getBottom());
+    return juce::Rectangle<float> (cornerSize, cornerSize).withCentre (centre);
+}
+
+void MorphPad::paint (juce::Graphics& g)
+{
+    const auto pad = getPadArea();
+    const auto slots = processor.getMorph().getSlots();
+
+    g.setColour (juce::Colours::black.withAlpha (0.35f));
+    g.fillRoundedRectangle (pad, 6.0f);
+    g.setColour (juce::Colours::white.withAlpha (0.25f));
+    g.drawRoundedRectangle (pad, 6.0f, 1.0f);
+
+    g.setColour (juce::Colours::white.withAlpha (0.45f));
+    g.setFont (11.0f);
+    g.drawText ("MORPH", pad.reduced (cornerSize, 2.0f), juce::Justification::centredTop);
+
+    const juce::Point<float> puck (pad.getX() + x * pad.getWidth(), pad.getBottom() - y * pad.getHeight());
+    const bool active = slots.storedMask != 0;
+    g.setColour (active ? accent : accent.withAlpha (0.35f));
+    g.fillEllipse (juce::Rectangle<float> (10.0f, 10.0f).withCentre (puck));
+
+    for (int slot = 0; slot < ParameterMorph::numSlots; ++slot)
+    {
+        const auto corner = getCornerArea (slot);
+        const bool stored = slots.isStored (slot);
+
+        g.setColour (stored ? accent : juce::Colour (0xff1a1620));
+        g.fillEllipse (corner);
+        g.setColour (stored ? accent : juce::Colours::white.withAlpha (0.35f));
+        g.drawEllipse (corner.reduced (0.5f), 1.0f);
+
+        g.setColour (stored ? juce::Colours::black : juce::Colours::white.withAlpha (0.6f));
+        g.drawText (juce::String::charToString ((juce::juce_wchar) ('A' + slot)), corner, juce::Justification::centred);
+    }
+}
+
+void MorphPad::showSlotMenu (int slot)
+{
+    const bool stored = processor.getMorph().getSlots().isStored (slot);
+    const auto name = juce::String::charToString ((juce::juce_wchar) ('A' + slot));
+
+    juce::PopupMenu m;
+    m.addItem (1, "Store current settings as " + name);
+    m.addItem (2, "Clear " + name, stored);
+
+    m.showMenuAsync (juce::PopupMenu::Options().withTargetComponent (this),
+        [this, slot] (int res)
+        {
+            if (res == 1)
+                processor.getMorph().storeSlot (slot, processor.getParameterSnapshot());
+            else if (res == 2)
+                processor.getMorph().clearSlot (slot);
+
+            repaint();
+        });
+}
+
+void MorphPad::moveTo (juce::Point<float> position)
+{
+    const auto pad = getPadArea();
+    attX->setValueAsPartOfGesture (juce::jlimit (0.0f, 1.0f, (position.x - pad.getX()) / pad.getWidth()));
+    attY->setValueAsPartOfGesture (juce::jlimit (0.0f, 1.0f, (pad.getBottom() - position.y) / pad.getHeight()));
+}
+
+void MorphPad::mouseDown (const juce::MouseEvent& e)
+{
+    for (int slot = 0; slot < ParameterMorph::numSlots; ++slot)
+    {
+        if (getCornerArea (slot).contains (e.position))
+        {
+            showSlotMenu (slot);
+            return;
+        }
+    }
+
+    dragging = true;
+    attX->beginGesture();
+    attY->beginGesture();
+    moveTo (e.position);
+}
+
+void MorphPad::mouseDrag (const juce::MouseEvent& e)
+{
+    if (dragging)
+        moveTo (e.position);
+}
+
+void MorphPad::mouseUp (const juce::MouseEvent&)
+{
+    if (! dragging)
+        return;
+
+    dragging = false;
+    attX->endGesture();
+    attY->endGesture();
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include <memory>
+
+class StarlightDriftAudioProcessor;
+
+// XY pad for the Morph and Morph Y parameters, with the four morph snapshots at its
+// corners: click a corner's letter to store the knobs' current settings there or clear it.
+class MorphPad final : public juce::Component, public juce::SettableTooltipClient
+{
+public:
+    MorphPad (StarlightDriftAudioProcessor& p, juce::Colour accent);
+
+    void paint (juce::Graphics& g) override;
+    void mouseDown (const juce::MouseEvent& e) override;
+    void mouseDrag (const juce::MouseEvent& e) override;
+    void mouseUp (const juce::MouseEvent& e) override;
+
+private:
+    juce::Rectangle<float> getPadArea() const;
+    juce::Rectangle<float> getCornerArea (int slot) const;
+    void showSlotMenu (int slot);
+    void moveTo (juce::Point<float> position);
+
+    StarlightDriftAudioProcessor& processor;
+    juce::Colour accent;
+    std::unique_ptr<juce::ParameterAttachment> attX, attY;
+    float x = 0.0f, y = 0.0f;
+    bool dragging = false;
+
+    JUCE_DECLARE_NON_COPYABLE (MorphPad)
+};
@@ -0,0 +1,76 @@
+#include "PresetBrowser.h"
+
+#include "../PluginProcessor.h"
+
+PresetBrowser::PresetBrowser (StarlightDriftAudioProcessor& p) : processor (p)
+{
+    search.setTextToShowWhenEmpty ("Search presets", juce::Colours::white.withAlpha (0.4f));
+    search.onTextChange = [this] { refilter(); };
+    addAndMakeVisible (search);
+
+    // item id 1 is every category, then the bank's own from 2
+    category.addItem ("ALL", 1);
+    category.addItemList (processor.getPresetBank().getCategories(), 2);
+    category.setSelectedId (1, juce::dontSendNotification);
+    category.onChange = [this] { refilter(); };
+    addAndMakeVisible (category);
+
+    list.setRowHeight (22);
+    list.setColour (juce::ListBox::backgroundColourId, juce::Colours::transparentBlack);
+    addAndMakeVisible (list);
+
+    setSize (260, 320);
+    refilter();
+}
+
+void PresetBrowser::resized()
+{
+    auto area = getLocalBounds().reduced (6);
+    auto top = area.removeFromTop (24);
+    category.setBounds (top.removeFromRight (90));
+    top.removeFromRight (6);
+    search.setBounds (top);
+    area.removeFromTop (6);
+    list.setBounds (area);
+}
+
+void PresetBrowser::refilter()
+{
+    const auto categoryName = category.getSelectedId() > 1 ? category.getText() : juce::String();
+    matches = processor.getPresetBank().find (search.getText(), categoryName);
+
+    list.updateContent();
+    list.deselectAllRows();
+
+    for (int row = 0; row < (int) matches.size(); ++row)
+        if (matches[(size_t) row] == processor.getCurrentProgram())
+            list.selectRow (row, true, true);
+
+    list.repaint();
+}
+
+void PresetBrowser::paintListBoxItem (int row, juce::Graphics& g, int width, int height, bool selected)
+{
+    if (! juce::isPositiveAndBelow (row, (int) matches.size()))
+        return;
+
+    const auto& bank = processor.getPresetBank();
+    const int index = matches[(size_t) row];
+
+    if (selected)
+        g.fillAll (juce::Colours::white.withAlpha (0.15f));
+
+    g.setFont (13.0f);
+    g.setColour (juce::Colours::white.withAlpha (0.9f));
+    g.drawText (bank.getName (index), 6, 0, width - 96, height, juce::Justification::centredLeft, true);
+
+    g.setFont (11.0f);
+    g.setColour (juce::Colours::white.withAlpha (0.45f));
+    g.drawText (bank.getCategory (index).toUpperCase(), width - 90, 0, 84, height, juce::Justification::centredRight, true);
+}
+
+void PresetBrowser::listBoxItemClicked (int row, const juce::MouseEvent&)
+{
+    if (juce::isPositiveAndBelow (row, (int) matches.size()))
+        processor.setCurrentProgram (matches[(size_t) row]);
+}
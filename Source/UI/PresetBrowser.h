@@ -0,0 +1,29 @@
+#pragma once
+
+#include <juce_gui_basics/juce_gui_basics.h>
+
+#include <vector>
+
+class StarlightDriftAudioProcessor;
+
+// Searches the preset bank as you type and loads the preset you click.
+class PresetBrowser final : public juce::Component, private juce::ListBoxModel
+{
+public:
+    explicit PresetBrowser (StarlightDriftAudioProcessor& p);
+
+    void resized() override;
+
+private:
+    int getNumRows() override { return (int) matches.size(); }
+    void paintListBoxItem (int row, juce::Graphics& g, int width, int height, bool selected) override;
+    void listBoxItemClicked (int row, const juce::MouseEvent&) override;
+
+    void refilter();
+
+    StarlightDriftAudioProcessor& processor;
+    juce::TextEditor search;
+    juce::ComboBox category;
+    juce::ListBox list { {}, this };
+    std::vector<int> matches;
+};
@@ -0,0 +1,89 @@
+#include "TapEditor.h"
+
+#include "../PluginProcessor.h"
+
+TapEditor::TapEditor (StarlightDriftAudioProcessor& p) : processor (p)
+{
+    const auto taps = processor.getTaps();
+    const auto& densitySpec = paramSpecs[ParamIndex::density];
+    const auto& pitchSpec = paramSpecs[ParamIndex::pitchSemi];
+
+    for (int t = 0; t < GranularDelay::maxTaps; ++t)
+    {
+        auto& row = rows[(size_t) t];
+        const bool inUse = t < (int) taps.size();
+        const auto tap = inUse ? taps[(size_t) t] : GranularDelay::Tap();
+
+        row.enabled.setButtonText ("TAP " + juce::String (t + 1));
+        row.enabled.setToggleState (inUse, juce::dontSendNotification);
+        row.enabled.onClick = [this] { sendTaps(); };
+        addAndMakeVisible (row.enabled);
+
+        setupSlider (row.time, 1.0, GranularDelay::maxDelayTimeMs, 1.0, " ms");
+        setupSlider (row.density, densitySpec.minValue, densitySpec.maxValue, 0.1, "/s");
+        setupSlider (row.pitch, pitchSpec.minValue, pitchSpec.maxValue, 0.01, " st");
+        setupSlider (row.pan, -1.0, 1.0, 0.01, {});
+        setupSlider (row.level, 0.0, 1.0, 0.01, {});
+
+        row.time.setSkewFactor (0.35);
+        row.time.setValue (tap.delayTimeMs, juce::dontSendNotification);
+        row.density.setValue (tap.density, juce::dontSendNotification);
+        row.pitch.setValue (tap.pitchSemitones, juce::dontSendNotification);
+        row.pan.setValue (tap.pan, juce::dontSendNotification);
+        row.level.setValue (tap.level, juce::dontSendNotification);
+    }
+
+    header.setText ("TIME / RATE / PITCH / PAN / LEVEL", juce::dontSendNotification);
+    header.setJustificationType (juce::Justification::centredRight);
+    header.setColour (juce::Label::textColourId, juce::Colours::white.withAlpha (0.45f));
+    header.setFont (juce::Font (11.0f, juce::Font::plain));
+    addAndMakeVisible (header);
+
+    setSize (560, 24 + 30 * GranularDelay::maxTaps);
+}
+
+void TapEditor::setupSlider (juce::Slider& slider, double min, double max, double interval, const juce::String& suffix)
+{
+    slider.setSliderStyle (juce::Slider::LinearBar);
+    slider.setRange (min, max, interval);
+    slider.setTextValueSuffix (suffix);
+    slider.onValueChange = [this] { sendTaps(); };
+    addAndMakeVisible (slider);
+}
+
+void TapEditor::resized()
+{
+    auto area = getLocalBounds().reduced (6);
+    header.setBounds (area.removeFromTop (18));
+
+    for (auto& row : rows)
+    {
+        auto r = area.removeFromTop (30).reduced (0, 3);
+        row.enabled.setBounds (r.removeFromLeft (70));
+
+        const int w = r.getWidth() / 5;
+        for (auto* s : { &row.time, &row.density, &row.pitch, &row.pan, &row.level })
+            s->setBounds (r.removeFromLeft (w).reduced (2, 0));
+    }
+}
+
+void TapEditor::sendTaps()
+{
+    std::vector<GranularDelay::Tap> taps;
+
+    for (const auto& row : rows)
+    {
+        if (! row.enabled.getToggleState())
+            continue;
+
+        GranularDelay::Tap t;
+        t.delayTimeMs = (float) row.time.getValue();
+        t.density = (float) row.density.getValue();
+        t.pitchSemitones = (float) row.pitch.getValue();
+        t.pan = (float) row.pan.getValue();
+        t.level = (float) row.level.getValue();
+        taps.push_back (t);
+    }
+
+    processor.setTaps (taps);
+}
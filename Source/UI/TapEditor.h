@@ -0,0 +1,33 @@
+#pragma once
+
+#include <juce_gui_basics/juce_gui_basics.h>
+
+#include "../DSP/GranularDelay.h"
+
+#include <array>
+
+class StarlightDriftAudioProcessor;
+
+// The grain taps: a row per tap with its switch and its time, rate, pitch, position and
+// level. Every change sends the switched-on taps to the processor.
+class TapEditor final : public juce::Component
+{
+public:
+    explicit TapEditor (StarlightDriftAudioProcessor& p);
+
+    void resized() override;
+
+private:
+    struct Row
+    {
+        juce::ToggleButton enabled;
+        juce::Slider time, density, pitch, pan, level;
+    };
+
+    void setupSlider (juce::Slider& slider, double min, double max, double interval, const juce::String& suffix);
+    void sendTaps();
+
+    StarlightDriftAudioProcessor& processor;
+    std::array<Row, GranularDelay::maxTaps> rows;
+    juce::Label header;
+};
@@ -0,0 +1,351 @@
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <juce_events/juce_events.h>
+
+#include "../Source/PluginProcessor.h"
+
+#include <cmath>
+#include <iostream>
+
+// Golden-output regression tests. Renders fixed input signals through presets
+// covering every engine mode and null-tests them against WAVs in Tests/Golden,
+// checks that the output doesn't depend on the host block size or on whether
+// automation arrives at block boundaries or as parameter events, never contains
+// NaN/Inf, and that processBlock stays allocation- and lock-free.
+//
+// A missing golden is a failure. Record them all with --record, after an
+// intentional change in sound too, and commit the WAVs.
+
+namespace
+{
+    constexpr double sampleRate = 48000.0;
+    constexpr int referenceBlockSize = 512;
+    constexpr juce::int64 renderSeed = 0x5eed;
+    constexpr int inputSamples = 96000;  // 2 s of signal
+    constexpr int tailSamples = 48000;   // 1 s of tail
+    constexpr int changeAtSample = 36000;
+
+    struct Settings
+    {
+        juce::File goldenDir;
+        bool record = false;
+        double toleranceDb = -80.0;
+    };
+
+    Settings settings;
+
+    struct Preset
+    {
+        const char* name;
+        std::vector<std::pair<const char*, float>> params;
+        std::vector<const char*> locks;
+        std::vector<std::pair<const char*, float>> changes; // applied at changeAtSample
+        std::vector<GranularDelay::Tap> taps;
+    };
+
+    std::vector<Preset> makePresets()
+    {
+        return {
+            { "default", {}, {}, {} },
+            { "denseAir", { { "density", 40.0f }, { "air", 1.0f }, { "grainSizeMs", 250.0f }, { "jitter", 1.0f } }, {}, {} },
+            { "glassPitch", { { "glass", 1.0f }, { "pitchSemi", -12.0f }, { "feedback", 0.8f } }, {}, {} },
+            { "macrosLocked", { { "air", 1.0f }, { "glass", 1.0f } }, { "density", "tone", "spread", "grainSizeMs" }, {} },
+            { "freeze", { { "feedback", 0.6f } }, {}, { { "freeze", 1.0f } } },
+            { "shimmer5", { { "shimmerPitch", 0.0f }, { "shimmerAmt", 1.0f } }, {}, {} },
+            { "shimmer7", { { "shimmerPitch", 1.0f }, { "shimmerAmt", 1.0f } }, {}, {} },
+            { "shimmer12", { { "shimmerPitch", 2.0f }, { "shimmerAmt", 1.0f } }, {}, {} },
+            { "shimmer24", { { "shimmerPitch", 3.0f }, { "shimmerAmt", 1.0f } }, {}, {} },
+            { "filters", { { "hpEnable", 1.0f }, { "hpFreq", 400.0f }, { "lpEnable", 1.0f }, { "lpFreq", 3000.0f } }, {}, {} },
+            { "mixAndGain", { { "mix", 0.3f }, { "inputGain", 6.0f }, { "outputGain", -6.0f } }, {}, {} },
+            { "mixAutomation", { { "mix", 0.8f } }, {}, { { "mix", 0.2f }, { "outputGain", -9.0f }, { "delayTimeMs", 120.0f } } },
+            { "modulation", { { "drift", 1.0f }, { "modRate", 4.0f }, { "modDepth", 1.0f }, { "reverbSize", 1.0f } }, {}, {} },
+            { "earlyReflections", { { "early", 0.8f }, { "reverbSize", 0.9f } }, {}, { { "reverbSize", 0.2f } } },
+            { "taps", { { "feedback", 0.5f } }, {}, {}, { { 150.0f, 12.0f, 7.0f, -0.8f, 0.7f }, { 300.0f, 6.0f, -12.0f, 0.8f, 0.5f } } },
+        };
+    }
+
+    juce::AudioBuffer<float> makeSignal (const juce::String& name)
+    {
+        juce::AudioBuffer<float> buffer (2, inputSamples + tailSamples);
+        buffer.clear();
+
+        if (name == "impulse")
+        {
+            buffer.setSample (0, 100, 0.5f);
+            buffer.setSample (1, 100, 0.5f);
+        }
+        else if (name == "sineSweep")
+        {
+            // exponential sweep 20 Hz -> 20 kHz
+            const double duration = inputSamples / sampleRate;
+            const double k = std::log (20000.0 / 20.0);
+            for (int i = 0; i < inputSamples; ++i)
+            {
+                const double t = i / sampleRate;
+                const double phase = juce::MathConstants<double>::twoPi * 20.0 * duration / k * (std::exp (t * k / duration) - 1.0);
+                const float v = 0.5f * (float) std::sin (phase);
+                buffer.setSample (0, i, v);
+                buffer.setSample (1, i, v);
+            }
+        }
+        else if (name == "noiseBursts")
+        {
+            juce::Random rng (42);
+            const int period = (int) (0.4 * sampleRate);
+            const int burst = (int) (0.05 * sampleRate);
+            for (int i = 0; i < inputSamples; ++i)
+            {
+                const bool on = (i % period) < burst;
+                for (int ch = 0; ch < 2; ++ch)
+                    buffer.setSample (ch, i, on ? 0.4f * (rng.nextFloat() * 2.0f - 1.0f) : 0.0f);
+            }
+        }
+
+        return buffer;
+    }
+
+    void setParam (StarlightDriftAudioProcessor& proc, const char* id, float value)
+    {
+        if (auto* param = proc.getAPVTS().getParameter (id))
+            param->setValueNotifyingHost (param->convertTo0to1 (value));
+        else
+            jassertfalse;
+    }
+
+    // changesAsEvents: deliver the preset's changes as parameter events within a block
+    // instead of splitting the blocks there
+    juce::AudioBuffer<float> render (const Preset& preset, const juce::AudioBuffer<float>& input, int blockSize,
+                                     bool changesAsEvents = false)
+    {
+        StarlightDriftAudioProcessor proc;
+        proc.setRandomSeed (renderSeed);
+
+        // the CPU governor would make the output depend on how fast the machine is
+        setParam (proc, ParamIDs::cpuGuard, 0.0f);
+
+        for (const auto& [id, value] : preset.params)
+            setParam (proc, id, value);
+        for (auto* id : preset.locks)
+            proc.setParamLocked (id, true);
+
+        proc.setTaps (preset.taps);
+
+        proc.setPlayConfigDetails (2, 2, sampleRate, blockSize);
+        proc.prepareToPlay (sampleRate, blockSize);
+
+        juce::AudioBuffer<float> output;
+        output.makeCopyOf (input);
+
+        juce::MidiBuffer midi;
+        const int total = output.getNumSamples();
+
+        for (int pos = 0; pos < total;)
+        {
+            int n = juce::jmin (blockSize, total - pos);
+
+            if (changesAsEvents)
+            {
+                // the parameter at its final value and an event saying when it got there
+                if (pos <= changeAtSample && changeAtSample < pos + n)
+                {
+                    for (const auto& [id, value] : preset.changes)
+                    {
+                        setParam (proc, id, value);
+                        proc.addParameterEvent (changeAtSample - pos, ParameterSnapshot::indexOf (id), value);
+                    }
+                }
+            }
+            else
+            {
+                if (pos == changeAtSample)
+                    for (const auto& [id, value] : preset.changes)
+                        setParam (proc, id, value);
+
+                // split blocks at the change point, like a host delivering sample-accurate automation would
+                if (pos < changeAtSample && pos + n > changeAtSample)
+                    n = changeAtSample - pos;
+            }
+
+            juce::AudioBuffer<float> view (output.getArrayOfWritePointers(), 2, pos, n);
+            proc.processBlock (view, midi);
+            pos += n;
+        }
+
+        proc.releaseResources();
+        return output;
+    }
+
+    double toDb (double v) { return 20.0 * std::log10 (juce::jmax (1.0e-12, v)); }
+
+    struct Difference
+    {
+        double peakDb = -240.0;
+        double rmsDb = -240.0;
+    };
+
+    Difference getDifference (const juce::AudioBuffer<float>& a, const juce::AudioBuffer<float>& b)
+    {
+        double peak = 0.0, sumSq = 0.0;
+        const int n = juce::jmin (a.getNumSamples(), b.getNumSamples());
+
+        for (int ch = 0; ch < juce::jmin (a.getNumChannels(), b.getNumChannels()); ++ch)
+        {
+            for (int i = 0; i < n; ++i)
+            {
+                const double d = (double) a.getSample (ch, i) - (double) b.getSample (ch, i);
+                peak = juce::jmax (peak, std::abs (d));
+                sumSq += d * d;
+            }
+        }
+
+        return { toDb (peak), toDb (std::sqrt (sumSq / juce::jmax (1, n * a.getNumChannels()))) };
+    }
+
+    bool allFinite (const juce::AudioBuffer<float>& buffer)
+    {
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+                if (! std::isfinite (buffer.getSample (ch, i)))
+                    return false;
+
+        return true;
+    }
+
+    bool writeWav (const juce::File& file, const juce::AudioBuffer<float>& buffer)
+    {
+        file.getParentDirectory().createDirectory();
+        file.deleteFile();
+
+        auto stream = std::make_unique<juce::FileOutputStream> (file);
+        if (! stream->openedOk())
+            return false;
+
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::AudioFormatWriter> writer (wav.createWriterFor (stream.get(), sampleRate, (unsigned int) buffer.getNumChannels(), 32, {}, 0));
+        if (writer == nullptr)
+            return false;
+
+        stream.release(); // owned by the writer now
+        return writer->writeFromAudioSampleBuffer (buffer, 0, buffer.getNumSamples());
+    }
+
+    bool readWav (const juce::File& file, juce::AudioBuffer<float>& buffer)
+    {
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::AudioFormatReader> reader (wav.createReaderFor (file.createInputStream().release(), true));
+        if (reader == nullptr)
+            return false;
+
+        buffer.setSize ((int) reader->numChannels, (int) reader->lengthInSamples);
+        return reader->read (&buffer, 0, (int) reader->lengthInSamples, 0, true, true);
+    }
+}
+
+class GoldenOutputTests final : public juce::UnitTest
+{
+public:
+    GoldenOutputTests() : juce::UnitTest ("Golden output", "StarlightDrift") {}
+
+    void runTest() override
+    {
+        const juce::StringArray signals { "impulse", "sineSweep", "noiseBursts" };
+
+        for (const auto& preset : makePresets())
+        {
+            for (const auto& signalName : signals)
+            {
+                beginTest (juce::String (preset.name) + " / " + signalName);
+
+                const auto input = makeSignal (signalName);
+
+                RealtimeSafety::clear();
+                const auto output = render (preset, input, referenceBlockSize);
+
+                expect (RealtimeSafety::getViolationCount() == 0, RealtimeSafety::formatViolations());
+                expect (allFinite (output), "output contains NaN or Inf");
+
+                checkAgainstGolden (settings.goldenDir.getChildFile (juce::String (preset.name) + "_" + signalName + ".wav"), output);
+
+                if (signalName == "noiseBursts")
+                    checkBlockSizeInvariance (preset, input, output);
+            }
+        }
+    }
+
+private:
+    void checkAgainstGolden (const juce::File& goldenFile, const juce::AudioBuffer<float>& output)
+    {
+        if (settings.record)
+        {
+            expect (writeWav (goldenFile, output), "couldn't write " + goldenFile.getFullPathName());
+            logMessage ("recorded " + goldenFile.getFileName());
+            return;
+        }
+
+        if (! goldenFile.existsAsFile())
+        {
+            expect (false, "missing golden file " + goldenFile.getFullPathName() + " (record it with --record)");
+            return;
+        }
+
+        juce::AudioBuffer<float> golden;
+        expect (readWav (goldenFile, golden), "couldn't read " + goldenFile.getFullPathName());
+        expectEquals (golden.getNumSamples(), output.getNumSamples(), "golden length");
+        expectEquals (golden.getNumChannels(), output.getNumChannels(), "golden channel count");
+
+        const auto diff = getDifference (output, golden);
+        expect (diff.rmsDb <= settings.toleranceDb && diff.peakDb <= settings.toleranceDb + 20.0,
+                "null test failed against " + goldenFile.getFileName()
+                    + ": residual rms " + juce::String (diff.rmsDb, 1) + " dB, peak " + juce::String (diff.peakDb, 1) + " dB");
+    }
+
+    void checkBlockSizeInvariance (const Preset& preset, const juce::AudioBuffer<float>& input, const juce::AudioBuffer<float>& reference)
+    {
+        for (int blockSize : { 1, 37, 4096 })
+        {
+            const auto output = render (preset, input, blockSize);
+            const auto diff = getDifference (output, reference);
+
+            expect (allFinite (output), "output contains NaN or Inf at block size " + juce::String (blockSize));
+            expect (diff.peakDb <= -120.0,
+                    "block size " + juce::String (blockSize) + " differs from " + juce::String (referenceBlockSize)
+                        + " by " + juce::String (diff.peakDb, 1) + " dB peak");
+        }
+
+        if (! preset.changes.empty())
+        {
+            const auto output = render (preset, input, 4096, true);
+            const auto diff = getDifference (output, reference);
+
+            expect (diff.peakDb <= -120.0,
+                    "changes delivered as parameter events differ from split blocks by " + juce::String (diff.peakDb, 1) + " dB peak");
+        }
+    }
+};
+
+static GoldenOutputTests goldenOutputTests;
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInit;
+
+    const juce::ArgumentList args (argc, argv);
+    const auto cwd = juce::File::getCurrentWorkingDirectory();
+
+    settings.goldenDir = cwd.getChildFile (args.containsOption ("--golden-dir") ? args.getValueForOption ("--golden-dir")
+                                                                               : juce::String ("Tests/Golden"));
+    settings.record = args.containsOption ("--record");
+    if (args.containsOption ("--tolerance-db"))
+        settings.toleranceDb = args.getValueForOption ("--tolerance-db").getDoubleValue();
+
+    juce::UnitTestRunner runner;
+    runner.setAssertOnFailure (false);
+    runner.runTestsInCategory ("StarlightDrift");
+
+    int failures = 0;
+    for (int i = 0; i < runner.getNumResults(); ++i)
+        failures += runner.getResult (i)->failures;
+
+    std::cout << (failures == 0 ? "All tests passed" : juce::String (failures) + " failure(s)") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,76 @@
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "../Source/Diagnostics/RealtimeSafety.h"
+#include "../Source/Engine/StarlightEngine.h"
+
+#include <cstring>
+
+// Holds GrainCloud to its class comment: without a deadline the output is bit-identical
+// for any number of workers, and the workers render it without allocating or locking.
+class GrainCloudTests final : public juce::UnitTest
+{
+public:
+    GrainCloudTests() : juce::UnitTest ("Grain cloud workers", "StarlightDrift") {}
+
+    void runTest() override
+    {
+        beginTest ("No-deadline renders don't depend on the number of workers");
+
+        const auto reference = render (0);
+
+        for (int workers : { 1, 2, 3 })
+        {
+            RealtimeSafety::clear();
+            const auto output = render (workers);
+
+            expect (RealtimeSafety::getViolationCount() == 0, RealtimeSafety::formatViolations());
+            expect (isIdentical (output, reference), juce::String (workers) + " worker(s) differ from rendering on one thread");
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int blockSize = 512;
+    static constexpr int numBlocks = 200;
+
+    static juce::AudioBuffer<float> render (int numWorkers)
+    {
+        StarlightEngine engine;
+        engine.setRandomSeed (0x5eed);
+        engine.setCloudWorkers (numWorkers);
+        engine.setCloudBudget (0.0f); // no deadline, as offline
+        engine.prepare (sampleRate, blockSize, 2);
+
+        ParameterSnapshot params;
+        params.set (ParamIndex::cloudDensity, 4000.0f);
+        params.set (ParamIndex::cpuGuard, 0.0f);
+        engine.setParameters (params);
+
+        juce::AudioBuffer<float> buffer (2, blockSize * numBlocks);
+        juce::Random rng (42);
+        for (int ch = 0; ch < 2; ++ch)
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+                buffer.setSample (ch, i, 0.4f * (rng.nextFloat() * 2.0f - 1.0f));
+
+        for (int pos = 0; pos < buffer.getNumSamples(); pos += blockSize)
+        {
+            float* channels[] = { buffer.getWritePointer (0, pos), buffer.getWritePointer (1, pos) };
+
+            STARLIGHT_RT_AUDIO_THREAD_SCOPE;
+            engine.process (channels, blockSize);
+        }
+
+        return buffer;
+    }
+
+    static bool isIdentical (const juce::AudioBuffer<float>& a, const juce::AudioBuffer<float>& b)
+    {
+        for (int ch = 0; ch < a.getNumChannels(); ++ch)
+            if (std::memcmp (a.getReadPointer (ch), b.getReadPointer (ch), sizeof (float) * (size_t) a.getNumSamples()) != 0)
+                return false;
+
+        return true;
+    }
+};
+
+static GrainCloudTests grainCloudTests;
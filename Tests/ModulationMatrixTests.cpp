@@ -0,0 +1,117 @@
+#include <juce_core/juce_core.h>
+
+#include "../Source/Engine/ModulationMatrix.h"
+
+#include <cmath>
+
+// The default routings against the Air and Glass formulas the processor used before the
+// macros became routings, bit for bit, over a sweep of macro values, knob settings and
+// locks. Drift and everything else the macros never touched stays as set.
+class ModulationMatrixTests final : public juce::UnitTest
+{
+public:
+    ModulationMatrixTests() : juce::UnitTest ("Macro routings", "StarlightDrift") {}
+
+    void runTest() override
+    {
+        beginTest ("The default routings play Air and Glass as they always have");
+
+        ModulationMatrix matrix;
+        juce::Random rng (0x4d4d);
+        int numCompared = 0, numDiffering = 0;
+
+        const juce::uint32 lockSets[] = {
+            0,
+            (1u << ParamIndex::density) | (1u << ParamIndex::spread),
+            (1u << ParamIndex::tone) | (1u << ParamIndex::grainSizeMs) | (1u << ParamIndex::shimmerPitch),
+            (1u << ParamIndex::shimmerAmt) | (1u << ParamIndex::pitchSemi),
+        };
+
+        for (int a = 0; a <= macroSteps; ++a)
+        {
+            for (int g = 0; g <= macroSteps; ++g)
+            {
+                for (const auto locks : lockSets)
+                {
+                    auto snapshot = randomKnobs (rng);
+                    snapshot.set (ParamIndex::air, (float) a / (float) macroSteps);
+                    snapshot.set (ParamIndex::glass, (float) g / (float) macroSteps);
+                    snapshot.lockMask = locks;
+
+                    const auto choice = (int) snapshot.get (ParamIndex::shimmerPitch);
+                    float interval = shimmerIntervals[(size_t) choice];
+
+                    auto expected = snapshot;
+                    const float expectedInterval = applyBaseline (expected, interval);
+
+                    matrix.apply (snapshot, interval);
+
+                    ++numCompared;
+                    if (snapshot.values != expected.values || interval != expectedInterval)
+                        ++numDiffering;
+                }
+            }
+        }
+
+        expectEquals (numDiffering, 0, juce::String (numDiffering) + " of " + juce::String (numCompared) + " differ");
+    }
+
+private:
+    static constexpr int macroSteps = 40;
+    static constexpr float shimmerIntervals[] = { 5.0f, 7.0f, 12.0f, 24.0f };
+
+    static ParameterSnapshot randomKnobs (juce::Random& rng)
+    {
+        ParameterSnapshot s;
+
+        for (int i = 0; i < ParamIndex::count; ++i)
+        {
+            const auto& spec = paramSpecs[i];
+            const float value = spec.minValue + rng.nextFloat() * (spec.maxValue - spec.minValue);
+            s.set (i, spec.kind == ParamSpec::Kind::continuous ? value : std::round (value));
+        }
+
+        // the ends of the ranges, where the old formulas could go past them
+        if (rng.nextInt (4) == 0)
+        {
+            s.set (ParamIndex::density, paramSpecs[ParamIndex::density].maxValue);
+            s.set (ParamIndex::grainSizeMs, paramSpecs[ParamIndex::grainSizeMs].minValue);
+            s.set (ParamIndex::pitchSemi, paramSpecs[ParamIndex::pitchSemi].maxValue);
+            s.set (ParamIndex::tone, 1.0f);
+            s.set (ParamIndex::spread, 1.0f);
+        }
+
+        return s;
+    }
+
+    // The processor's parameter update before the macros became routings, formula for formula.
+    static float applyBaseline (ParameterSnapshot& s, float baseShimmerPitch)
+    {
+        const auto air = s.get (ParamIndex::air);
+        const auto glass = s.get (ParamIndex::glass);
+
+        const auto density = s.get (ParamIndex::density);
+        const auto tone = s.get (ParamIndex::tone);
+        const auto shimmerAmt = s.get (ParamIndex::shimmerAmt);
+        const auto grainSizeMs = s.get (ParamIndex::grainSizeMs);
+        const auto spread = s.get (ParamIndex::spread);
+        const auto pitchSemi = s.get (ParamIndex::pitchSemi);
+
+        s.set (ParamIndex::density, s.isLocked (ParamIndex::density) ? density
+                                    : density * (1.0f + 0.8f * air));
+        s.set (ParamIndex::tone, s.isLocked (ParamIndex::tone) ? tone
+                                 : juce::jlimit (0.0f, 1.0f, tone + 0.25f * air));
+        s.set (ParamIndex::shimmerAmt, s.isLocked (ParamIndex::shimmerAmt) ? shimmerAmt
+                                       : juce::jlimit (0.0f, 1.0f, shimmerAmt + 0.35f * air));
+        s.set (ParamIndex::grainSizeMs, s.isLocked (ParamIndex::grainSizeMs) ? grainSizeMs
+                                        : grainSizeMs * (1.0f - 0.35f * glass));
+        s.set (ParamIndex::spread, s.isLocked (ParamIndex::spread) ? spread
+                                   : juce::jlimit (0.0f, 1.0f, spread + 0.5f * glass));
+        s.set (ParamIndex::pitchSemi, s.isLocked (ParamIndex::pitchSemi) ? pitchSemi
+                                      : pitchSemi + 2.0f * glass);
+
+        return baseShimmerPitch + (glass * 12.0f);
+    }
+};
+
+static ModulationMatrixTests modulationMatrixTests;
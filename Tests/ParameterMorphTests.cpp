@@ -0,0 +1,169 @@
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "../Source/Engine/ParameterMorph.h"
+
+#include <utility>
+
+// ParameterMorph against its class comment: the corners' values exactly on the corners, a
+// bilinear blend on the knobs' skewed scales in between, unstored corners holding the
+// parameters' own settings, toggles following the nearest corner with a margin, and
+// locked parameters, CPU Guard and the morph position left alone.
+class ParameterMorphTests final : public juce::UnitTest
+{
+public:
+    ParameterMorphTests() : juce::UnitTest ("Parameter morph", "StarlightDrift") {}
+
+    void runTest() override
+    {
+        beginTest ("Nothing stored, nothing morphed");
+        {
+            ParameterMorph morph;
+            const auto own = at (0.3f, 0.7f);
+            auto snapshot = own;
+            morph.apply (snapshot);
+            expect (snapshot.values == own.values);
+        }
+
+        const auto a = corner (0.1f, 100.0f, false);
+        const auto b = corner (0.9f, 10000.0f, true);
+        const auto c = corner (0.3f, 400.0f, false);
+        const auto d = corner (0.6f, 2000.0f, true);
+
+        beginTest ("Corners play their snapshots as stored");
+        {
+            ParameterMorph morph;
+            morph.storeSlot (0, a);
+            morph.storeSlot (1, b);
+            morph.storeSlot (2, c);
+            morph.storeSlot (3, d);
+
+            const std::pair<const ParameterSnapshot*, std::pair<float, float>> corners[] = {
+                { &a, { 0.0f, 0.0f } }, { &b, { 1.0f, 0.0f } }, { &c, { 0.0f, 1.0f } }, { &d, { 1.0f, 1.0f } }
+            };
+
+            for (const auto& [expected, position] : corners)
+            {
+                auto snapshot = at (position.first, position.second);
+                morph.apply (snapshot);
+                expectEquals (snapshot.get (ParamIndex::feedback), expected->get (ParamIndex::feedback));
+                expectEquals (snapshot.get (ParamIndex::hpFreq), expected->get (ParamIndex::hpFreq));
+            }
+        }
+
+        beginTest ("Between corners the blend is bilinear on the knobs' scales");
+        {
+            ParameterMorph morph;
+            morph.storeSlot (0, a);
+            morph.storeSlot (1, b);
+            morph.storeSlot (2, c);
+            morph.storeSlot (3, d);
+
+            const std::pair<float, float> positions[] = { { 0.5f, 0.0f }, { 0.25f, 0.75f }, { 0.8f, 0.4f }, { 0.5f, 0.5f } };
+
+            for (const auto& [x, y] : positions)
+            {
+                auto snapshot = at (x, y);
+                morph.apply (snapshot);
+
+                const float weights[] = { (1.0f - x) * (1.0f - y), x * (1.0f - y), (1.0f - x) * y, x * y };
+                const ParameterSnapshot* corners[] = { &a, &b, &c, &d };
+
+                // Feedback's scale is linear; HP Freq's is skewed, as the knob maps it
+                float feedback = 0.0f, hp = 0.0f;
+                for (int s = 0; s < 4; ++s)
+                {
+                    feedback += weights[s] * corners[s]->get (ParamIndex::feedback);
+                    hp += weights[s] * hpRange().convertTo0to1 (corners[s]->get (ParamIndex::hpFreq));
+                }
+
+                expectWithinAbsoluteError (snapshot.get (ParamIndex::feedback), feedback, 1.0e-5f);
+                expectWithinAbsoluteError (snapshot.get (ParamIndex::hpFreq), hpRange().convertFrom0to1 (hp), hpRange().convertFrom0to1 (hp) * 1.0e-4f);
+            }
+
+            // on a skewed scale, halfway from 100 Hz to 10 kHz isn't the arithmetic mean
+            auto half = at (0.5f, 0.0f);
+            morph.apply (half);
+            expect (half.get (ParamIndex::hpFreq) < 0.5f * (100.0f + 10000.0f));
+        }
+
+        beginTest ("An unstored corner holds the parameters' own settings");
+        {
+            ParameterMorph morph;
+            morph.storeSlot (0, a);
+
+            auto snapshot = at (0.5f, 0.0f);
+            const float own = snapshot.get (ParamIndex::feedback);
+            morph.apply (snapshot);
+            expectWithinAbsoluteError (snapshot.get (ParamIndex::feedback), 0.5f * (a.get (ParamIndex::feedback) + own), 1.0e-5f);
+
+            // on B's corner: only the parameters' own settings
+            auto onB = at (1.0f, 0.0f);
+            morph.apply (onB);
+            expectEquals (onB.get (ParamIndex::feedback), own);
+        }
+
+        beginTest ("Toggles follow the nearest corner with a margin");
+        {
+            ParameterMorph morph;
+            morph.storeSlot (0, a);
+            morph.storeSlot (1, b);
+
+            const std::pair<float, bool> sweep[] = { { 0.4f, false }, { 0.52f, false }, { 0.6f, true }, { 0.48f, true }, { 0.4f, false } };
+
+            for (const auto& [x, frozen] : sweep)
+            {
+                auto snapshot = at (x, 0.0f);
+                morph.apply (snapshot);
+                expect (snapshot.getBool (ParamIndex::freeze) == frozen, "Morph " + juce::String (x));
+            }
+        }
+
+        beginTest ("Locked parameters, CPU Guard and the morph position are left alone");
+        {
+            ParameterMorph morph;
+            morph.storeSlot (0, a);
+            morph.storeSlot (1, b);
+
+            auto snapshot = at (0.7f, 0.2f);
+            snapshot.set (ParamIndex::feedback, 0.5f);
+            snapshot.lockMask = 1u << ParamIndex::feedback;
+            snapshot.set (ParamIndex::cpuGuard, 3.0f);
+            const auto before = snapshot;
+
+            morph.apply (snapshot);
+
+            expectEquals (snapshot.get (ParamIndex::feedback), 0.5f);
+            expectEquals (snapshot.get (ParamIndex::cpuGuard), before.get (ParamIndex::cpuGuard));
+            expectEquals (snapshot.get (ParamIndex::morph), 0.7f);
+            expectEquals (snapshot.get (ParamIndex::morphY), 0.2f);
+            expect (snapshot.get (ParamIndex::hpFreq) != before.get (ParamIndex::hpFreq), "unlocked parameters are morphed");
+        }
+    }
+
+private:
+    static ParameterSnapshot corner (float feedback, float hpFreq, bool freeze)
+    {
+        ParameterSnapshot s;
+        s.set (ParamIndex::feedback, feedback);
+        s.set (ParamIndex::hpFreq, hpFreq);
+        s.set (ParamIndex::freeze, freeze ? 1.0f : 0.0f);
+        s.set (ParamIndex::cpuGuard, 0.0f);
+        return s;
+    }
+
+    static ParameterSnapshot at (float x, float y)
+    {
+        ParameterSnapshot s;
+        s.set (ParamIndex::morph, x);
+        s.set (ParamIndex::morphY, y);
+        return s;
+    }
+
+    static juce::NormalisableRange<float> hpRange()
+    {
+        const auto& spec = paramSpecs[ParamIndex::hpFreq];
+        return { spec.minValue, spec.maxValue, 0.0f, spec.skew };
+    }
+};
+
+static ParameterMorphTests parameterMorphTests;
@@ -0,0 +1,99 @@
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "../Source/Engine/StarlightEngine.h"
+
+#include <cstring>
+#include <vector>
+
+// Holds setPipelined() to its comment: turbo output is the serial output delayed by
+// getLatencySamples(), bit for bit, with one channel group and with several sharing the
+// group workers. Also checks that calls longer than the prepared block size come out as
+// if the host had made maximum-size calls.
+class PipelineTests final : public juce::UnitTest
+{
+public:
+    PipelineTests() : juce::UnitTest ("Turbo mode", "StarlightDrift") {}
+
+    void runTest() override
+    {
+        for (int numChannels : { 2, 6 })
+        {
+            beginTest ("Pipelined output matches the serial path, " + juce::String (numChannels) + " channels");
+
+            int latency = 0;
+            const auto serial = render (numChannels, false, latency);
+            expectEquals (latency, 0);
+
+            const auto pipelined = render (numChannels, true, latency);
+            expectEquals (latency, blockSize);
+
+            const int numSamples = serial.getNumSamples() - latency;
+            bool identical = true;
+
+            for (int ch = 0; ch < numChannels; ++ch)
+                identical = identical && std::memcmp (pipelined.getReadPointer (ch, latency), serial.getReadPointer (ch),
+                                                      sizeof (float) * (size_t) numSamples) == 0;
+
+            expect (identical, "turbo output differs from the serial render");
+        }
+
+        for (bool pipelined : { false, true })
+        {
+            beginTest (juce::String ("Oversize calls are split, ") + (pipelined ? "pipelined" : "serial"));
+
+            int latency = 0;
+            const auto expected = render (2, pipelined, latency);
+            const auto oversize = render (2, pipelined, latency, 5 * blockSize / 2);
+
+            bool identical = true;
+            for (int ch = 0; ch < 2; ++ch)
+                identical = identical && std::memcmp (oversize.getReadPointer (ch), expected.getReadPointer (ch),
+                                                      sizeof (float) * (size_t) expected.getNumSamples()) == 0;
+
+            expect (identical, "oversize calls differ from maximum-size ones");
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int blockSize = 512;
+    static constexpr int numBlocks = 200;
+
+    static juce::AudioBuffer<float> render (int numChannels, bool pipelined, int& latency, int callSize = blockSize)
+    {
+        StarlightEngine engine;
+        engine.setRandomSeed (0x5eed);
+        engine.setPipelined (pipelined);
+        engine.setGroupWorkers (pipelined ? -1 : 0); // as the processor sets them offline
+        engine.setCloudBudget (0.0f);
+        engine.prepare (sampleRate, blockSize, numChannels);
+        latency = engine.getLatencySamples();
+
+        ParameterSnapshot params;
+        params.set (ParamIndex::feedback, 0.6f);
+        params.set (ParamIndex::shimmerAmt, 0.4f);
+        params.set (ParamIndex::cloudDensity, 400.0f);
+        params.set (ParamIndex::cpuGuard, 0.0f);
+        engine.setParameters (params);
+
+        juce::AudioBuffer<float> buffer (numChannels, blockSize * numBlocks);
+        juce::Random rng (42);
+        for (int ch = 0; ch < numChannels; ++ch)
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+                buffer.setSample (ch, i, 0.4f * (rng.nextFloat() * 2.0f - 1.0f));
+
+        std::vector<float*> channels ((size_t) numChannels);
+
+        for (int pos = 0; pos < buffer.getNumSamples(); pos += callSize)
+        {
+            for (int ch = 0; ch < numChannels; ++ch)
+                channels[(size_t) ch] = buffer.getWritePointer (ch, pos);
+
+            engine.process (channels.data(), juce::jmin (callSize, buffer.getNumSamples() - pos));
+        }
+
+        return buffer;
+    }
+};
+
+static PipelineTests pipelineTests;
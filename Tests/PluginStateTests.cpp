@@ -0,0 +1,140 @@
+#include <juce_data_structures/juce_data_structures.h>
+
+#include "../Source/PluginState.h"
+
+#include <algorithm>
+#include <utility>
+
+// PluginState's format: a state survives writeTo() and readFrom() unchanged, and the
+// ValueTree the plugin saved before it loads with what it held.
+class PluginStateTests final : public juce::UnitTest
+{
+public:
+    PluginStateTests() : juce::UnitTest ("Plugin state", "StarlightDrift") {}
+
+    void runTest() override
+    {
+        testRoundTrip();
+        testOtherVersions();
+        testValueTree();
+    }
+
+private:
+    static PluginState makeState()
+    {
+        PluginState s;
+        s.params.set (ParamIndex::feedback, 0.7f);
+        s.params.set (ParamIndex::reverbSize, 0.9f);
+        s.params.set (ParamIndex::early, 0.4f);
+        s.params.lockMask = (1u << ParamIndex::density) | (1u << ParamIndex::early);
+        s.offlineTurbo = true;
+        s.delayStorage = 2;
+        s.longMemoryMinutes = 3;
+        s.keepFrozenTexture = true;
+        s.sampleFile = "/tmp/sample.wav";
+        s.program = 4;
+
+        s.morph.params[1].set (ParamIndex::delayTimeMs, 250.0f);
+        s.morph.storedMask = 1u << 1;
+
+        s.routings = ModulationMatrix::getDefaultRoutings();
+        s.routings.push_back (ModulationMatrix::Routing::make (ParamIndex::air, ParamIndex::reverbSize, 0.5f,
+                                                               ModulationMatrix::Mode::scale, ModulationMatrix::Curve::smooth));
+
+        GranularDelay::Tap tap;
+        tap.delayTimeMs = 300.0f;
+        tap.pitchSemitones = 7.0f;
+        tap.pan = -0.5f;
+        s.taps = { tap, {} };
+
+        s.reverbCapture = true;
+        return s;
+    }
+
+    void testRoundTrip()
+    {
+        beginTest ("writeTo() and readFrom()");
+
+        const auto state = makeState();
+        juce::MemoryOutputStream out;
+        state.writeTo (out);
+        out.writeInt (0x12345678); // the frozen texture's side block would start here
+
+        juce::MemoryInputStream in (out.getData(), out.getDataSize(), false);
+        PluginState read;
+        expect (read.readFrom (in));
+        expect (read == state, "the state changed on the way through");
+        expectEquals (in.readInt(), 0x12345678, "readFrom() didn't stop at the end of the state");
+
+        beginTest ("The shimmer interval's routing keeps its destination");
+        expect (std::any_of (read.routings.begin(), read.routings.end(),
+                             [] (const auto& r) { return r.destination == ModulationMatrix::shimmerInterval; }));
+    }
+
+    void testOtherVersions()
+    {
+        beginTest ("States of another version");
+
+        juce::MemoryOutputStream out;
+        makeState().writeTo (out);
+
+        // the version follows the tag
+        auto data = out.getMemoryBlock();
+        auto* version = static_cast<char*> (data.getData()) + 4;
+        expectEquals ((int) juce::ByteOrder::littleEndianInt (version), 1);
+        version[0] = 2;
+
+        juce::MemoryInputStream in (data, false);
+        PluginState read;
+        expect (! read.readFrom (in));
+    }
+
+    // What the plugin saved before the binary format: the APVTS tree, the lock flags and the
+    // settings as properties.
+    void testValueTree()
+    {
+        beginTest ("ValueTree state");
+
+        const std::pair<const char*, float> values[] = { { ParamIDs::feedback, 0.7f }, { ParamIDs::reverbSize, 0.9f }, { ParamIDs::density, 12.0f } };
+
+        juce::ValueTree params ("PARAMS");
+        for (const auto& [id, value] : values)
+        {
+            juce::ValueTree param ("PARAM");
+            param.setProperty ("id", juce::String (id), nullptr);
+            param.setProperty ("value", value, nullptr);
+            params.appendChild (param, nullptr);
+        }
+
+        juce::ValueTree locks ("Locks");
+        locks.setProperty (ParamIDs::density, true, nullptr);
+        locks.setProperty (ParamIDs::feedback, false, nullptr);
+
+        juce::ValueTree state ("StarlightDriftState");
+        state.setProperty ("offlineTurbo", true, nullptr);
+        state.setProperty ("delayStorage", 1, nullptr);
+        state.setProperty ("longMemoryMinutes", 2, nullptr);
+        state.setProperty ("sampleFile", "/tmp/sample.wav", nullptr);
+        state.appendChild (params, nullptr);
+        state.appendChild (locks, nullptr);
+
+        juce::MemoryOutputStream out;
+        state.writeToStream (out);
+
+        juce::MemoryInputStream in (out.getData(), out.getDataSize(), false);
+        PluginState read;
+        expect (read.readFrom (in));
+
+        expectEquals (read.params.get (ParamIndex::feedback), 0.7f);
+        expectEquals (read.params.get (ParamIndex::reverbSize), 0.9f);
+        expectEquals (read.params.get (ParamIndex::density), 12.0f);
+        expectEquals (read.params.get (ParamIndex::early), paramSpecs[ParamIndex::early].defaultValue);
+        expectEquals ((int) read.params.lockMask, (int) (1u << ParamIndex::density));
+        expect (read.offlineTurbo && read.delayStorage == 1 && read.longMemoryMinutes == 2 && ! read.keepFrozenTexture);
+        expectEquals (read.sampleFile, juce::String ("/tmp/sample.wav"));
+        expect (read.routings == ModulationMatrix::getDefaultRoutings(), "routings");
+        expect (read.taps.empty() && ! read.reverbCapture);
+    }
+};
+
+static PluginStateTests pluginStateTests;
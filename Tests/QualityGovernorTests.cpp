@@ -0,0 +1,153 @@
+#include <juce_core/juce_core.h>
+
+#include "../Source/Engine/QualityGovernor.h"
+
+// Drives QualityGovernor with made-up block timings and checks each level change against
+// its class comment: one level up per overrun or high smoothed load, a hold after every
+// change, and one level down only after recoverSeconds of low load.
+class QualityGovernorTests final : public juce::UnitTest
+{
+public:
+    QualityGovernorTests() : juce::UnitTest ("CPU governor", "StarlightDrift") {}
+
+    void runTest() override
+    {
+        beginTest ("Disabled or pinned, the level doesn't move");
+        {
+            QualityGovernor g;
+            g.prepare (sampleRate);
+            g.setRange (true, 0);
+            feed (g, 2.0, 100);
+            expectEquals (g.getLevel(), 0);
+
+            g.setEnabled (true);
+            g.prepare (sampleRate);
+            g.setRange (false, 3);
+            expectEquals (g.getLevel(), 3);
+            feed (g, 2.0, 100);
+            expectEquals (g.getLevel(), 3);
+        }
+
+        beginTest ("An overrun steps up at once, then holds");
+        {
+            QualityGovernor g;
+            start (g);
+            feed (g, 1.5, 1);
+            expectEquals (g.getLevel(), 1);
+
+            // overrunning all the while, the next step waits out the hold
+            expectEquals (blocksUntilChange (g, 1.5, 1000), holdBlocks);
+            expectEquals (g.getLevel(), 2);
+        }
+
+        beginTest ("A high smoothed load steps up without an overrun");
+        {
+            QualityGovernor g;
+            start (g);
+            feed (g, 0.9, 1);
+            expectEquals (g.getLevel(), 0);
+
+            const int blocks = blocksUntilChange (g, 0.9, 1000);
+            expect (blocks > 0 && blocks <= holdBlocks, "took " + juce::String (blocks) + " blocks");
+            expectEquals (g.getLevel(), 1);
+
+            // between the thresholds it neither climbs further nor recovers
+            feed (g, 0.5, 3 * recoverBlocks);
+            expectEquals (g.getLevel(), 1);
+        }
+
+        beginTest ("It stops at maxLevel");
+        {
+            QualityGovernor g;
+            start (g);
+            feed (g, 3.0, 20 * holdBlocks);
+            expectEquals (g.getLevel(), QualityGovernor::maxLevel);
+        }
+
+        beginTest ("It steps down one level after recoverSeconds of low load");
+        {
+            QualityGovernor g;
+            start (g);
+            feed (g, 2.0, 1);
+            feed (g, 2.0, holdBlocks);
+            expectEquals (g.getLevel(), 2);
+
+            const int first = blocksUntilChange (g, 0.0, 10 * recoverBlocks);
+            expect (first >= recoverBlocks && first <= recoverBlocks + holdBlocks, "took " + juce::String (first) + " blocks");
+            expectEquals (g.getLevel(), 1);
+
+            // the count starts again after each step
+            const int second = blocksUntilChange (g, 0.0, 10 * recoverBlocks);
+            expect (second >= recoverBlocks && second <= recoverBlocks + holdBlocks, "took " + juce::String (second) + " blocks");
+            expectEquals (g.getLevel(), 0);
+        }
+
+        beginTest ("A moderate load interrupts the recovery");
+        {
+            QualityGovernor g;
+            start (g);
+            feed (g, 2.0, 1);
+
+            feed (g, 0.0, holdBlocks + recoverBlocks * 3 / 4);
+            feed (g, 0.6, recoverBlocks / 2);
+            feed (g, 0.0, recoverBlocks * 3 / 4);
+            expectEquals (g.getLevel(), 1);
+
+            feed (g, 0.0, recoverBlocks);
+            expectEquals (g.getLevel(), 0);
+        }
+
+        beginTest ("The minimum level is a floor");
+        {
+            QualityGovernor g;
+            start (g);
+            g.setRange (true, 2);
+            expectEquals (g.getLevel(), 2);
+
+            feed (g, 1.5, 1);
+            expectEquals (g.getLevel(), 3);
+
+            feed (g, 0.0, 10 * recoverBlocks);
+            expectEquals (g.getLevel(), 2);
+        }
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int blockSize = 480; // 10 ms
+    static constexpr int holdBlocks = (int) (QualityGovernor::holdSeconds * sampleRate) / blockSize;
+    static constexpr int recoverBlocks = (int) (QualityGovernor::recoverSeconds * sampleRate) / blockSize;
+
+    static void start (QualityGovernor& g)
+    {
+        g.setEnabled (true);
+        g.prepare (sampleRate);
+        g.setRange (true, 0);
+    }
+
+    // load: the block's processing time as a fraction of its deadline
+    static void feed (QualityGovernor& g, double load, int numBlocks)
+    {
+        const auto ticks = (juce::int64) (load * blockSize / sampleRate * (double) juce::Time::getHighResolutionTicksPerSecond());
+
+        for (int i = 0; i < numBlocks; ++i)
+            g.update (ticks, blockSize);
+    }
+
+    // Blocks at `load` until the level changes, counting the one that changed it; -1 if it doesn't.
+    static int blocksUntilChange (QualityGovernor& g, double load, int maxBlocks)
+    {
+        const int level = g.getLevel();
+
+        for (int i = 1; i <= maxBlocks; ++i)
+        {
+            feed (g, load, 1);
+            if (g.getLevel() != level)
+                return i;
+        }
+
+        return -1;
+    }
+};
+
+static QualityGovernorTests qualityGovernorTests;
@@ -0,0 +1,41 @@
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include "../Source/PluginProcessor.h"
+
+// Checks that the audit sees what it claims to: the blocking spin-lock acquisitions marked
+// with STARLIGHT_RT_NOTE_LOCK count when they happen on an audio thread, and only there.
+class RealtimeSafetyTests final : public juce::UnitTest
+{
+public:
+    RealtimeSafetyTests() : juce::UnitTest ("Real-time safety audit", "StarlightDrift") {}
+
+    void runTest() override
+    {
+        StarlightDriftAudioProcessor proc;
+        const std::vector<GranularDelay::Tap> taps (2);
+        const auto snapshot = proc.getParameterSnapshot();
+
+        beginTest ("Spin locks taken off the audio thread");
+        {
+            RealtimeSafety::clear();
+            proc.setTaps (taps);
+            proc.getMorph().storeSlot (0, snapshot);
+            expectEquals (RealtimeSafety::getViolationCount(), (juce::int64) 0);
+        }
+
+        beginTest ("Spin locks taken on the audio thread");
+        {
+            RealtimeSafety::clear();
+            {
+                STARLIGHT_RT_AUDIO_THREAD_SCOPE;
+                proc.setTaps (taps);                      // StarlightEngine::tapLock
+                proc.getMorph().storeSlot (1, snapshot);  // ParameterMorph::slotLock
+            }
+
+            expectEquals (RealtimeSafety::getViolationCount(), (juce::int64) 2, RealtimeSafety::formatViolations());
+            RealtimeSafety::clear();
+        }
+    }
+};
+
+static RealtimeSafetyTests realtimeSafetyTests;
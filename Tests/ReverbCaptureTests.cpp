@@ -0,0 +1,212 @@
+#include <juce_dsp/juce_dsp.h>
+
+#include "../Source/Engine/ReverbCapture.h"
+
+#include <cmath>
+
+// Holds ReverbCapture to its class comment: handing over to the captured response and back
+// sounds like the reverb alone, each side's tail plays out for as long as the response
+// lasts, and rooms that ring on past maxImpulseSeconds are never captured.
+class ReverbCaptureTests final : public juce::UnitTest
+{
+public:
+    ReverbCaptureTests() : juce::UnitTest ("Reverb capture", "StarlightDrift") {}
+
+    void runTest() override
+    {
+        testLongRooms();
+        testHandover();
+    }
+
+private:
+    static constexpr double sampleRate = 48000.0;
+    static constexpr int blockSize = 512;
+    static constexpr double maxErrorDb = -60.0;
+
+    static ShimmerReverb::Params makeParams (float roomSize)
+    {
+        ShimmerReverb::Params p;
+        p.roomSize = roomSize;
+        p.shimmerAmount = 0.0f; // a shimmer would make the reverb time-varying
+        return p;
+    }
+
+    void testLongRooms()
+    {
+        beginTest ("Responses longer than maxImpulseSeconds aren't captured");
+
+        std::array<juce::AudioBuffer<float>, 2> responses;
+        int length = 1;
+
+        expect (! ReverbCapture::renderResponses (makeParams (1.0f), true, sampleRate, DelayBuffer::Format::float32, 2, responses, length),
+                "a full-size room was captured");
+
+        auto frozen = makeParams (0.5f);
+        frozen.freeze = true;
+        expect (! ReverbCapture::renderResponses (frozen, true, sampleRate, DelayBuffer::Format::float32, 2, responses, length),
+                "a frozen reverb was captured");
+
+        expect (ReverbCapture::renderResponses (makeParams (0.5f), true, sampleRate, DelayBuffer::Format::float32, 2, responses, length),
+                "a mid-size room wasn't captured");
+        expect (length > 1 && length <= (int) (ReverbCapture::maxImpulseSeconds * sampleRate));
+
+        int stopped = 1;
+        expect (! ReverbCapture::renderResponses (makeParams (0.5f), true, sampleRate, DelayBuffer::Format::float32, 2, responses, stopped,
+                                                  [] { return true; }));
+        expectEquals (stopped, 1);
+    }
+
+    // One stereo and one mono group through the capture, each beside a reverb of its own
+    // that never hands over, all fed the same noise.
+    struct Rig
+    {
+        explicit Rig (const ShimmerReverb::Params& p) : params (p)
+        {
+            capture.prepare (sampleRate, blockSize, { 2, 1 }, DelayBuffer::Format::float32, true);
+
+            for (auto* r : { &stereo, &mono, &stereoReference, &monoReference })
+            {
+                const int numChannels = (r == &stereo || r == &stereoReference) ? 2 : 1;
+                r->prepare ({ sampleRate, (juce::uint32) blockSize, (juce::uint32) numChannels });
+                r->setQuality (quality);
+                r->setParams (params);
+            }
+        }
+
+        void processBlock (bool isStatic)
+        {
+            capture.update (params, quality, isStatic, blockSize);
+
+            for (int ch = 0; ch < 2; ++ch)
+                for (int i = 0; i < blockSize; ++i)
+                    stereoWet.setSample (ch, i, 0.4f * (rng.nextFloat() * 2.0f - 1.0f));
+
+            for (int i = 0; i < blockSize; ++i)
+                monoWet.setSample (0, i, 0.4f * (rng.nextFloat() * 2.0f - 1.0f));
+
+            stereoExpected.makeCopyOf (stereoWet, true);
+            monoExpected.makeCopyOf (monoWet, true);
+
+            capture.process (0, stereo, stereoWet);
+            capture.process (1, mono, monoWet);
+            stereoReference.process (stereoExpected);
+            monoReference.process (monoExpected);
+
+            accumulate (stereoWet, stereoExpected);
+            accumulate (monoWet, monoExpected);
+        }
+
+        void accumulate (const juce::AudioBuffer<float>& actual, const juce::AudioBuffer<float>& expected)
+        {
+            for (int ch = 0; ch < actual.getNumChannels(); ++ch)
+            {
+                for (int i = 0; i < blockSize; ++i)
+                {
+                    const double e = expected.getSample (ch, i);
+                    const double d = actual.getSample (ch, i) - e;
+                    errorEnergy += d * d;
+                    referenceEnergy += e * e;
+                }
+            }
+        }
+
+        // the error since the last call, relative to the reference
+        double takeErrorDb()
+        {
+            const double db = 10.0 * std::log10 (errorEnergy / juce::jmax (referenceEnergy, 1.0e-30) + 1.0e-30);
+            errorEnergy = referenceEnergy = 0.0;
+            return db;
+        }
+
+        ShimmerReverb::Params params;
+        ShimmerReverb::Quality quality;
+        ReverbCapture capture;
+        ShimmerReverb stereo, mono, stereoReference, monoReference;
+        juce::AudioBuffer<float> stereoWet { 2, blockSize }, monoWet { 1, blockSize };
+        juce::AudioBuffer<float> stereoExpected { 2, blockSize }, monoExpected { 1, blockSize };
+        juce::Random rng { 7 };
+        double errorEnergy = 0.0, referenceEnergy = 0.0;
+    };
+
+    void testHandover()
+    {
+        const auto params = makeParams (0.5f);
+
+        // what the renderer will make of these settings, rendered the same way
+        int length = 1;
+        {
+            std::array<juce::AudioBuffer<float>, 2> responses;
+            ReverbCapture::renderResponses (params, true, sampleRate, DelayBuffer::Format::float32, 1, responses, length);
+            ReverbCapture::renderResponses (params, true, sampleRate, DelayBuffer::Format::float32, 2, responses, length);
+        }
+
+        const int tailBlocks = (length + blockSize - 1) / blockSize;
+        const int oneSecond = (int) (sampleRate / blockSize);
+
+        Rig rig (params);
+
+        beginTest ("Reverb to convolution");
+        {
+            // the capture is rendered in the background once the settings have held still
+            const auto deadline = juce::Time::getMillisecondCounter() + 60000;
+            int blocks = 0;
+
+            while (! rig.capture.isConvolving() && juce::Time::getMillisecondCounter() < deadline)
+            {
+                rig.takeErrorDb(); // measured from the block that hands over
+                rig.processBlock (true);
+
+                if (++blocks * blockSize > (int) (ReverbCapture::settleSeconds * sampleRate))
+                    juce::Thread::sleep (2);
+            }
+
+            expect (rig.capture.isConvolving(), "no capture within a minute");
+
+            // the reverb plays out what it was given, fed silence, for the response's length
+            expectEquals (rig.capture.getTailSamples(), length - blockSize);
+
+            int played = 1;
+            while (rig.capture.getTailSamples() > 0 && played < 2 * tailBlocks)
+            {
+                rig.processBlock (true);
+                ++played;
+            }
+
+            expectEquals (played, tailBlocks);
+            expect (rig.capture.isConvolving());
+
+            for (int b = 0; b < oneSecond; ++b)
+                rig.processBlock (true);
+
+            const auto errorDb = rig.takeErrorDb();
+            expect (errorDb < maxErrorDb, "error " + juce::String (errorDb, 1) + " dB");
+        }
+
+        beginTest ("Convolution to reverb");
+        {
+            // a time-varying reverb hands back at once, with the settings unchanged
+            rig.processBlock (false);
+            expect (! rig.capture.isConvolving());
+            expectEquals (rig.capture.getTailSamples(), length - blockSize);
+
+            int played = 1;
+            while (rig.capture.getTailSamples() > 0 && played < 2 * tailBlocks)
+            {
+                rig.processBlock (false);
+                ++played;
+            }
+
+            expectEquals (played, tailBlocks);
+
+            for (int b = 0; b < oneSecond; ++b)
+                rig.processBlock (false);
+
+            expectEquals (rig.capture.getTailSamples(), 0);
+
+            const auto errorDb = rig.takeErrorDb();
+            expect (errorDb < maxErrorDb, "error " + juce::String (errorDb, 1) + " dB");
+        }
+    }
+};
+
+static ReverbCaptureTests reverbCaptureTests;
@@ -0,0 +1,339 @@
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <juce_events/juce_events.h>
+
+#include "../../Source/PluginProcessor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+
+// Headless throughput benchmark for the DSP stages, the plugin-free engine and the
+// full processor.
+// Prints one JSON object per case (or CSV with --csv) so results can be diffed
+// between builds.
+
+namespace
+{
+    struct Corner
+    {
+        const char* name;
+        std::vector<std::pair<const char*, float>> processorParams;
+        std::function<void (GranularDelay::Params&)> granular;
+        std::function<void (ShimmerReverb::Params&)> shimmer;
+    };
+
+    std::vector<Corner> makeCorners()
+    {
+        return {
+            { "default", {}, [] (GranularDelay::Params&) {}, [] (ShimmerReverb::Params&) {} },
+            { "maxDensityAir",
+              { { "density", 40.0f }, { "air", 1.0f }, { "grainSizeMs", 250.0f } },
+              [] (GranularDelay::Params& g) { g.density = 40.0f * 1.8f; g.grainSizeMs = 250.0f; },
+              [] (ShimmerReverb::Params& r) { r.tone = 0.8f; r.shimmerAmount = 0.6f; } },
+            { "freeze",
+              { { "freeze", 1.0f } },
+              [] (GranularDelay::Params& g) { g.freeze = true; },
+              [] (ShimmerReverb::Params& r) { r.freeze = true; } },
+            { "shimmer24",
+              { { "shimmerPitch", 3.0f }, { "shimmerAmt", 1.0f } },
+              [] (GranularDelay::Params&) {},
+              [] (ShimmerReverb::Params& r) { r.pitchSemitones = 24.0f; r.shimmerAmount = 1.0f; } },
+            { "cloud",
+              { { "cloudDensity", 4000.0f } },
+              [] (GranularDelay::Params& g) { g.cloudDensity = 4000.0f; },
+              [] (ShimmerReverb::Params&) {} },
+            // cloud at the CPU governor's highest level (engine and processor only)
+            { "cloudGuard4",
+              { { "cloudDensity", 4000.0f }, { "cpuGuard", 5.0f } },
+              [] (GranularDelay::Params& g) { g.cloudDensity = 4000.0f; },
+              [] (ShimmerReverb::Params&) {} },
+        };
+    }
+
+    struct Options
+    {
+        double secondsPerRun = 2.0;
+        int repetitions = 5;
+        bool csv = false;
+        juce::String engineFilter;
+        std::vector<double> sampleRates { 44100.0, 48000.0, 96000.0, 192000.0 };
+        std::vector<int> blockSizes { 16, 64, 256, 1024, 4096 };
+    };
+
+    struct Result
+    {
+        double meanNsPerSample = 0.0;
+        double stdDevNsPerSample = 0.0;
+        double minNsPerSample = 0.0;
+        double maxNsPerSample = 0.0;
+        double realtimeFactor = 0.0;
+    };
+
+    void fillInput (juce::AudioBuffer<float>& buffer, juce::Random& rng, double sampleRate, juce::int64& sampleIndex)
+    {
+        const int numSamples = buffer.getNumSamples();
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const double t = (double) (sampleIndex + i) / sampleRate;
+            const float tone = 0.25f * (float) std::sin (juce::MathConstants<double>::twoPi * 220.0 * t);
+
+            for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+                buffer.setSample (ch, i, tone + 0.1f * (rng.nextFloat() * 2.0f - 1.0f));
+        }
+
+        sampleIndex += numSamples;
+    }
+
+    // Runs `process` over secondsPerRun of audio, repetitions times, after a short warm-up.
+    Result measure (const Options& opts, double sampleRate, int blockSize,
+                    const std::function<void (juce::AudioBuffer<float>&)>& process)
+    {
+        juce::AudioBuffer<float> buffer (2, blockSize);
+        juce::Random rng (1234);
+        juce::int64 sampleIndex = 0;
+
+        const int warmupBlocks = juce::jmax (1, (int) (0.25 * sampleRate) / blockSize);
+        for (int b = 0; b < warmupBlocks; ++b)
+        {
+            fillInput (buffer, rng, sampleRate, sampleIndex);
+            process (buffer);
+        }
+
+        const int blocksPerRun = juce::jmax (1, (int) (opts.secondsPerRun * sampleRate) / blockSize);
+        const double samplesPerRun = (double) blocksPerRun * blockSize;
+
+        juce::Array<double> nsPerSample;
+        double totalSeconds = 0.0;
+
+        for (int rep = 0; rep < opts.repetitions; ++rep)
+        {
+            juce::int64 ticks = 0;
+
+            for (int b = 0; b < blocksPerRun; ++b)
+            {
+                fillInput (buffer, rng, sampleRate, sampleIndex);
+
+                const auto start = juce::Time::getHighResolutionTicks();
+                process (buffer);
+                ticks += juce::Time::getHighResolutionTicks() - start;
+            }
+
+            const double seconds = juce::Time::highResolutionTicksToSeconds (ticks);
+            totalSeconds += seconds;
+            nsPerSample.add (seconds * 1.0e9 / samplesPerRun);
+        }
+
+        Result r;
+        for (auto v : nsPerSample)
+            r.meanNsPerSample += v;
+        r.meanNsPerSample /= nsPerSample.size();
+
+        for (auto v : nsPerSample)
+            r.stdDevNsPerSample += (v - r.meanNsPerSample) * (v - r.meanNsPerSample);
+        r.stdDevNsPerSample = std::sqrt (r.stdDevNsPerSample / nsPerSample.size());
+
+        const auto [minIt, maxIt] = std::minmax_element (nsPerSample.begin(), nsPerSample.end());
+        r.minNsPerSample = *minIt;
+        r.maxNsPerSample = *maxIt;
+
+        // processing time over audio time: < 1 means faster than real time
+        r.realtimeFactor = totalSeconds / (samplesPerRun * opts.repetitions / sampleRate);
+        return r;
+    }
+
+    void report (const Options& opts, const char* engine, const char* corner, double sampleRate, int blockSize, const Result& r)
+    {
+        if (opts.csv)
+        {
+            std::cout << engine << ',' << corner << ',' << sampleRate << ',' << blockSize << ','
+                      << r.meanNsPerSample << ',' << r.stdDevNsPerSample << ',' << r.minNsPerSample << ','
+                      << r.maxNsPerSample << ',' << r.realtimeFactor << std::endl;
+            return;
+        }
+
+        auto* obj = new juce::DynamicObject();
+        obj->setProperty ("engine", engine);
+        obj->setProperty ("corner", corner);
+        obj->setProperty ("sampleRate", sampleRate);
+        obj->setProperty ("blockSize", blockSize);
+        obj->setProperty ("nsPerSample", r.meanNsPerSample);
+        obj->setProperty ("nsPerSampleStdDev", r.stdDevNsPerSample);
+        obj->setProperty ("nsPerSampleVariance", r.stdDevNsPerSample * r.stdDevNsPerSample);
+        obj->setProperty ("nsPerSampleMin", r.minNsPerSample);
+        obj->setProperty ("nsPerSampleMax", r.maxNsPerSample);
+        obj->setProperty ("realtimeFactor", r.realtimeFactor);
+
+        std::cout << juce::JSON::toString (juce::var (obj), true) << std::endl;
+    }
+
+    bool wants (const Options& opts, const char* engine)
+    {
+        return opts.engineFilter.isEmpty() || opts.engineFilter == engine;
+    }
+
+    void runCase (const Options& opts, const Corner& corner, double sampleRate, int blockSize)
+    {
+        juce::dsp::ProcessSpec spec { sampleRate, (juce::uint32) blockSize, 2 };
+
+        if (wants (opts, "granular"))
+        {
+            GranularDelay granular;
+            granular.prepare (spec);
+
+            GranularDelay::Params p;
+            corner.granular (p);
+            granular.setParams (p);
+
+            juce::AudioBuffer<float> wet (2, blockSize);
+            const auto r = measure (opts, sampleRate, blockSize, [&] (juce::AudioBuffer<float>& b)
+            {
+                wet.clear();
+                granular.process (b, wet);
+            });
+            report (opts, "granular", corner.name, sampleRate, blockSize, r);
+        }
+
+        if (wants (opts, "shimmer"))
+        {
+            ShimmerReverb shimmer;
+            shimmer.prepare (spec);
+
+            ShimmerReverb::Params p;
+            corner.shimmer (p);
+            shimmer.setParams (p);
+
+            const auto r = measure (opts, sampleRate, blockSize, [&] (juce::AudioBuffer<float>& b) { shimmer.process (b); });
+            report (opts, "shimmer", corner.name, sampleRate, blockSize, r);
+        }
+
+        if (wants (opts, "engine"))
+        {
+            StarlightEngine engine;
+            engine.prepare (sampleRate, blockSize, 2);
+
+            ParameterSnapshot params;
+            for (const auto& [id, value] : corner.processorParams)
+                params.set (ParameterSnapshot::indexOf (id), value);
+            engine.setParameters (params);
+
+            const auto r = measure (opts, sampleRate, blockSize, [&] (juce::AudioBuffer<float>& b)
+            {
+                engine.setParameters (params);
+                engine.process (b.getArrayOfWritePointers(), b.getNumSamples());
+            });
+            report (opts, "engine", corner.name, sampleRate, blockSize, r);
+        }
+
+        if (wants (opts, "engineMono"))
+        {
+            StarlightEngine engine;
+            engine.prepare (sampleRate, blockSize, 1);
+
+            ParameterSnapshot params;
+            for (const auto& [id, value] : corner.processorParams)
+                params.set (ParameterSnapshot::indexOf (id), value);
+            engine.setParameters (params);
+
+            // only the first channel is processed
+            const auto r = measure (opts, sampleRate, blockSize, [&] (juce::AudioBuffer<float>& b)
+            {
+                engine.setParameters (params);
+                engine.process (b.getArrayOfWritePointers(), b.getNumSamples());
+            });
+            report (opts, "engineMono", corner.name, sampleRate, blockSize, r);
+        }
+
+        if (wants (opts, "processor"))
+        {
+            StarlightDriftAudioProcessor proc;
+            proc.setPlayConfigDetails (2, 2, sampleRate, blockSize);
+
+            // measure the configured quality, not whatever the governor settles on
+            if (auto* guard = proc.getAPVTS().getParameter (ParamIDs::cpuGuard))
+                guard->setValueNotifyingHost (guard->convertTo0to1 (0.0f));
+
+            for (const auto& [id, value] : corner.processorParams)
+                if (auto* param = proc.getAPVTS().getParameter (id))
+                    param->setValueNotifyingHost (param->convertTo0to1 (value));
+
+            proc.prepareToPlay (sampleRate, blockSize);
+
+            juce::MidiBuffer midi;
+            const auto r = measure (opts, sampleRate, blockSize, [&] (juce::AudioBuffer<float>& b) { proc.processBlock (b, midi); });
+            report (opts, "processor", corner.name, sampleRate, blockSize, r);
+
+            proc.releaseResources();
+        }
+    }
+
+    template <typename T>
+    std::vector<T> parseList (const juce::String& s)
+    {
+        std::vector<T> values;
+        for (const auto& token : juce::StringArray::fromTokens (s, ",", {}))
+            values.push_back ((T) token.getDoubleValue());
+        return values;
+    }
+
+    void printUsage()
+    {
+        std::cout << "StarlightDriftBench [--seconds=N] [--reps=N] [--engine=granular|shimmer|engine|engineMono|processor]\n"
+                     "                    [--rates=44100,48000,...] [--blocks=16,64,...] [--corner=NAME] [--csv] [--rt-check]\n";
+    }
+}
+
+int main (int argc, char* argv[])
+{
+    // APVTS needs a message manager; no display or audio device is touched.
+    juce::ScopedJuceInitialiser_GUI juceInit;
+
+    Options opts;
+    juce::String cornerFilter;
+
+    const juce::ArgumentList args (argc, argv);
+    if (args.containsOption ("--help|-h"))
+    {
+        printUsage();
+        return 0;
+    }
+
+    if (args.containsOption ("--seconds"))
+        opts.secondsPerRun = juce::jmax (0.01, args.getValueForOption ("--seconds").getDoubleValue());
+    if (args.containsOption ("--reps"))
+        opts.repetitions = juce::jmax (1, args.getValueForOption ("--reps").getIntValue());
+    if (args.containsOption ("--engine"))
+        opts.engineFilter = args.getValueForOption ("--engine");
+    if (args.containsOption ("--rates"))
+        opts.sampleRates = parseList<double> (args.getValueForOption ("--rates"));
+    if (args.containsOption ("--blocks"))
+        opts.blockSizes = parseList<int> (args.getValueForOption ("--blocks"));
+    if (args.containsOption ("--corner"))
+        cornerFilter = args.getValueForOption ("--corner");
+    opts.csv = args.containsOption ("--csv");
+
+    // the audit captures a stack per violation, which would skew the timings
+    const bool realtimeCheck = args.containsOption ("--rt-check");
+    RealtimeSafety::setEnabled (realtimeCheck);
+
+    if (opts.csv)
+        std::cout << "engine,corner,sampleRate,blockSize,nsPerSample,nsPerSampleStdDev,nsPerSampleMin,nsPerSampleMax,realtimeFactor" << std::endl;
+
+    for (const auto& corner : makeCorners())
+    {
+        if (cornerFilter.isNotEmpty() && cornerFilter != corner.name)
+            continue;
+
+        for (auto sampleRate : opts.sampleRates)
+            for (auto blockSize : opts.blockSizes)
+                runCase (opts, corner, sampleRate, blockSize);
+    }
+
+    if (realtimeCheck && RealtimeSafety::getViolationCount() > 0)
+    {
+        std::cerr << RealtimeSafety::formatViolations() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
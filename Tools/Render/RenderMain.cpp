@@ -0,0 +1,316 @@
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <juce_events/juce_events.h>
+
+#include "../../Source/PluginProcessor.h"
+
+#include <atomic>
+#include <iostream>
+
+// Offline batch renderer. Streams WAV/AIFF files through the processor with a
+// preset saved by getStateInformation(), appends the computed reverb/grain tail,
+// and spreads the files over a pool of worker threads, each owning one processor.
+// Every file is rendered from a freshly prepared processor seeded from --seed and
+// the file name, so the output doesn't depend on the number of workers or on
+// which worker picked the file up.
+
+namespace
+{
+    struct Options
+    {
+        juce::MemoryBlock state;
+        juce::File outputDir;
+        juce::String format = "wav";
+        int bitDepth = 24;
+        int blockSize = 1024;
+        int numWorkers = 1;
+        juce::int64 seed = 0;
+        double tailSeconds = -1.0; // < 0: use the processor's estimate
+        bool turbo = false;
+    };
+
+    struct Result
+    {
+        bool ok = false;
+        juce::String message;
+        juce::int64 samplesWritten = 0;
+        double seconds = 0.0;
+    };
+
+    std::unique_ptr<juce::AudioFormatReader> openReader (juce::AudioFormatManager& formats, const juce::File& file)
+    {
+        // Map the whole file when the format supports it, so reads are plain memory copies;
+        // otherwise fall back to a buffered stream.
+        if (auto* format = formats.findFormatForFileExtension (file.getFileExtension()))
+        {
+            std::unique_ptr<juce::MemoryMappedAudioFormatReader> mapped (format->createMemoryMappedReader (file));
+            if (mapped != nullptr && mapped->mapEntireFile())
+                return mapped;
+        }
+
+        return std::unique_ptr<juce::AudioFormatReader> (formats.createReaderFor (file));
+    }
+
+    std::unique_ptr<juce::AudioFormatWriter> openWriter (const Options& opts, const juce::File& file,
+                                                         double sampleRate, int numChannels)
+    {
+        file.deleteFile();
+
+        auto stream = std::make_unique<juce::FileOutputStream> (file, 1 << 18);
+        if (! stream->openedOk())
+            return {};
+
+        std::unique_ptr<juce::AudioFormat> format;
+        if (opts.format == "aiff")
+            format = std::make_unique<juce::AiffAudioFormat>();
+        else
+            format = std::make_unique<juce::WavAudioFormat>();
+
+        std::unique_ptr<juce::AudioFormatWriter> writer (format->createWriterFor (stream.get(), sampleRate, (unsigned int) numChannels,
+                                                                                  opts.bitDepth, {}, 0));
+        if (writer != nullptr)
+            stream.release(); // owned by the writer now
+
+        return writer;
+    }
+
+    Result renderFile (StarlightDriftAudioProcessor& proc, juce::AudioFormatManager& formats,
+                       const Options& opts, const juce::File& input)
+    {
+        Result result;
+        const auto start = juce::Time::getMillisecondCounterHiRes();
+
+        auto reader = openReader (formats, input);
+        if (reader == nullptr)
+        {
+            result.message = "can't read " + input.getFullPathName();
+            return result;
+        }
+
+        const int numChannels = (int) reader->numChannels;
+        if (numChannels < 1 || numChannels > 2)
+        {
+            result.message = "only mono and stereo files are supported (" + juce::String (numChannels) + " channels)";
+            return result;
+        }
+
+        const double sampleRate = reader->sampleRate;
+        const auto output = opts.outputDir.getChildFile (input.getFileNameWithoutExtension() + (opts.format == "aiff" ? ".aiff" : ".wav"));
+        if (output == input)
+        {
+            result.message = "output would overwrite the input";
+            return result;
+        }
+
+        // Same preset, seed and fresh state for every file; offline before the state, so a
+        // saved freeze is decoded there and then.
+        proc.setNonRealtime (true);
+        proc.setStateInformation (opts.state.getData(), (int) opts.state.getSize());
+        proc.setRandomSeed (opts.seed ^ input.getFileName().hashCode64());
+        proc.setOfflineTurbo (opts.turbo);
+        proc.setPlayConfigDetails (numChannels, numChannels, sampleRate, opts.blockSize);
+        proc.prepareToPlay (sampleRate, opts.blockSize);
+
+        const double tailSeconds = opts.tailSeconds >= 0.0 ? opts.tailSeconds : proc.getTailLengthSeconds();
+        const auto inputLength = reader->lengthInSamples;
+        const auto totalLength = inputLength + (juce::int64) std::ceil (tailSeconds * sampleRate);
+
+        // run the pipeline latency through as well and drop it from the start of the file
+        const int latency = proc.getLatencySamples();
+        int toSkip = latency;
+
+        auto writer = openWriter (opts, output, sampleRate, numChannels);
+        if (writer == nullptr)
+        {
+            result.message = "can't write " + output.getFullPathName();
+            return result;
+        }
+
+        juce::AudioBuffer<float> buffer (numChannels, opts.blockSize);
+        juce::MidiBuffer midi;
+
+        for (juce::int64 pos = 0; pos < totalLength + latency;)
+        {
+            const int n = (int) juce::jmin ((juce::int64) opts.blockSize, totalLength + latency - pos);
+
+            // past the end of the file this reads silence, which is the tail flush
+            reader->read (&buffer, 0, n, pos, true, numChannels > 1);
+
+            juce::AudioBuffer<float> view (buffer.getArrayOfWritePointers(), numChannels, 0, n);
+            proc.processBlock (view, midi);
+
+            const int skip = juce::jmin (toSkip, n);
+            toSkip -= skip;
+
+            if (! writer->writeFromAudioSampleBuffer (view, skip, n - skip))
+            {
+                result.message = "write failed for " + output.getFullPathName();
+                return result;
+            }
+
+            pos += n;
+        }
+
+        proc.releaseResources();
+
+        result.ok = true;
+        result.samplesWritten = totalLength;
+        result.seconds = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+        result.message = output.getFullPathName();
+        return result;
+    }
+
+    class RenderWorker final : public juce::Thread
+    {
+    public:
+        RenderWorker (const Options& o, const juce::Array<juce::File>& in, std::vector<Result>& out,
+                      std::atomic<int>& next, juce::CriticalSection& log)
+            : juce::Thread ("Starlight render worker"), opts (o), inputs (in), results (out), nextInput (next), logLock (log)
+        {
+            formats.registerBasicFormats();
+        }
+
+        void run() override
+        {
+            for (int i = nextInput++; i < inputs.size() && ! threadShouldExit(); i = nextInput++)
+            {
+                auto& r = results[(size_t) i] = renderFile (proc, formats, opts, inputs[i]);
+
+                const juce::ScopedLock sl (logLock);
+                std::cout << (r.ok ? "rendered " : "FAILED   ") << inputs[i].getFileName()
+                          << (r.ok ? " -> " : ": ") << r.message;
+                if (r.ok)
+                    std::cout << " (" << juce::String (r.seconds, 2) << " s)";
+                std::cout << std::endl;
+            }
+        }
+
+    private:
+        const Options& opts;
+        const juce::Array<juce::File>& inputs;
+        std::vector<Result>& results;
+        std::atomic<int>& nextInput;
+        juce::CriticalSection& logLock;
+
+        juce::AudioFormatManager formats;
+        StarlightDriftAudioProcessor proc;
+    };
+
+    juce::Array<juce::File> collectInputs (const juce::ArgumentList& args)
+    {
+        juce::Array<juce::File> files;
+
+        for (const auto& arg : args.arguments)
+        {
+            if (arg.isOption())
+                continue;
+
+            const auto f = arg.resolveAsFile();
+            if (f.isDirectory())
+            {
+                auto found = f.findChildFiles (juce::File::findFiles, false, "*.wav;*.aif;*.aiff");
+                found.sort();
+                files.addArray (found);
+            }
+            else
+            {
+                files.add (f);
+            }
+        }
+
+        return files;
+    }
+
+    void printUsage()
+    {
+        std::cout << "StarlightDriftRender --state=preset.bin --out=DIR [--jobs=N] [--seed=N] [--block=N]\n"
+                     "                     [--format=wav|aiff] [--bits=16|24|32] [--tail=SECONDS] [--turbo] FILE|DIR...\n";
+    }
+}
+
+int main (int argc, char* argv[])
+{
+    // APVTS needs a message manager; no display or audio device is touched.
+    juce::ScopedJuceInitialiser_GUI juceInit;
+
+    // the headless tools compile in the real-time audit; it has nothing to say here
+    RealtimeSafety::setEnabled (false);
+
+    const juce::ArgumentList args (argc, argv);
+    if (args.containsOption ("--help|-h") || ! args.containsOption ("--state") || ! args.containsOption ("--out"))
+    {
+        printUsage();
+        return args.containsOption ("--help|-h") ? 0 : 1;
+    }
+
+    Options opts;
+
+    const auto stateFile = args.getFileForOption ("--state");
+    if (! stateFile.loadFileAsData (opts.state) || opts.state.isEmpty())
+    {
+        std::cerr << "can't read state from " << stateFile.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    opts.outputDir = args.getFileForOption ("--out");
+    if (! opts.outputDir.createDirectory())
+    {
+        std::cerr << "can't create " << opts.outputDir.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    opts.numWorkers = juce::SystemStats::getNumCpus();
+    if (args.containsOption ("--jobs"))
+        opts.numWorkers = juce::jmax (1, args.getValueForOption ("--jobs").getIntValue());
+    if (args.containsOption ("--seed"))
+        opts.seed = args.getValueForOption ("--seed").getLargeIntValue();
+    if (args.containsOption ("--block"))
+        opts.blockSize = juce::jlimit (16, 65536, args.getValueForOption ("--block").getIntValue());
+    if (args.containsOption ("--format"))
+        opts.format = args.getValueForOption ("--format").toLowerCase();
+    if (args.containsOption ("--bits"))
+        opts.bitDepth = args.getValueForOption ("--bits").getIntValue();
+    opts.turbo = args.containsOption ("--turbo");
+    if (args.containsOption ("--tail"))
+        opts.tailSeconds = juce::jmax (0.0, args.getValueForOption ("--tail").getDoubleValue());
+
+    if (opts.format != "wav" && opts.format != "aiff")
+    {
+        std::cerr << "unknown format " << opts.format << std::endl;
+        return 1;
+    }
+
+    const auto inputs = collectInputs (args);
+    if (inputs.isEmpty())
+    {
+        std::cerr << "no input files" << std::endl;
+        return 1;
+    }
+
+    std::vector<Result> results ((size_t) inputs.size());
+    std::atomic<int> nextInput { 0 };
+    juce::CriticalSection logLock;
+
+    const auto start = juce::Time::getMillisecondCounterHiRes();
+
+    std::vector<std::unique_ptr<RenderWorker>> workers;
+    for (int i = 0; i < juce::jmin (opts.numWorkers, inputs.size()); ++i)
+        workers.push_back (std::make_unique<RenderWorker> (opts, inputs, results, nextInput, logLock));
+
+    for (auto& w : workers)
+        w->startThread();
+
+    for (auto& w : workers)
+        w->waitForThreadToExit (-1);
+
+    const double seconds = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+
+    int failures = 0;
+    for (const auto& r : results)
+        failures += r.ok ? 0 : 1;
+
+    std::cout << inputs.size() - failures << " of " << inputs.size() << " files rendered in " << juce::String (seconds, 2)
+              << " s on " << (int) workers.size() << " worker(s)" << std::endl;
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,366 @@
+#include <juce_audio_processors/juce_audio_processors.h>
+#include <juce_events/juce_events.h>
+
+#include "../../Source/PluginProcessor.h"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <iterator>
+
+// Worst-case execution time / jitter stress harness. Randomly automates every
+// parameter between blocks, and a few at audio rate within them as parameter
+// events (so the blocks get split), flips freeze and the locks, varies the block
+// size from 1 to 8192 and re-prepares with new maximum block sizes, recording
+// per-block timings. Heap allocations and lock acquisitions inside
+// processBlock are caught by RealtimeSafety.
+
+namespace
+{
+    struct Options
+    {
+        int numBlocks = 20000;
+        double sampleRate = 48000.0;
+        juce::int64 seed = 1;
+        bool json = false;
+    };
+
+    struct BlockRecord
+    {
+        double micros = 0.0;
+        double load = 0.0; // block time / block deadline
+        int blockSize = 0;
+        int maxBlockSize = 0;
+        juce::int64 violations = 0;
+        juce::StringPairArray params;
+    };
+
+    // Buckets for block time as a percentage of the block's real-time deadline.
+    const double loadBucketEdges[] = { 1.0, 2.0, 5.0, 10.0, 25.0, 50.0, 100.0, 200.0 };
+    constexpr int numLoadBuckets = (int) std::size (loadBucketEdges) + 1;
+
+    // Block-size classes for the per-class WCET table.
+    const int sizeClassEdges[] = { 1, 15, 127, 1023, 8192 };
+    constexpr int numSizeClasses = (int) std::size (sizeClassEdges);
+
+    int getSizeClass (int blockSize)
+    {
+        for (int i = 0; i < numSizeClasses; ++i)
+            if (blockSize <= sizeClassEdges[i])
+                return i;
+        return numSizeClasses - 1;
+    }
+
+    juce::String getSizeClassName (int index)
+    {
+        const int lo = index == 0 ? 1 : sizeClassEdges[index - 1] + 1;
+        return juce::String (lo) + "-" + juce::String (sizeClassEdges[index]);
+    }
+
+    int pickBlockSize (juce::Random& rng, int maxBlockSize)
+    {
+        switch (rng.nextInt (4))
+        {
+            case 0:  return 1 + rng.nextInt (juce::jmin (16, maxBlockSize));         // tiny, incl. 1
+            case 1:  return juce::jmin (maxBlockSize, 1 << rng.nextInt (14));         // power of two
+            case 2:  return juce::jmin (maxBlockSize, (rng.nextInt (4096) * 2) + 1);  // odd
+            default: return 1 + rng.nextInt (maxBlockSize);
+        }
+    }
+
+    void setParameter (juce::AudioProcessorParameter& p, float normalised)
+    {
+        // what a host does when it delivers automation on the audio thread
+        p.setValue (normalised);
+        p.sendValueChangedMessageToListeners (normalised);
+    }
+
+    void automate (StarlightDriftAudioProcessor& proc, juce::Random& rng)
+    {
+        for (auto* p : proc.getParameters())
+        {
+            const bool discrete = p->isDiscrete() || p->isBoolean();
+
+            if (discrete)
+            {
+                if (rng.nextInt (50) == 0)
+                    setParameter (*p, rng.nextBool() ? 1.0f : rng.nextFloat());
+            }
+            else if (rng.nextInt (8) == 0)
+            {
+                setParameter (*p, rng.nextFloat()); // jump
+            }
+            else
+            {
+                const float walk = p->getValue() + 0.05f * (rng.nextFloat() * 2.0f - 1.0f);
+                setParameter (*p, juce::jlimit (0.0f, 1.0f, walk));
+            }
+        }
+
+        if (auto* freeze = proc.getAPVTS().getParameter ("freeze"); freeze != nullptr && rng.nextInt (100) == 0)
+            setParameter (*freeze, freeze->getValue() > 0.5f ? 0.0f : 1.0f);
+
+        if (rng.nextInt (20) == 0)
+        {
+            const auto& params = proc.getParameters();
+            if (auto* withId = dynamic_cast<juce::AudioProcessorParameterWithID*> (params[rng.nextInt (params.size())]))
+                proc.setParamLocked (withId->getParameterID(), rng.nextBool());
+        }
+    }
+
+    // Audio-rate automation for up to four continuous parameters: a random walk of events
+    // at random points in the block, which the processor splits the block at. Each
+    // parameter is left at its last event's value, as a host leaves it.
+    void addBlockEvents (StarlightDriftAudioProcessor& proc, juce::Random& rng, int blockSize)
+    {
+        if (rng.nextInt (4) == 0)
+            return;
+
+        const int numParams = 1 + rng.nextInt (4);
+
+        for (int n = 0; n < numParams; ++n)
+        {
+            const int index = rng.nextInt ((int) ParamIndex::count);
+            const auto& spec = paramSpecs[index];
+            auto* param = proc.getAPVTS().getParameter (spec.id);
+
+            if (spec.kind != ParamSpec::Kind::continuous || param == nullptr)
+                continue;
+
+            std::array<int, 32> offsets;
+            const int numEvents = 1 + rng.nextInt ((int) offsets.size());
+            for (int e = 0; e < numEvents; ++e)
+                offsets[(size_t) e] = rng.nextInt (blockSize);
+            std::sort (offsets.begin(), offsets.begin() + numEvents);
+
+            float value = param->convertFrom0to1 (param->getValue());
+            for (int e = 0; e < numEvents; ++e)
+            {
+                value = juce::jlimit (spec.minValue, spec.maxValue, value + 0.1f * (spec.maxValue - spec.minValue) * (rng.nextFloat() * 2.0f - 1.0f));
+                proc.addParameterEvent (offsets[(size_t) e], index, value);
+            }
+
+            setParameter (*param, param->convertTo0to1 (value));
+        }
+    }
+
+    juce::StringPairArray snapshotParams (StarlightDriftAudioProcessor& proc)
+    {
+        juce::StringPairArray snapshot;
+
+        for (auto* p : proc.getParameters())
+        {
+            if (auto* withId = dynamic_cast<juce::AudioProcessorParameterWithID*> (p))
+            {
+                const auto id = withId->getParameterID();
+                auto text = p->getCurrentValueAsText();
+                if (proc.isParamLocked (id))
+                    text << " (locked)";
+                snapshot.set (id, text);
+            }
+        }
+
+        return snapshot;
+    }
+
+    juce::var recordToVar (const BlockRecord& r)
+    {
+        auto* obj = new juce::DynamicObject();
+        obj->setProperty ("micros", r.micros);
+        obj->setProperty ("load", r.load);
+        obj->setProperty ("blockSize", r.blockSize);
+        obj->setProperty ("maxBlockSize", r.maxBlockSize);
+        obj->setProperty ("realtimeViolations", r.violations);
+
+        auto* params = new juce::DynamicObject();
+        for (const auto& key : r.params.getAllKeys())
+            params->setProperty (key, r.params[key]);
+        obj->setProperty ("params", juce::var (params));
+
+        return juce::var (obj);
+    }
+
+    void printRecord (const char* title, const BlockRecord& r)
+    {
+        std::cout << "\n=== " << title << " ===\n"
+                  << "  time " << r.micros << " us, load " << (r.load * 100.0) << "% of deadline, block "
+                  << r.blockSize << " (prepared max " << r.maxBlockSize << ")\n";
+
+        for (const auto& key : r.params.getAllKeys())
+            std::cout << "  " << key << " = " << r.params[key] << "\n";
+    }
+}
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInit;
+
+    Options opts;
+    const juce::ArgumentList args (argc, argv);
+
+    if (args.containsOption ("--help|-h"))
+    {
+        std::cout << "StarlightDriftStress [--blocks=N] [--rate=HZ] [--seed=N] [--json]\n";
+        return 0;
+    }
+
+    if (args.containsOption ("--blocks"))
+        opts.numBlocks = juce::jmax (1, args.getValueForOption ("--blocks").getIntValue());
+    if (args.containsOption ("--rate"))
+        opts.sampleRate = juce::jmax (8000.0, args.getValueForOption ("--rate").getDoubleValue());
+    if (args.containsOption ("--seed"))
+        opts.seed = args.getValueForOption ("--seed").getLargeIntValue();
+    opts.json = args.containsOption ("--json");
+
+    juce::Random rng (opts.seed);
+    StarlightDriftAudioProcessor proc;
+    juce::MidiBuffer midi;
+
+    const int preparedSizes[] = { 8192, 64, 1023, 256, 4096, 8192 };
+    int preparedIndex = 0;
+    int maxBlockSize = 0;
+
+    juce::AudioBuffer<float> buffer (2, 8192);
+
+    juce::int64 loadHistogram[numLoadBuckets] = {};
+    double sizeClassWcet[numSizeClasses] = {};
+    double sizeClassTotal[numSizeClasses] = {};
+    int sizeClassCount[numSizeClasses] = {};
+
+    BlockRecord worstTime, worstLoad;
+    juce::int64 blocksWithViolations = 0;
+    BlockRecord firstViolation;
+
+    for (int block = 0; block < opts.numBlocks; ++block)
+    {
+        // simulate the host changing its buffer size every so often
+        if (block % 2000 == 0)
+        {
+            proc.releaseResources();
+            maxBlockSize = preparedSizes[preparedIndex++ % (int) std::size (preparedSizes)];
+            proc.setPlayConfigDetails (2, 2, opts.sampleRate, maxBlockSize);
+            proc.prepareToPlay (opts.sampleRate, maxBlockSize);
+        }
+
+        automate (proc, rng);
+
+        const int blockSize = pickBlockSize (rng, maxBlockSize);
+        addBlockEvents (proc, rng, blockSize);
+        buffer.setSize (2, blockSize, false, false, true);
+        for (int ch = 0; ch < 2; ++ch)
+            for (int i = 0; i < blockSize; ++i)
+                buffer.setSample (ch, i, 0.5f * (rng.nextFloat() * 2.0f - 1.0f));
+
+        const auto violationsBefore = RealtimeSafety::getViolationCount();
+
+        const auto start = juce::Time::getHighResolutionTicks();
+        proc.processBlock (buffer, midi);
+        const auto ticks = juce::Time::getHighResolutionTicks() - start;
+
+        BlockRecord r;
+        r.micros = juce::Time::highResolutionTicksToSeconds (ticks) * 1.0e6;
+        r.load = (r.micros * 1.0e-6) / ((double) blockSize / opts.sampleRate);
+        r.blockSize = blockSize;
+        r.maxBlockSize = maxBlockSize;
+        r.violations = RealtimeSafety::getViolationCount() - violationsBefore;
+
+        if (r.violations > 0)
+        {
+            if (blocksWithViolations++ == 0)
+            {
+                firstViolation = r;
+                firstViolation.params = snapshotParams (proc);
+            }
+        }
+
+        int bucket = 0;
+        while (bucket < numLoadBuckets - 1 && r.load * 100.0 >= loadBucketEdges[bucket])
+            ++bucket;
+        ++loadHistogram[bucket];
+
+        const int sizeClass = getSizeClass (blockSize);
+        sizeClassWcet[sizeClass] = juce::jmax (sizeClassWcet[sizeClass], r.micros);
+        sizeClassTotal[sizeClass] += r.micros;
+        ++sizeClassCount[sizeClass];
+
+        if (r.micros > worstTime.micros)
+        {
+            worstTime = r;
+            worstTime.params = snapshotParams (proc);
+        }
+
+        if (r.load > worstLoad.load)
+        {
+            worstLoad = r;
+            worstLoad.params = snapshotParams (proc);
+        }
+    }
+
+    if (opts.json)
+    {
+        auto* root = new juce::DynamicObject();
+        root->setProperty ("blocks", opts.numBlocks);
+        root->setProperty ("sampleRate", opts.sampleRate);
+        root->setProperty ("seed", opts.seed);
+
+        juce::Array<juce::var> histogram;
+        for (int i = 0; i < numLoadBuckets; ++i)
+        {
+            auto* b = new juce::DynamicObject();
+            b->setProperty ("loadPercentBelow", i < numLoadBuckets - 1 ? juce::var (loadBucketEdges[i]) : juce::var ("inf"));
+            b->setProperty ("count", loadHistogram[i]);
+            histogram.add (juce::var (b));
+        }
+        root->setProperty ("loadHistogram", histogram);
+
+        juce::Array<juce::var> classes;
+        for (int i = 0; i < numSizeClasses; ++i)
+        {
+            auto* c = new juce::DynamicObject();
+            c->setProperty ("blockSizes", getSizeClassName (i));
+            c->setProperty ("count", sizeClassCount[i]);
+            c->setProperty ("wcetMicros", sizeClassWcet[i]);
+            c->setProperty ("meanMicros", sizeClassCount[i] > 0 ? sizeClassTotal[i] / sizeClassCount[i] : 0.0);
+            classes.add (juce::var (c));
+        }
+        root->setProperty ("wcetByBlockSize", classes);
+
+        root->setProperty ("realtimeViolations", RealtimeSafety::getViolationCount());
+        root->setProperty ("blocksWithViolations", blocksWithViolations);
+        root->setProperty ("worstBlockByTime", recordToVar (worstTime));
+        root->setProperty ("worstBlockByLoad", recordToVar (worstLoad));
+        if (blocksWithViolations > 0)
+            root->setProperty ("firstViolation", recordToVar (firstViolation));
+
+        std::cout << juce::JSON::toString (juce::var (root)) << std::endl;
+    }
+    else
+    {
+        std::cout << "Processed " << opts.numBlocks << " blocks at " << opts.sampleRate << " Hz (seed " << opts.seed << ")\n"
+                  << "\nLoad histogram (block time as % of deadline):\n";
+
+        for (int i = 0; i < numLoadBuckets; ++i)
+        {
+            const auto label = i < numLoadBuckets - 1 ? "< " + juce::String (loadBucketEdges[i]) + "%"
+                                                      : ">= " + juce::String (loadBucketEdges[numLoadBuckets - 2]) + "%";
+            std::cout << "  " << label.paddedRight (' ', 8) << " " << loadHistogram[i] << "\n";
+        }
+
+        std::cout << "\nWCET by block size:\n";
+        for (int i = 0; i < numSizeClasses; ++i)
+            std::cout << "  " << getSizeClassName (i).paddedRight (' ', 10) << " n=" << sizeClassCount[i]
+                      << " wcet=" << sizeClassWcet[i] << " us mean="
+                      << (sizeClassCount[i] > 0 ? sizeClassTotal[i] / sizeClassCount[i] : 0.0) << " us\n";
+
+        std::cout << "\n" << RealtimeSafety::formatViolations()
+                  << "(in " << blocksWithViolations << " blocks)\n";
+
+        printRecord ("WORST BLOCK (load)", worstLoad);
+        printRecord ("WORST BLOCK (absolute time)", worstTime);
+
+        if (blocksWithViolations > 0)
+            printRecord ("FIRST REAL-TIME VIOLATION", firstViolation);
+    }
+
+    return RealtimeSafety::getViolationCount() > 0 ? 1 : 0;
+}